@@ -0,0 +1,196 @@
+//
+//  ECAllocTracker.cpp
+//
+//
+//  Heap allocation tracking through the global operator new/delete
+//
+
+#include "ECAllocTracker.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>     // malloc_usable_size; _msize and _aligned_malloc on Windows
+#endif
+
+namespace {
+
+// Plain data only: these are read from operator new, which can run before any
+// dynamic initialization
+thread_local ECAllocScope *currScope = nullptr;
+thread_local int guardDepth = 0;
+thread_local bool guardAbort = false;
+thread_local uint64_t numViolations = 0;    // by this thread, inside a guard
+
+// Over-aligned blocks come from the aligned allocator; on Windows they must be
+// sized and freed through it too
+bool IsOverAligned(size_t alignment) {
+    return alignment > alignof(std::max_align_t);
+}
+
+size_t UsableSize(void *ptr, size_t alignment) {
+#if defined(_WIN32)
+    return IsOverAligned(alignment) ? _aligned_msize(ptr, alignment, 0) : _msize(ptr);
+#elif defined(__APPLE__)
+    (void)alignment;
+    return malloc_size(ptr);
+#else
+    (void)alignment;
+    return malloc_usable_size(ptr);
+#endif
+}
+
+void *AlignedMalloc(size_t size, size_t alignment) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void *ptr = nullptr;
+    return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+#endif
+}
+
+void AlignedFree(void *ptr) {
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+} // namespace
+
+struct ECAllocHooks {
+    static void OnAlloc(void *ptr, size_t alignment) {
+        if (guardDepth > 0) {
+            numViolations++;
+            if (guardAbort) {
+                fputs("ECAllocTickGuard: heap allocation inside a tick\n", stderr);
+                abort();
+            }
+        }
+        size_t size = UsableSize(ptr, alignment);
+        for (ECAllocScope *scope = currScope; scope; scope = scope->outer) {
+            ECAllocStats &stats = scope->stats;
+            stats.numAllocs++;
+            stats.bytesAllocated += size;
+            stats.bytesLive += size;
+            if (stats.bytesLive > stats.peakBytesLive) {
+                stats.peakBytesLive = stats.bytesLive;
+            }
+            if (guardDepth > 0) {
+                stats.numViolations++;
+            }
+        }
+    }
+
+    static void OnFree(void *ptr, size_t alignment) {
+        size_t size = UsableSize(ptr, alignment);
+        for (ECAllocScope *scope = currScope; scope; scope = scope->outer) {
+            scope->stats.numFrees++;
+            scope->stats.bytesLive -= size;
+        }
+    }
+};
+
+namespace {
+
+void *Allocate(size_t size, size_t alignment, bool nothrow) {
+    if (size == 0) {
+        size = 1;
+    }
+    for (;;) {
+        void *ptr = IsOverAligned(alignment) ? AlignedMalloc(size, alignment) : malloc(size);
+        if (ptr) {
+            if (currScope || guardDepth > 0) {
+                ECAllocHooks::OnAlloc(ptr, alignment);
+            }
+            return ptr;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            if (nothrow) {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void Free(void *ptr, size_t alignment) {
+    if (!ptr) {
+        return;
+    }
+    if (currScope) {
+        ECAllocHooks::OnFree(ptr, alignment);
+    }
+    if (IsOverAligned(alignment)) {
+        AlignedFree(ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+} // namespace
+
+//*****************************************************************************
+// Scopes and guards
+
+ECAllocScope::ECAllocScope() : outer(currScope) {
+    currScope = this;
+}
+
+ECAllocScope::~ECAllocScope() {
+    currScope = outer;
+}
+
+void ECAllocScope::Report(std::ostream &os, const char *name) const {
+    os << name << ": " << stats.numAllocs << " allocations (" << stats.bytesAllocated << " bytes), "
+       << stats.numFrees << " frees, peak " << stats.peakBytesLive << " bytes live";
+    if (stats.numViolations > 0) {
+        os << ", " << stats.numViolations << " inside a tick";
+    }
+    os << "\n";
+}
+
+ECAllocTickGuard::ECAllocTickGuard(bool abortOnViolation) : violationsAtStart(numViolations), abortBefore(guardAbort) {
+    guardDepth++;
+    guardAbort = abortOnViolation || abortBefore;
+}
+
+ECAllocTickGuard::~ECAllocTickGuard() {
+    guardDepth--;
+    guardAbort = abortBefore;
+}
+
+uint64_t ECAllocTickGuard::GetNumViolations() const {
+    return numViolations - violationsAtStart;
+}
+
+//*****************************************************************************
+// Replacement global operators
+
+void *operator new(size_t size) { return Allocate(size, 0, false); }
+void *operator new[](size_t size) { return Allocate(size, 0, false); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return Allocate(size, 0, true); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return Allocate(size, 0, true); }
+void *operator new(size_t size, std::align_val_t align) { return Allocate(size, static_cast<size_t>(align), false); }
+void *operator new[](size_t size, std::align_val_t align) { return Allocate(size, static_cast<size_t>(align), false); }
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return Allocate(size, static_cast<size_t>(align), true); }
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return Allocate(size, static_cast<size_t>(align), true); }
+
+void operator delete(void *ptr) noexcept { Free(ptr, 0); }
+void operator delete[](void *ptr) noexcept { Free(ptr, 0); }
+void operator delete(void *ptr, size_t) noexcept { Free(ptr, 0); }
+void operator delete[](void *ptr, size_t) noexcept { Free(ptr, 0); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { Free(ptr, 0); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { Free(ptr, 0); }
+void operator delete(void *ptr, std::align_val_t align) noexcept { Free(ptr, static_cast<size_t>(align)); }
+void operator delete[](void *ptr, std::align_val_t align) noexcept { Free(ptr, static_cast<size_t>(align)); }
+void operator delete(void *ptr, size_t, std::align_val_t align) noexcept { Free(ptr, static_cast<size_t>(align)); }
+void operator delete[](void *ptr, size_t, std::align_val_t align) noexcept { Free(ptr, static_cast<size_t>(align)); }
+void operator delete(void *ptr, std::align_val_t align, const std::nothrow_t &) noexcept { Free(ptr, static_cast<size_t>(align)); }
+void operator delete[](void *ptr, std::align_val_t align, const std::nothrow_t &) noexcept { Free(ptr, static_cast<size_t>(align)); }
@@ -0,0 +1,77 @@
+//
+//  ECAllocTracker.h
+//
+//
+//  Heap allocation tracking through the global operator new/delete
+//
+
+#ifndef ECAllocTracker_h
+#define ECAllocTracker_h
+
+#include <cstdint>
+#include <iostream>
+
+//*****************************************************************************
+// ECAllocTracker.cpp replaces the global operator new and delete. They count
+// only while the calling thread is inside an ECAllocScope or ECAllocTickGuard,
+// so other code pays one thread-local check per allocation and nothing else.
+//
+// Only operator new and delete are seen: memory taken straight from malloc (or
+// by a library such as Allegro) is not counted, and neither is another thread's.
+// The repo's own containers and arenas all go through operator new.
+//
+// Sizes come from the C allocator (malloc_usable_size, malloc_size, or _msize
+// on Windows), so byte counts include its rounding.
+
+struct ECAllocStats {
+    uint64_t numAllocs = 0;
+    uint64_t numFrees = 0;
+    uint64_t bytesAllocated = 0;    // total over all allocations
+    int64_t bytesLive = 0;          // allocated minus freed while in scope (negative if it freed older memory)
+    int64_t peakBytesLive = 0;
+    uint64_t numViolations = 0;     // allocations inside an ECAllocTickGuard
+};
+
+// Counts the allocations and frees made by this thread while alive. Scopes nest:
+// every enclosing scope of the thread counts too.
+class ECAllocScope
+{
+public:
+    ECAllocScope();
+    ~ECAllocScope();
+
+    ECAllocScope(const ECAllocScope &) = delete;
+    ECAllocScope &operator=(const ECAllocScope &) = delete;
+
+    const ECAllocStats &GetStats() const { return stats; }
+
+    // One line: allocations, bytes, peak live bytes and violations
+    void Report(std::ostream &os, const char *name) const;
+
+private:
+    friend struct ECAllocHooks;
+    ECAllocStats stats;
+    ECAllocScope *outer;
+};
+
+// Marks a region (typically one tick) that must not allocate. An allocation
+// made by this thread inside it is counted as a violation in the enclosing
+// scopes and, with abortOnViolation, ends the program with a message.
+class ECAllocTickGuard
+{
+public:
+    explicit ECAllocTickGuard(bool abortOnViolation = false);
+    ~ECAllocTickGuard();
+
+    ECAllocTickGuard(const ECAllocTickGuard &) = delete;
+    ECAllocTickGuard &operator=(const ECAllocTickGuard &) = delete;
+
+    // Violations inside this guard so far
+    uint64_t GetNumViolations() const;
+
+private:
+    uint64_t violationsAtStart;
+    bool abortBefore;
+};
+
+#endif /* ECAllocTracker_h */
@@ -0,0 +1,253 @@
+//
+//  ECAsyncObserver.cpp
+//
+//
+//  Observer adapter that delivers events on its own worker thread
+//
+
+#include "ECAsyncObserver.h"
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+ECAsyncObserver::ECAsyncObserver(ECObserver *targetIn, size_t capacity, ECAsyncOverflowPolicy policyIn)
+    : target(targetIn), policy(policyIn), queue(capacity), numCoalescedPending(0), signal(0), stopRequested(false),
+      numNotified(0), numDelivered(0), numDropped(0), numCoalesced(0) {
+    worker = thread(&ECAsyncObserver::Work, this);
+}
+
+ECAsyncObserver::~ECAsyncObserver() {
+    stopRequested.store(true);
+    Wake();
+    worker.join();
+}
+
+void ECAsyncObserver::Wake() {
+    signal.fetch_add(1, memory_order_release);
+    signal.notify_one();
+}
+
+void ECAsyncObserver::OnEvent(const ECEvent &evt) {
+    numNotified++;
+    if (policy == EC_ASYNC_COALESCE) {
+        PushCoalesced(evt);
+    } else if (!queue.TryPush(evt)) {
+        if (policy == EC_ASYNC_BLOCK) {
+            while (!queue.TryPush(evt)) {
+                this_thread::yield();
+            }
+        } else {
+            // Another producer may refill the freed cell first; keep evicting until there is room
+            ECEvent oldest;
+            do {
+                if (queue.TryPop(oldest)) {
+                    numDropped++;
+                }
+            } while (!queue.TryPush(evt));
+        }
+    }
+    Wake();
+}
+
+void ECAsyncObserver::PushCoalesced(const ECEvent &evt) {
+    // The slot's lock is held across the push, so while an event of this category
+    // waits in the slot none of its successors can get into the queue (and so be
+    // delivered before it)
+    CoalesceSlot &slot = coalesced[evt.category];
+    while (slot.lock.test_and_set(memory_order_acquire)) {
+    }
+    if (slot.full) {
+        // The earlier event is superseded and will never be delivered
+        numCoalesced++;
+        slot.evt = evt;
+    } else if (!queue.TryPush(evt)) {
+        slot.full = true;
+        numCoalescedPending++;
+        slot.evt = evt;
+    }
+    slot.lock.clear(memory_order_release);
+}
+
+bool ECAsyncObserver::TakeCoalesced(ECEvent &evt) {
+    if (numCoalescedPending.load() == 0) {
+        return false;
+    }
+    for (int c = 0; c < EC_EVENT_NUM_CATEGORIES; c++) {
+        CoalesceSlot &slot = coalesced[c];
+        while (slot.lock.test_and_set(memory_order_acquire)) {
+        }
+        bool found = slot.full;
+        if (found) {
+            evt = slot.evt;
+            slot.full = false;
+            numCoalescedPending--;
+        }
+        slot.lock.clear(memory_order_release);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ECAsyncObserver::Work() {
+    ECEvent evt;
+    for (;;) {
+        uint32_t seen = signal.load(memory_order_acquire);
+
+        // Queued events first (in order), then the latest overflowed ones
+        bool any = false;
+        while (queue.TryPop(evt) || TakeCoalesced(evt)) {
+            target->OnEvent(evt);
+            numDelivered++;
+            any = true;
+        }
+        if (any) {
+            numDelivered.notify_all();
+            continue;
+        }
+        if (stopRequested.load()) {
+            break;
+        }
+        signal.wait(seen, memory_order_acquire);
+    }
+}
+
+void ECAsyncObserver::Flush() {
+    // Every notified event ends up delivered, dropped or coalesced away
+    for (;;) {
+        uint64_t delivered = numDelivered.load();
+        if (delivered + numDropped.load() + numCoalesced.load() >= numNotified.load()) {
+            break;
+        }
+        numDelivered.wait(delivered);
+    }
+}
+
+//*****************************************************************************
+// Check
+
+namespace {
+
+// Records the events it gets. The worker is held inside OnEvent until Allow lets
+// that many events through, which makes the queue fill up deterministically.
+class GatedRecorder : public ECObserver
+{
+public:
+    GatedRecorder() : numEntered(0), numAllowed(0) {}
+
+    virtual void OnEvent(const ECEvent &evt) override {
+        uint64_t index = numEntered.fetch_add(1);
+        numEntered.notify_all();
+        for (uint64_t allowed = numAllowed.load(); index >= allowed; allowed = numAllowed.load()) {
+            numAllowed.wait(allowed);
+        }
+        received.push_back(evt);
+    }
+
+    void Allow(uint64_t n) {
+        numAllowed.store(n);
+        numAllowed.notify_all();
+    }
+
+    // Wait until the worker has been handed 'n' events
+    void WaitEntered(uint64_t n) {
+        for (uint64_t entered = numEntered.load(); entered < n; entered = numEntered.load()) {
+            numEntered.wait(entered);
+        }
+    }
+
+    // Read after ECAsyncObserver::Flush
+    vector<ECEvent> received;
+
+private:
+    atomic<uint64_t> numEntered;
+    atomic<uint64_t> numAllowed;
+};
+
+string Codes(const vector<int> &codes) {
+    string text;
+    for (int code : codes) {
+        text += (text.empty() ? "" : " ") + to_string(code);
+    }
+    return text;
+}
+
+// One line for the policy; true if the delivered codes (in order) and the counts are as expected
+bool Expect(ostream &os, const char *name, const ECAsyncObserver &adapter, const GatedRecorder &recorder,
+            const vector<int> &codes, uint64_t numDropped, uint64_t numCoalesced) {
+    vector<int> received;
+    for (const ECEvent &evt : recorder.received) {
+        received.push_back(evt.code);
+    }
+    bool ok = received == codes && adapter.GetNumDelivered() == codes.size() &&
+              adapter.GetNumDropped() == numDropped && adapter.GetNumCoalesced() == numCoalesced;
+    os << "  " << left << setw(22) << name << right << " delivered " << adapter.GetNumDelivered() << ", dropped "
+       << adapter.GetNumDropped() << ", coalesced " << adapter.GetNumCoalesced()
+       << (ok ? "  ok" : "  FAILED: got " + Codes(received) + ", expected " + Codes(codes)) << "\n";
+    return ok;
+}
+
+} // namespace
+
+int ECCheckAsyncObserver(ostream &os) {
+    const size_t capacity = 4;
+    int numFailed = 0;
+
+    // Block: the producer waits out a full queue; everything arrives, in order
+    {
+        GatedRecorder recorder;
+        ECAsyncObserver adapter(&recorder, capacity, EC_ASYNC_BLOCK);
+        adapter.OnEvent(ECEvent(EC_EVENT_TIMER, 0));
+        recorder.WaitEntered(1);
+        thread opener([&recorder]() {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            recorder.Allow(UINT64_MAX);
+        });
+        vector<int> codes = {0};
+        for (int code = 1; code < 20; code++) {
+            adapter.OnEvent(ECEvent(EC_EVENT_TIMER, code));
+            codes.push_back(code);
+        }
+        opener.join();
+        adapter.Flush();
+        numFailed += !Expect(os, "EC_ASYNC_BLOCK", adapter, recorder, codes, 0, 0);
+    }
+
+    // Drop oldest: of 1..10 only the last 'capacity' are still queued when the worker resumes
+    {
+        GatedRecorder recorder;
+        ECAsyncObserver adapter(&recorder, capacity, EC_ASYNC_DROP_OLDEST);
+        adapter.OnEvent(ECEvent(EC_EVENT_TIMER, 0));
+        recorder.WaitEntered(1);
+        for (int code = 1; code <= 10; code++) {
+            adapter.OnEvent(ECEvent(EC_EVENT_TIMER, code));
+        }
+        recorder.Allow(UINT64_MAX);
+        adapter.Flush();
+        numFailed += !Expect(os, "EC_ASYNC_DROP_OLDEST", adapter, recorder, {0, 7, 8, 9, 10}, 6, 0);
+    }
+
+    // Coalesce: 5 overflows into the slot; after the worker frees room in the
+    // queue, 6 must still replace 5 rather than be queued ahead of it
+    {
+        GatedRecorder recorder;
+        ECAsyncObserver adapter(&recorder, capacity, EC_ASYNC_COALESCE);
+        for (int code = 0; code <= 5; code++) {
+            adapter.OnEvent(ECEvent(EC_EVENT_TIMER, code));
+            if (code == 0) {
+                recorder.WaitEntered(1);
+            }
+        }
+        recorder.Allow(2);
+        recorder.WaitEntered(3);
+        adapter.OnEvent(ECEvent(EC_EVENT_TIMER, 6));
+        recorder.Allow(UINT64_MAX);
+        adapter.Flush();
+        numFailed += !Expect(os, "EC_ASYNC_COALESCE", adapter, recorder, {0, 1, 2, 3, 4, 6}, 0, 1);
+    }
+    return numFailed;
+}
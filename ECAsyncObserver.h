@@ -0,0 +1,100 @@
+//
+//  ECAsyncObserver.h
+//
+//
+//  Observer adapter that delivers events on its own worker thread
+//
+
+#ifndef ECAsyncObserver_h
+#define ECAsyncObserver_h
+
+#include "ECObserver.h"
+#include "ECBoundedQueue.h"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+//*****************************************************************************
+// Wraps a slow observer (a logger, an exporter, ...) so it no longer runs inside
+// the subject's loop. Subscribe the adapter to the subject instead of the
+// observer itself: OnEvent only copies the event into a bounded lock-free queue,
+// and a worker thread owned by the adapter calls the wrapped observer's OnEvent.
+// The wrapped observer therefore runs on the worker thread and must not touch
+// state owned by the subject's thread without its own synchronization.
+//
+// When the queue is full the overflow policy decides what happens:
+//   EC_ASYNC_BLOCK        the notifying thread waits for room (nothing is lost)
+//   EC_ASYNC_DROP_OLDEST  the oldest queued event is discarded to make room
+//   EC_ASYNC_COALESCE     the event replaces any earlier overflowed event of the
+//                         same category; only the latest one per category is
+//                         delivered once the worker catches up. While one waits,
+//                         later events of its category replace it too, even if
+//                         the queue has room again, so none overtakes it
+// Only EC_ASYNC_BLOCK can make the notifying thread wait on the observer.
+
+enum ECAsyncOverflowPolicy
+{
+    EC_ASYNC_BLOCK = 0,
+    EC_ASYNC_DROP_OLDEST,
+    EC_ASYNC_COALESCE
+};
+
+class ECAsyncObserver : public ECObserver
+{
+public:
+    ECAsyncObserver(ECObserver *target, size_t capacity = 1024, ECAsyncOverflowPolicy policy = EC_ASYNC_DROP_OLDEST);
+    // Delivers whatever is still queued, then stops the worker
+    virtual ~ECAsyncObserver();
+
+    ECAsyncObserver(const ECAsyncObserver &) = delete;
+    ECAsyncObserver &operator=(const ECAsyncObserver &) = delete;
+
+    virtual void OnEvent(const ECEvent &evt) override;
+
+    // Wait until every event notified so far has been delivered
+    void Flush();
+
+    ECAsyncOverflowPolicy GetPolicy() const { return policy; }
+    uint64_t GetNumDelivered() const { return numDelivered.load(); }
+    uint64_t GetNumDropped() const { return numDropped.load(); }
+    uint64_t GetNumCoalesced() const { return numCoalesced.load(); }
+
+private:
+    // Latest overflowed event of one category (EC_ASYNC_COALESCE)
+    struct CoalesceSlot {
+        CoalesceSlot() : full(false) {}
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        bool full;
+        ECEvent evt;
+    };
+
+    void Work();
+    void Wake();
+    void PushCoalesced(const ECEvent &evt);
+    bool TakeCoalesced(ECEvent &evt);
+
+    ECObserver *target;
+    const ECAsyncOverflowPolicy policy;
+    ECBoundedQueue<ECEvent> queue;
+    CoalesceSlot coalesced[EC_EVENT_NUM_CATEGORIES];
+    std::atomic<uint32_t> numCoalescedPending;
+
+    // Bumped on every push so the idle worker can sleep on it (std::atomic::wait)
+    std::atomic<uint32_t> signal;
+    std::atomic<bool> stopRequested;
+
+    std::atomic<uint64_t> numNotified;
+    std::atomic<uint64_t> numDelivered;
+    std::atomic<uint64_t> numDropped;
+    std::atomic<uint64_t> numCoalesced;
+
+    std::thread worker;
+};
+
+// Run each overflow policy against an observer that stalls on purpose and check
+// which events arrive, in what order, and the dropped / coalesced counts. Prints
+// one line per policy; returns the number that failed.
+int ECCheckAsyncObserver(std::ostream &os);
+
+#endif /* ECAsyncObserver_h */
@@ -0,0 +1,109 @@
+//
+//  ECBoundedQueue.h
+//
+//
+//  Bounded lock-free queue (any number of producers and consumers)
+//
+
+#ifndef ECBoundedQueue_h
+#define ECBoundedQueue_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+//*****************************************************************************
+// Fixed-capacity ring of cells, each with a sequence number that tells producers
+// and consumers whose turn it is (D. Vyukov's bounded MPMC queue). Push and pop
+// are a CAS on the shared position plus one store to the cell; nothing allocates
+// after construction. When the queue is full TryPush fails and the caller decides
+// what to do (spin, drop, ...); when empty TryPop fails.
+//
+// Capacity is rounded up to a power of two.
+
+template<class T>
+class ECBoundedQueue
+{
+public:
+    explicit ECBoundedQueue(size_t capacityIn) : capacity(RoundUp(capacityIn)), mask(capacity - 1), cells(new Cell[capacity]) {
+        for (size_t i = 0; i < capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+    ECBoundedQueue(const ECBoundedQueue &) = delete;
+    ECBoundedQueue &operator=(const ECBoundedQueue &) = delete;
+
+    bool TryPush(const T &item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T &item) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    item = cell.data;
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate number of queued items (exact when no push/pop is in flight)
+    size_t SizeApprox() const {
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        return tail >= head ? tail - head : 0;
+    }
+
+    size_t Capacity() const { return capacity; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static size_t RoundUp(size_t n) {
+        size_t c = 2;
+        while (c < n) {
+            c <<= 1;
+        }
+        return c;
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+};
+
+#endif /* ECBoundedQueue_h */
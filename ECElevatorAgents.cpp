@@ -0,0 +1,357 @@
+//
+//  ECElevatorAgents.cpp
+//
+//
+//  Passengers as coroutines, resumed by the simulation's events
+//
+
+#include "ECElevatorAgents.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+//*****************************************************************************
+// ECAgentFramePool
+
+ECAgentFramePool::~ECAgentFramePool() {
+    for (void *chunk : chunks) {
+        ::operator delete(chunk);
+    }
+}
+
+void *ECAgentFramePool::Allocate(size_t size) {
+    numLive++;
+    peakLive = max(peakLive, numLive);
+    maxFrameSize = max(maxFrameSize, size);
+    if (size > MAX_POOLED) {
+        return ::operator new(size);
+    }
+    size_t sizeClass = (size + GRAIN - 1) / GRAIN;
+    if (FreeFrame *frame = freeLists[sizeClass]) {
+        freeLists[sizeClass] = frame->next;
+        return frame;
+    }
+    size_t bytes = sizeClass * GRAIN;
+    if (static_cast<size_t>(chunkEnd - chunkNext) < bytes) {
+        chunks.push_back(::operator new(CHUNK));
+        chunkNext = static_cast<char *>(chunks.back());
+        chunkEnd = chunkNext + CHUNK;
+    }
+    void *frame = chunkNext;
+    chunkNext += bytes;
+    return frame;
+}
+
+void ECAgentFramePool::Free(void *frame, size_t size) {
+    numLive--;
+    if (size > MAX_POOLED) {
+        ::operator delete(frame);
+        return;
+    }
+    size_t sizeClass = (size + GRAIN - 1) / GRAIN;
+    FreeFrame *free = static_cast<FreeFrame *>(frame);
+    free->next = freeLists[sizeClass];
+    freeLists[sizeClass] = free;
+}
+
+//*****************************************************************************
+// ECAgentContext and the awaitables
+
+ECAgentFramePool &ECAgent::promise_type::GetPool(const ECAgentContext &ctx) {
+    return ctx.GetEngine().pool;
+}
+
+int ECAgentContext::Now() const {
+    return engine->GetTime();
+}
+
+int ECAgentContext::GetNumWaiting(int floor) const {
+    return floor >= 0 && floor < static_cast<int>(engine->numWaiting.size()) ? engine->numWaiting[floor] : 0;
+}
+
+void ECAgentContext::SleepAwaiter::await_suspend(coroutine_handle<>) const {
+    engine.Suspend(id, ECAgentEngine::WAIT_TIMER, engine.GetTime() + max(ticks, 1));
+}
+
+void ECAgentContext::CallAwaiter::await_suspend(coroutine_handle<>) const {
+    engine.PlaceCall(id, floorSrc, floorDest, patience);
+}
+
+bool ECAgentContext::CallAwaiter::await_resume() const {
+    return engine.agents[id].boarded;
+}
+
+bool ECAgentContext::RideAwaiter::await_ready() const {
+    return engine.agents[id].arrived;
+}
+
+void ECAgentContext::RideAwaiter::await_suspend(coroutine_handle<>) const {
+    engine.WaitRide(id);
+}
+
+void ECAgentContext::DoorAwaiter::await_suspend(coroutine_handle<>) const {
+    engine.WaitDoor(id, floor);
+}
+
+int ECAgentContext::DoorAwaiter::await_resume() const {
+    return engine.agents[id].doorCar;
+}
+
+//*****************************************************************************
+// ECAgentEngine
+
+ECAgentEngine::ECAgentEngine(int numFloors, int numCars)
+    : sim(numFloors, listRequests, numCars), numWaiting(numFloors + 1, 0), doorWaiters(numFloors + 1),
+      totalTripTime(0), numResumes(0) {
+    sim.SetListener(this);
+}
+
+ECAgentEngine::~ECAgentEngine() {
+    // Frames go back to the pool before it goes
+    for (Agent &agent : agents) {
+        if (agent.handle) {
+            agent.handle.destroy();
+        }
+    }
+}
+
+int32_t ECAgentEngine::NewAgent() {
+    int32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = static_cast<int32_t>(agents.size());
+        agents.emplace_back();
+    }
+    Agent &agent = agents[id];
+    agent.handle = nullptr;
+    agent.request = -1;
+    agent.timer = ECTimingWheel<int32_t>::NO_TIMER;
+    agent.doorCar = -1;
+    agent.wait = WAIT_NONE;
+    agent.boarded = agent.arrived = false;
+    return id;
+}
+
+void ECAgentEngine::Start(int32_t id, coroutine_handle<ECAgent::promise_type> handle, int time) {
+    agents[id].handle = handle;
+    agents[id].startTime = max(time, GetTime());
+    Suspend(id, WAIT_TIMER, agents[id].startTime);
+}
+
+void ECAgentEngine::Suspend(int32_t id, WaitKind kind, int wakeTime) {
+    Agent &agent = agents[id];
+    agent.wait = kind;
+    if (wakeTime >= 0) {
+        agent.timer = timers.Schedule(wakeTime, id);
+    }
+}
+
+void ECAgentEngine::Wake(int32_t id) {
+    Agent &agent = agents[id];
+    if (agent.timer != ECTimingWheel<int32_t>::NO_TIMER) {
+        timers.Cancel(agent.timer);
+        agent.timer = ECTimingWheel<int32_t>::NO_TIMER;
+    }
+    agent.wait = WAIT_NONE;
+    readyNext.push_back(id);
+}
+
+void ECAgentEngine::FireTimers() {
+    timers.Advance(GetTime(), [this](int32_t id, int time) {
+        agents[id].timer = ECTimingWheel<int32_t>::NO_TIMER;
+        dueTimers.push_back(make_pair(time, id));
+    });
+    // The wheel gives a tick's timers in no order; agents wake by due time, then id
+    sort(dueTimers.begin(), dueTimers.end());
+    for (const pair<int, int32_t> &due : dueTimers) {
+        Agent &agent = agents[due.second];
+        if (agent.wait == WAIT_CALL) {
+            // Out of patience: withdraw the call
+            if (!sim.CancelRequest(agent.request)) {
+                continue;
+            }
+            numWaiting[listRequests[agent.request].GetFloorSrc()]--;
+            requestAgent[agent.request] = -1;
+        }
+        Wake(due.second);
+    }
+    dueTimers.clear();
+}
+
+void ECAgentEngine::Finish(int32_t id) {
+    Agent &agent = agents[id];
+    ECAgent::promise_type &promise = agent.handle.promise();
+    exception_ptr error = promise.error;
+    ECAgentOutcome outcome = promise.outcome;
+    agent.handle.destroy();
+    agent.handle = nullptr;
+    freeIds.push_back(id);
+    if (error) {
+        rethrow_exception(error);
+    }
+    numFinished[outcome]++;
+    if (outcome == EC_AGENT_DELIVERED) {
+        totalTripTime += agent.arriveTime - agent.startTime;
+    }
+}
+
+void ECAgentEngine::Run(int lenSim) {
+    while (GetTime() < lenSim) {
+        FireTimers();
+        ready.swap(readyNext);
+        for (int32_t id : ready) {
+            numResumes++;
+            coroutine_handle<ECAgent::promise_type> handle = agents[id].handle;
+            handle.resume();
+            if (handle.done()) {
+                Finish(id);
+            }
+        }
+        ready.clear();
+        sim.Step();
+    }
+}
+
+void ECAgentEngine::PlaceCall(int32_t id, int floorSrc, int floorDest, int patience) {
+    if (floorSrc < 1 || floorSrc >= static_cast<int>(numWaiting.size()) || floorDest < 1 ||
+        floorDest >= static_cast<int>(numWaiting.size())) {
+        throw out_of_range("ECAgentEngine: call with a floor outside the building");
+    }
+    int32_t request = sim.AddRequest(GetTime(), floorSrc, floorDest);
+    if (requestAgent.size() <= static_cast<size_t>(request)) {
+        requestAgent.resize(request + 1, -1);
+    }
+    requestAgent[request] = id;
+    Agent &agent = agents[id];
+    agent.request = request;
+    agent.boarded = agent.arrived = false;
+    numWaiting[floorSrc]++;
+    Suspend(id, WAIT_CALL, patience >= 0 ? GetTime() + max(patience, 1) : -1);
+}
+
+void ECAgentEngine::WaitDoor(int32_t id, int floor) {
+    if (floor < 0 || floor >= static_cast<int>(doorWaiters.size())) {
+        throw out_of_range("ECAgentEngine: no such floor");
+    }
+    doorWaiters[floor].push_back(id);
+    Suspend(id, WAIT_DOOR, -1);
+}
+
+void ECAgentEngine::OnRequestBoarded(int32_t index, const ECElevatorSimRequest &request, int, int) {
+    int32_t id = index < static_cast<int32_t>(requestAgent.size()) ? requestAgent[index] : -1;
+    if (id < 0) {
+        return;
+    }
+    Agent &agent = agents[id];
+    agent.boarded = true;
+    numWaiting[request.GetFloorSrc()]--;
+    if (agent.wait == WAIT_CALL) {
+        Wake(id);
+    }
+}
+
+void ECAgentEngine::OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int, int) {
+    int32_t id = index < static_cast<int32_t>(requestAgent.size()) ? requestAgent[index] : -1;
+    if (id < 0) {
+        return;
+    }
+    requestAgent[index] = -1;
+    Agent &agent = agents[id];
+    agent.arrived = true;
+    agent.arriveTime = request.GetArriveTime();
+    if (agent.wait == WAIT_RIDE) {
+        Wake(id);
+    }
+}
+
+void ECAgentEngine::OnCarStopped(int car, int floor, int) {
+    if (floor < 0 || floor >= static_cast<int>(doorWaiters.size())) {
+        return;
+    }
+    for (int32_t id : doorWaiters[floor]) {
+        if (agents[id].wait == WAIT_DOOR) {
+            agents[id].doorCar = car;
+            Wake(id);
+        }
+    }
+    doorWaiters[floor].clear();
+}
+
+//*****************************************************************************
+
+ECAgent ECPassengerAgent(ECAgentContext ctx, ECPassengerProfile profile) {
+    if (profile.balkQueue > 0 && ctx.GetNumWaiting(profile.floorSrc) >= profile.balkQueue) {
+        co_return EC_AGENT_BALKED;
+    }
+    int floor = profile.floorSrc;
+    int leg = profile.transferFloor > 0 ? 0 : 1;
+    for (; leg < 2; leg++) {
+        int stop = leg == 0 ? profile.transferFloor : profile.floorDest;
+        int presses = 1;
+        while (!co_await ctx.Call(floor, stop, profile.patience)) {
+            if (++presses > profile.maxPresses) {
+                co_return EC_AGENT_GAVE_UP;
+            }
+        }
+        co_await ctx.Ride();
+        floor = stop;
+    }
+    co_return EC_AGENT_DELIVERED;
+}
+
+void ECRunAgentBenchmark(ostream &os, int numAgents, uint32_t seed) {
+    const int numFloors = 40;
+    const int numCars = 8;
+    const int window = 1000;
+    const int lenSpawn = max(numAgents / 2, window);
+    const int lenSim = lenSpawn + 20000;
+    mt19937 rng(seed);
+
+    // Arrival times in order, so agents can be spawned one window ahead of the run
+    vector<int> times(numAgents);
+    for (int &time : times) {
+        time = rng() % lenSpawn;
+    }
+    sort(times.begin(), times.end());
+
+    ECAgentEngine engine(numFloors, numCars);
+    size_t next = 0;
+    auto start = chrono::steady_clock::now();
+    for (int until = window; until <= lenSim; until += window) {
+        for (; next < times.size() && times[next] < until; next++) {
+            ECPassengerProfile profile;
+            profile.floorSrc = 1 + rng() % numFloors;
+            profile.floorDest = 1 + rng() % (numFloors - 1);
+            profile.floorDest += profile.floorDest >= profile.floorSrc;
+            int kind = rng() % 20;
+            if (kind < 3) {
+                profile.balkQueue = 4;
+            } else if (kind < 6) {
+                profile.patience = 60;
+                profile.maxPresses = 3;
+            } else if (kind < 8 && profile.floorSrc != numFloors / 2 && profile.floorDest != numFloors / 2) {
+                profile.transferFloor = numFloors / 2;
+            }
+            engine.Spawn(times[next], ECPassengerAgent, profile);
+        }
+        engine.Run(until);
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    const ECAgentFramePool &pool = engine.GetPool();
+    int64_t delivered = engine.GetNumFinished(EC_AGENT_DELIVERED);
+    os << numAgents << " agents, " << numFloors << " floors, " << numCars << " cars, " << lenSim << " ticks: " << fixed
+       << setprecision(1) << ms << " ms, " << engine.GetNumResumes() << " resumes ("
+       << ms * 1e6 / max<int64_t>(engine.GetNumResumes(), 1) << " ns each, simulation included)\n";
+    os << "  delivered " << delivered << ", balked " << engine.GetNumFinished(EC_AGENT_BALKED) << ", gave up "
+       << engine.GetNumFinished(EC_AGENT_GAVE_UP) << ", still running " << engine.GetNumLive() << "\n";
+    os << "  mean trip " << (delivered ? static_cast<double>(engine.GetTotalTripTime()) / delivered : 0) << " ticks\n";
+    os << "  frame " << pool.GetMaxFrameSize() << " bytes, peak " << pool.GetPeakLive() << " live, "
+       << pool.GetBytesReserved() / 1024 << " KiB of chunks\n";
+}
@@ -0,0 +1,309 @@
+//
+//  ECElevatorAgents.h
+//
+//
+//  Passengers as coroutines, resumed by the simulation's events
+//
+
+#ifndef ECElevatorAgents_h
+#define ECElevatorAgents_h
+
+#include "ECElevatorSimFixed.h"
+#include "ECTimingWheel.h"
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+class ECAgentEngine;
+
+//*****************************************************************************
+// Coroutine frames, by size class (multiples of GRAIN bytes up to MAX_POOLED),
+// each class a free list carved from CHUNK-byte chunks. Freed frames go back to
+// their list, so once the population is steady starting an agent costs a list
+// pop. Larger frames come from operator new. Not thread safe: one pool per
+// engine, used from the engine's thread.
+
+class ECAgentFramePool
+{
+public:
+    static const size_t GRAIN = 16;
+    static const size_t MAX_POOLED = 1024;
+    static const size_t CHUNK = 1 << 16;
+
+    ECAgentFramePool() : freeLists(MAX_POOLED / GRAIN + 1, nullptr), numLive(0), peakLive(0), maxFrameSize(0) {}
+    ~ECAgentFramePool();
+
+    ECAgentFramePool(const ECAgentFramePool &) = delete;
+    ECAgentFramePool &operator=(const ECAgentFramePool &) = delete;
+
+    void *Allocate(size_t size);
+    void Free(void *frame, size_t size);
+
+    size_t GetNumLive() const { return numLive; }
+    size_t GetPeakLive() const { return peakLive; }
+    size_t GetMaxFrameSize() const { return maxFrameSize; }
+    size_t GetBytesReserved() const { return chunks.size() * CHUNK; }
+
+private:
+    struct FreeFrame {
+        FreeFrame *next;
+    };
+
+    std::vector<FreeFrame *> freeLists;         // per size class
+    std::vector<void *> chunks;
+    char *chunkNext = nullptr;                  // unused part of the newest chunk
+    char *chunkEnd = nullptr;
+    size_t numLive;
+    size_t peakLive;
+    size_t maxFrameSize;
+};
+
+//*****************************************************************************
+// How an agent's trip ended (the value it co_returns)
+
+enum ECAgentOutcome
+{
+    EC_AGENT_DELIVERED = 0,     // reached its destination
+    EC_AGENT_BALKED,            // saw the queue and did not call
+    EC_AGENT_GAVE_UP,           // called and was not picked up in time, too often
+    EC_NUM_AGENT_OUTCOMES
+};
+
+//*****************************************************************************
+// What an agent sees of the engine. Each agent coroutine takes one by value as
+// its first parameter (the engine passes it; the frame comes from the engine's
+// pool through it) and suspends on the awaitables below. The engine resumes
+// agents between ticks, never from inside the simulation, so an agent may call
+// freely when it wakes.
+
+class ECAgentContext
+{
+public:
+    ECAgentContext(ECAgentEngine &engine, int32_t id) : engine(&engine), id(id) {}
+
+    ECAgentEngine &GetEngine() const { return *engine; }
+    int32_t GetId() const { return id; }
+    int Now() const;
+    // Agents waiting to be picked up at a floor
+    int GetNumWaiting(int floor) const;
+
+    // co_await Sleep(ticks): resume ticks later (at least one)
+    struct SleepAwaiter {
+        ECAgentEngine &engine;
+        int32_t id;
+        int ticks;
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<>) const;
+        void await_resume() const {}
+    };
+    SleepAwaiter Sleep(int ticks) const { return {*engine, id, ticks}; }
+
+    // co_await Call(src, dest, patience): press the button at src; true once a car
+    // picks the agent up, false if none has after patience ticks (the call is then
+    // withdrawn). patience < 0: wait for as long as it takes.
+    struct CallAwaiter {
+        ECAgentEngine &engine;
+        int32_t id;
+        int floorSrc, floorDest, patience;
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<>) const;
+        bool await_resume() const;
+    };
+    CallAwaiter Call(int floorSrc, int floorDest, int patience = -1) const {
+        return {*engine, id, floorSrc, floorDest, patience};
+    }
+
+    // co_await Ride(): after a successful Call, resume at the destination floor
+    struct RideAwaiter {
+        ECAgentEngine &engine;
+        int32_t id;
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<>) const;
+        void await_resume() const {}
+    };
+    RideAwaiter Ride() const { return {*engine, id}; }
+
+    // co_await DoorOpens(floor): resume when a car next stops at the floor; gives the car
+    struct DoorAwaiter {
+        ECAgentEngine &engine;
+        int32_t id;
+        int floor;
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<>) const;
+        int await_resume() const;
+    };
+    DoorAwaiter DoorOpens(int floor) const { return {*engine, id, floor}; }
+
+private:
+    ECAgentEngine *engine;
+    int32_t id;
+};
+
+//*****************************************************************************
+// The coroutine type of an agent. It starts suspended (the engine first resumes
+// it at the agent's arrival time) and stays suspended at the end until the
+// engine has read its outcome and freed the frame.
+
+class ECAgent
+{
+public:
+    struct promise_type {
+        // The frame, plus the pool it came from after it (operator delete only gets the size)
+        template<class... Args>
+        static void *operator new(size_t size, const ECAgentContext &ctx, Args &&...) {
+            ECAgentFramePool &pool = GetPool(ctx);
+            void *frame = pool.Allocate(PoolOffset(size) + sizeof(ECAgentFramePool *));
+            *reinterpret_cast<ECAgentFramePool **>(static_cast<char *>(frame) + PoolOffset(size)) = &pool;
+            return frame;
+        }
+        static void operator delete(void *frame, size_t size) {
+            ECAgentFramePool *pool = *reinterpret_cast<ECAgentFramePool **>(static_cast<char *>(frame) + PoolOffset(size));
+            pool->Free(frame, PoolOffset(size) + sizeof(ECAgentFramePool *));
+        }
+
+        ECAgent get_return_object() { return ECAgent(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(ECAgentOutcome outcomeIn) { outcome = outcomeIn; }
+        void unhandled_exception() { error = std::current_exception(); }
+
+        ECAgentOutcome outcome = EC_AGENT_DELIVERED;
+        std::exception_ptr error;
+
+    private:
+        static size_t PoolOffset(size_t size) { return (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1); }
+        static ECAgentFramePool &GetPool(const ECAgentContext &ctx);
+    };
+
+    ECAgent(ECAgent &&rhs) noexcept : handle(std::exchange(rhs.handle, nullptr)) {}
+    ~ECAgent() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+    ECAgent(const ECAgent &) = delete;
+    ECAgent &operator=(const ECAgent &) = delete;
+
+    // Hand the coroutine over (to the engine)
+    std::coroutine_handle<promise_type> Release() { return std::exchange(handle, nullptr); }
+
+private:
+    explicit ECAgent(std::coroutine_handle<promise_type> h) : handle(h) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+//*****************************************************************************
+// Runs agents over an ECElevatorSimGeneric bank. Each tick: agents whose timer
+// is due wake up, every agent woken (by a timer or by the last tick's events)
+// is resumed in turn, then the simulation takes its step; the simulation's
+// events (a passenger picked up or let off, a car stopping) only mark agents
+// ready for the next round. A suspended agent costs its frame plus a small
+// record here; there are no threads or callbacks per agent. Timers (sleeps,
+// patience) are on a timing wheel: an agent woken some other way cancels its
+// timer, and a tick costs only the timers due.
+
+class ECAgentEngine : private ECSimListener
+{
+public:
+    ECAgentEngine(int numFloors, int numCars = 1);
+    ~ECAgentEngine();
+
+    ECAgentEngine(const ECAgentEngine &) = delete;
+    ECAgentEngine &operator=(const ECAgentEngine &) = delete;
+
+    // Start an agent at 'time': behavior(ECAgentContext, args...) must return ECAgent
+    template<class Behavior, class... Args>
+    int32_t Spawn(int time, Behavior &&behavior, Args &&...args) {
+        int32_t id = NewAgent();
+        std::coroutine_handle<ECAgent::promise_type> handle =
+            behavior(ECAgentContext(*this, id), std::forward<Args>(args)...).Release();
+        Start(id, handle, time);
+        return id;
+    }
+
+    // Run until time lenSim; rethrows an exception escaping an agent
+    void Run(int lenSim);
+
+    int GetTime() const { return sim.GetTime(); }
+    const ECElevatorSimGeneric &GetSim() const { return sim; }
+    const ECAgentFramePool &GetPool() const { return pool; }
+    size_t GetNumLive() const { return agents.size() - freeIds.size(); }
+    int64_t GetNumFinished(ECAgentOutcome outcome) const { return numFinished[outcome]; }
+    // Spawn to the end of the last ride, summed over delivered agents
+    int64_t GetTotalTripTime() const { return totalTripTime; }
+    int64_t GetNumResumes() const { return numResumes; }
+
+private:
+    friend class ECAgentContext;
+    friend struct ECAgent::promise_type;
+
+    enum WaitKind : uint8_t { WAIT_NONE = 0, WAIT_TIMER, WAIT_CALL, WAIT_RIDE, WAIT_DOOR };
+
+    struct Agent {
+        std::coroutine_handle<ECAgent::promise_type> handle;
+        int32_t request = -1;       // current call
+        ECTimingWheel<int32_t>::Handle timer = ECTimingWheel<int32_t>::NO_TIMER;
+        int startTime = 0;
+        int arriveTime = 0;         // of the last ride
+        int32_t doorCar = -1;
+        WaitKind wait = WAIT_NONE;
+        bool boarded = false;
+        bool arrived = false;
+    };
+
+    int32_t NewAgent();
+    void Start(int32_t id, std::coroutine_handle<ECAgent::promise_type> handle, int time);
+    void Suspend(int32_t id, WaitKind kind, int wakeTime);
+    void Wake(int32_t id);
+    void FireTimers();
+    void Finish(int32_t id);
+
+    void PlaceCall(int32_t id, int floorSrc, int floorDest, int patience);
+    void WaitRide(int32_t id) { Suspend(id, WAIT_RIDE, -1); }
+    void WaitDoor(int32_t id, int floor);
+
+    virtual void OnRequestBoarded(int32_t index, const ECElevatorSimRequest &request, int car, int time) override;
+    virtual void OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int boardTime, int car) override;
+    virtual void OnCarStopped(int car, int floor, int time) override;
+
+    ECAgentFramePool pool;
+    std::vector<ECElevatorSimRequest> listRequests;
+    ECElevatorSimGeneric sim;
+    std::vector<Agent> agents;
+    std::vector<int32_t> freeIds;
+    std::vector<int32_t> requestAgent;          // per request: the agent that made it, -1 once done
+    std::vector<int32_t> numWaiting;            // per floor: agents with a call not yet picked up
+    std::vector<std::vector<int32_t>> doorWaiters;      // per floor
+    ECTimingWheel<int32_t> timers;              // agent ids
+    std::vector<std::pair<int, int32_t>> dueTimers;     // (due time, agent) fired this tick
+    std::vector<int32_t> ready;                 // to resume this round
+    std::vector<int32_t> readyNext;             // woken by the simulation, for the next round
+    int64_t numFinished[EC_NUM_AGENT_OUTCOMES] = {};
+    int64_t totalTripTime;
+    int64_t numResumes;
+};
+
+//*****************************************************************************
+// A passenger going from src to dest, optionally changing cars at a transfer
+// floor. It balks if balkQueue or more are already waiting at its floor, and
+// withdraws its call after patience ticks and presses again, giving up after
+// maxPresses presses.
+
+struct ECPassengerProfile {
+    int floorSrc = 1;
+    int floorDest = 2;
+    int transferFloor = 0;      // 0: none
+    int balkQueue = 0;          // 0: never balks
+    int patience = -1;          // < 0: waits forever
+    int maxPresses = 1;
+};
+
+ECAgent ECPassengerAgent(ECAgentContext ctx, ECPassengerProfile profile);
+
+// Driver (main's --agents): a mix of passengers on a bank of cars
+void ECRunAgentBenchmark(std::ostream &os, int numAgents = 1000000, uint32_t seed = 1);
+
+#endif /* ECElevatorAgents_h */
@@ -0,0 +1,460 @@
+//
+//  ECElevatorBatchRunner.cpp
+//
+//
+//  Runs a manifest of simulations as a load -> simulate -> write pipeline
+//
+
+#include "ECElevatorBatchRunner.h"
+#include "ECBoundedQueue.h"
+#include "ECElevatorRequestArena.h"
+#include "ECElevatorResultsWriter.h"
+#include "ECElevatorSimFixed.h"
+#include "ECElevatorTraceArchive.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+//*****************************************************************************
+// Manifest
+
+namespace {
+
+string ResolvePath(const string &dir, const string &path) {
+    if (path.empty() || path[0] == '/' || dir.empty()) {
+        return path;
+    }
+    return dir + path;
+}
+
+} // namespace
+
+vector<ECBatchRun> ECLoadBatchManifest(const string &filename) {
+    ifstream in(filename);
+    if (!in) {
+        throw runtime_error("ECLoadBatchManifest: cannot read " + filename);
+    }
+    size_t slash = filename.find_last_of('/');
+    string dir = slash == string::npos ? "" : filename.substr(0, slash + 1);
+
+    vector<ECBatchRun> runs;
+    string line;
+    for (int lineNumber = 1; getline(in, line); lineNumber++) {
+        istringstream tokens(line);
+        string token;
+        if (!(tokens >> token) || token[0] == '#') {
+            continue;
+        }
+        ECBatchRun run;
+        run.traceFile = ResolvePath(dir, token);
+        while (tokens >> token) {
+            size_t eq = token.find('=');
+            string key = token.substr(0, eq);
+            string value = eq == string::npos ? "" : token.substr(eq + 1);
+            try {
+                if (key == "cars" && !value.empty()) {
+                    run.numCars = stoi(value);
+                } else if (key == "len" && !value.empty()) {
+                    run.lenSim = stoi(value);
+                } else if (key == "out" && !value.empty()) {
+                    run.output = ResolvePath(dir, value);
+                } else {
+                    throw invalid_argument(key);
+                }
+            } catch (const logic_error &) {
+                throw runtime_error(filename + ":" + to_string(lineNumber) + ": bad option '" + token + "'");
+            }
+            if (run.numCars < 1) {
+                throw runtime_error(filename + ":" + to_string(lineNumber) + ": need at least one car");
+            }
+        }
+        runs.push_back(run);
+    }
+    return runs;
+}
+
+//*****************************************************************************
+// Sketch files
+
+namespace {
+
+const char SKETCH_FILE_MAGIC[4] = {'E', 'C', 'S', 'F'};
+
+void ReportPercentiles(ostream &os, const ECQuantileSketch &waitTimes, const ECQuantileSketch &tripTimes) {
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    const char *names[] = {"p50", "p90", "p99", "p99.9"};
+    const ECQuantileSketch *sketches[] = {&waitTimes, &tripTimes};
+    const char *sketchNames[] = {"Wait", "Trip"};
+    os << fixed << setprecision(1);
+    for (int s = 0; s < 2; s++) {
+        const ECQuantileSketch &sketch = *sketches[s];
+        os << sketchNames[s] << " times over " << sketch.GetCount() << " passengers: mean " << sketch.GetMean();
+        for (int i = 0; i < 4; i++) {
+            os << " " << names[i] << " " << sketch.GetQuantile(quantiles[i]);
+        }
+        os << " max " << sketch.GetMax() << "\n";
+    }
+    os << "(percentiles within " << setprecision(2) << 100 * ECQuantileSketch::GetRankError(waitTimes.GetK())
+       << "% in rank)\n" << setprecision(1);
+}
+
+} // namespace
+
+void ECWriteSketchFile(const string &filename, const ECQuantileSketch &waitTimes, const ECQuantileSketch &tripTimes) {
+    ofstream out(filename, ios::binary);
+    out.write(SKETCH_FILE_MAGIC, sizeof(SKETCH_FILE_MAGIC));
+    waitTimes.Write(out);
+    tripTimes.Write(out);
+    if (!out.flush()) {
+        throw runtime_error("ECWriteSketchFile: cannot write " + filename);
+    }
+}
+
+bool ECReportSketchFiles(ostream &os, const vector<string> &filenames) {
+    ECQuantileSketch waitTimes, tripTimes;
+    for (const string &filename : filenames) {
+        ifstream in(filename, ios::binary);
+        char magic[4];
+        ECQuantileSketch wait, trip;
+        if (!in.read(magic, sizeof(magic)) || memcmp(magic, SKETCH_FILE_MAGIC, sizeof(magic)) != 0 ||
+            !wait.Read(in) || !trip.Read(in)) {
+            os << filename << ": not a sketch file\n";
+            return false;
+        }
+        waitTimes.Merge(wait);
+        tripTimes.Merge(trip);
+    }
+    os << filenames.size() << " sketch files\n";
+    ReportPercentiles(os, waitTimes, tripTimes);
+    return true;
+}
+
+//*****************************************************************************
+// Pipeline
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+double Ms(Clock::time_point start, Clock::time_point stop) {
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+struct Serviced {
+    int32_t index;
+    int32_t boardTime;
+    int car;
+};
+
+struct Job {
+    size_t run;
+    int lenSim = 0;
+    vector<ECElevatorSimRequest> requests;
+    vector<Serviced> serviced;              // in the order they arrived
+    ECBatchRunner::RunSummary summary;
+};
+
+// Keeps what the writer stage needs about each delivered passenger
+class ServicedCollector : public ECSimListener
+{
+public:
+    explicit ServicedCollector(vector<Serviced> &serviced) : serviced(serviced) {}
+    virtual void OnRequestServiced(int32_t index, const ECElevatorSimRequest &, int boardTime, int car) override {
+        serviced.push_back({index, boardTime, car});
+    }
+private:
+    vector<Serviced> &serviced;
+};
+
+// A bounded queue between two stages. Push waits while it is full and Pop while
+// it is empty (on the pop/push counters, with std::atomic::wait); Pop returns
+// false once every producer is done and the queue is drained.
+class Channel
+{
+public:
+    Channel(size_t capacity, int numProducers) : queue(capacity), pushes(0), pops(0), producersLeft(numProducers) {}
+
+    void Push(Job *job) {
+        for (;;) {
+            uint32_t seen = pops.load(memory_order_acquire);
+            if (queue.TryPush(job)) {
+                pushes.fetch_add(1, memory_order_release);
+                pushes.notify_all();
+                return;
+            }
+            pops.wait(seen, memory_order_acquire);
+        }
+    }
+
+    bool Pop(Job *&job) {
+        for (;;) {
+            uint32_t seen = pushes.load(memory_order_acquire);
+            if (queue.TryPop(job)) {
+                pops.fetch_add(1, memory_order_release);
+                pops.notify_all();
+                return true;
+            }
+            if (producersLeft.load(memory_order_acquire) == 0) {
+                // The last push happened before the last producer left
+                if (queue.TryPop(job)) {
+                    pops.fetch_add(1, memory_order_release);
+                    pops.notify_all();
+                    return true;
+                }
+                return false;
+            }
+            pushes.wait(seen, memory_order_acquire);
+        }
+    }
+
+    void ProducerDone() {
+        if (producersLeft.fetch_sub(1, memory_order_acq_rel) == 1) {
+            pushes.fetch_add(1, memory_order_release);
+            pushes.notify_all();
+        }
+    }
+
+private:
+    ECBoundedQueue<Job *> queue;
+    atomic<uint32_t> pushes;
+    atomic<uint32_t> pops;
+    atomic<int> producersLeft;
+};
+
+} // namespace
+
+ECBatchRunner::ECBatchRunner(const vector<ECBatchRun> &runs, const ECBatchOptions &optionsIn)
+    : runs(runs), options(optionsIn), summaries(runs.size()), wallMs(0) {
+    options.numLoaders = max(options.numLoaders, 1);
+    if (options.numWorkers <= 0) {
+        options.numWorkers = max(1u, thread::hardware_concurrency());
+    }
+    if (options.queueDepth <= 0) {
+        options.queueDepth = 2 * options.numWorkers;
+    }
+    stages[0].name = "load";
+    stages[1].name = "simulate";
+    stages[2].name = "write";
+}
+
+void ECBatchRunner::Run() {
+    Channel loaded(options.queueDepth, options.numLoaders);
+    Channel simulated(options.queueDepth, options.numWorkers);
+    atomic<size_t> nextRun(0);
+    mutex statsLock;
+    for (StageStats &stage : stages) {
+        stage.numThreads = 0;
+        stage.busyMs = stage.starvedMs = stage.blockedMs = 0;
+    }
+    waitTimes.Clear();
+    tripTimes.Clear();
+
+    // Each thread adds its times to its stage when it is done
+    auto addStats = [&](int stage, double busy, double starved, double blocked) {
+        lock_guard<mutex> lock(statsLock);
+        stages[stage].numThreads++;
+        stages[stage].busyMs += busy;
+        stages[stage].starvedMs += starved;
+        stages[stage].blockedMs += blocked;
+    };
+
+    auto loader = [&]() {
+        double busy = 0, blocked = 0;
+        for (size_t i; (i = nextRun.fetch_add(1)) < runs.size(); ) {
+            Clock::time_point start = Clock::now();
+            Job *job = new Job;
+            job->run = i;
+            ECRequestArena arena;
+            ECCompactTrace trace;
+            if (ECIsTraceArchive(runs[i].traceFile)) {
+                // Loader threads already run side by side, so each decodes on its own
+                ECTraceArchive archive;
+                vector<ECCompactRequest> requests;
+                try {
+                    if (!archive.Open(runs[i].traceFile)) {
+                        throw runtime_error("cannot read " + runs[i].traceFile);
+                    }
+                    archive.Read(INT_MIN, INT_MAX, requests, 1);
+                    job->summary.numFloors = archive.GetNumFloors();
+                    job->summary.numRequests = requests.size();
+                    job->lenSim = runs[i].lenSim >= 0 ? runs[i].lenSim : archive.GetLenSim();
+                    job->requests.reserve(requests.size());
+                    for (const ECCompactRequest &request : requests) {
+                        job->requests.push_back(ECElevatorSimRequest(request.GetTime(), request.GetFloorSrc(), request.GetFloorDest()));
+                    }
+                } catch (const exception &e) {
+                    job->summary.error = e.what();
+                }
+            } else if (!ECLoadCompactTrace(runs[i].traceFile, arena, trace)) {
+                job->summary.error = "cannot read " + runs[i].traceFile;
+            } else {
+                job->summary.numFloors = trace.numFloors;
+                job->summary.numRequests = trace.numRequests;
+                job->lenSim = runs[i].lenSim >= 0 ? runs[i].lenSim : trace.lenSim;
+                job->requests.reserve(trace.numRequests);
+                for (const ECCompactRequest &request : trace) {
+                    job->requests.push_back(ECElevatorSimRequest(request.GetTime(), request.GetFloorSrc(), request.GetFloorDest()));
+                }
+            }
+            Clock::time_point loadedAt = Clock::now();
+            job->summary.loadMs = Ms(start, loadedAt);
+            busy += job->summary.loadMs;
+            loaded.Push(job);
+            blocked += Ms(loadedAt, Clock::now());
+        }
+        loaded.ProducerDone();
+        addStats(0, busy, 0, blocked);
+    };
+
+    auto worker = [&]() {
+        double busy = 0, starved = 0, blocked = 0;
+        ECQuantileSketch threadWait, threadTrip;
+        Job *job;
+        for (;;) {
+            Clock::time_point waitStart = Clock::now();
+            if (!loaded.Pop(job)) {
+                starved += Ms(waitStart, Clock::now());
+                break;
+            }
+            Clock::time_point start = Clock::now();
+            starved += Ms(waitStart, start);
+            RunSummary &summary = job->summary;
+            if (summary.error.empty()) {
+                try {
+                    job->serviced.reserve(job->requests.size());
+                    ServicedCollector collector(job->serviced);
+                    ECElevatorSimGeneric sim(summary.numFloors, job->requests, runs[job->run].numCars);
+                    sim.SetListener(&collector);
+                    sim.Simulate(job->lenSim);
+                } catch (const exception &e) {
+                    summary.error = e.what();
+                }
+                summary.numDelivered = job->serviced.size();
+            }
+            // A run that threw stopped part way: its times would skew the percentiles
+            if (summary.error.empty()) {
+                for (const Serviced &s : job->serviced) {
+                    const ECElevatorSimRequest &request = job->requests[s.index];
+                    summary.waitTimes.Add(s.boardTime >= 0 ? s.boardTime - request.GetTime() : 0);
+                    summary.tripTimes.Add(request.GetArriveTime() - request.GetTime());
+                }
+                threadWait.Merge(summary.waitTimes);
+                threadTrip.Merge(summary.tripTimes);
+            }
+            Clock::time_point simulatedAt = Clock::now();
+            summary.simMs = Ms(start, simulatedAt);
+            busy += summary.simMs;
+            simulated.Push(job);
+            blocked += Ms(simulatedAt, Clock::now());
+        }
+        simulated.ProducerDone();
+        addStats(1, busy, starved, blocked);
+        lock_guard<mutex> lock(statsLock);
+        waitTimes.Merge(threadWait);
+        tripTimes.Merge(threadTrip);
+    };
+
+    auto writer = [&]() {
+        double busy = 0, starved = 0;
+        Job *job;
+        for (;;) {
+            Clock::time_point waitStart = Clock::now();
+            if (!simulated.Pop(job)) {
+                starved += Ms(waitStart, Clock::now());
+                break;
+            }
+            Clock::time_point start = Clock::now();
+            starved += Ms(waitStart, start);
+            RunSummary &summary = job->summary;
+            const string &output = runs[job->run].output;
+            if (summary.error.empty() && !output.empty()) {
+                try {
+                    ECResultsWriter results(output, ECResultsWriter::FormatFromName(output));
+                    for (const Serviced &s : job->serviced) {
+                        const ECElevatorSimRequest &request = job->requests[s.index];
+                        results.Add(s.index, request.GetTime(), s.boardTime, request.GetArriveTime(),
+                                    request.GetFloorSrc(), request.GetFloorDest(), s.car);
+                    }
+                    results.Close();
+                } catch (const exception &e) {
+                    summary.error = e.what();
+                }
+            }
+            summary.writeMs = Ms(start, Clock::now());
+            busy += summary.writeMs;
+            summaries[job->run] = summary;
+            delete job;
+        }
+        addStats(2, busy, starved, 0);
+    };
+
+    Clock::time_point start = Clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < options.numLoaders; i++) {
+        threads.emplace_back(loader);
+    }
+    for (int i = 0; i < options.numWorkers; i++) {
+        threads.emplace_back(worker);
+    }
+    threads.emplace_back(writer);
+    for (thread &t : threads) {
+        t.join();
+    }
+    wallMs = Ms(start, Clock::now());
+
+    if (!options.sketchFile.empty()) {
+        ECWriteSketchFile(options.sketchFile, waitTimes, tripTimes);
+    }
+}
+
+int ECBatchRunner::GetNumFailed() const {
+    int numFailed = 0;
+    for (const RunSummary &summary : summaries) {
+        numFailed += !summary.error.empty();
+    }
+    return numFailed;
+}
+
+void ECBatchRunner::Report(ostream &os) const {
+    int64_t numRequests = 0;
+    os << fixed << setprecision(1);
+    for (size_t i = 0; i < runs.size(); i++) {
+        const RunSummary &summary = summaries[i];
+        os << runs[i].traceFile << ": ";
+        if (!summary.error.empty()) {
+            os << "FAILED: " << summary.error << "\n";
+            continue;
+        }
+        numRequests += summary.numRequests;
+        os << summary.numFloors << " floors, " << runs[i].numCars << (runs[i].numCars == 1 ? " car, " : " cars, ")
+           << summary.numRequests << " requests, " << summary.numDelivered << " delivered, wait mean "
+           << summary.waitTimes.GetMean() << " p99 " << summary.waitTimes.GetQuantile(0.99) << ", trip mean "
+           << summary.tripTimes.GetMean() << " p99 " << summary.tripTimes.GetQuantile(0.99) << " (load " << summary.loadMs
+           << " ms, simulate " << summary.simMs << " ms, write " << summary.writeMs << " ms)\n";
+    }
+
+    os << runs.size() << " runs, " << GetNumFailed() << " failed, " << numRequests << " requests in " << wallMs << " ms";
+    if (wallMs > 0) {
+        os << " (" << setprecision(0) << numRequests / wallMs * 1000 << " requests/s)" << setprecision(1);
+    }
+    os << "\n";
+    ReportPercentiles(os, waitTimes, tripTimes);
+    os << "Stage utilization (share of the stage's thread time):\n";
+    for (const StageStats &stage : stages) {
+        double total = wallMs * max(stage.numThreads, 1);
+        auto percent = [total](double ms) { return total > 0 ? 100 * ms / total : 0.0; };
+        os << "  " << left << setw(9) << stage.name << right << setw(3) << stage.numThreads
+           << (stage.numThreads == 1 ? " thread   busy " : " threads  busy ") << setw(5) << percent(stage.busyMs)
+           << "%  starved " << setw(5) << percent(stage.starvedMs) << "%  blocked " << setw(5) << percent(stage.blockedMs) << "%\n";
+    }
+}
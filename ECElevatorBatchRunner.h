@@ -0,0 +1,107 @@
+//
+//  ECElevatorBatchRunner.h
+//
+//
+//  Runs a manifest of simulations as a load -> simulate -> write pipeline
+//
+
+#ifndef ECElevatorBatchRunner_h
+#define ECElevatorBatchRunner_h
+
+#include "ECQuantileSketch.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// Manifest: one run per line, "# comments" and blank lines ignored:
+//
+//   <trace file> [cars=N] [len=T] [out=<results file>]
+//
+// cars: size of the bank (default 1); len: run length, overriding the trace's;
+// out: per-passenger results (ECResultsWriter; ".csv" for text). Relative paths
+// are taken from the manifest's directory.
+
+struct ECBatchRun {
+    std::string traceFile;
+    int numCars = 1;
+    int lenSim = -1;            // -1: from the trace
+    std::string output;         // empty: no results file
+};
+
+// Throws std::runtime_error if the manifest cannot be read or a line is malformed
+std::vector<ECBatchRun> ECLoadBatchManifest(const std::string &filename);
+
+struct ECBatchOptions {
+    int numLoaders = 2;         // threads reading and parsing traces
+    int numWorkers = 0;         // simulation threads; 0: one per core
+    int queueDepth = 0;         // traces waiting between two stages; 0: 2 per worker
+    std::string sketchFile;     // if set, the batch's wait and trip sketches are saved here
+};
+
+//*****************************************************************************
+// Three stages joined by bounded queues (ECBoundedQueue), so at most a few
+// traces are in memory at once and a slow stage holds the others back instead
+// of piling up work:
+//   load      read and parse the next traces (numLoaders threads)
+//   simulate  run ECElevatorSimGeneric on them (numWorkers threads)
+//   write     write the results files and record the summaries (one thread)
+// Every thread measures how long it works, waits for input (starved) and waits
+// for room in the next queue (blocked). A failed run (unreadable trace, write
+// error) is reported and does not stop the batch.
+//
+// Wait and trip times go into quantile sketches (ECQuantileSketch) rather than
+// being kept: one pair per run, merged into one pair per worker thread, merged
+// into the batch's pair at the end. The batch's pair can be saved and merged
+// with other batches' (ECReportSketchFiles).
+
+class ECBatchRunner
+{
+public:
+    ECBatchRunner(const std::vector<ECBatchRun> &runs, const ECBatchOptions &options = ECBatchOptions());
+
+    void Run();
+
+    // One line per run in manifest order, then the totals and per-stage utilization
+    void Report(std::ostream &os) const;
+    int GetNumFailed() const;
+
+    struct RunSummary {
+        int numFloors = 0;
+        int64_t numRequests = 0;
+        int64_t numDelivered = 0;
+        ECQuantileSketch waitTimes;     // request to pick up, in ticks, over delivered requests
+        ECQuantileSketch tripTimes;     // request to arrival
+        double loadMs = 0, simMs = 0, writeMs = 0;
+        std::string error;          // empty if the run succeeded
+    };
+    const RunSummary &GetSummary(size_t run) const { return summaries[run]; }
+    const ECQuantileSketch &GetWaitTimes() const { return waitTimes; }
+    const ECQuantileSketch &GetTripTimes() const { return tripTimes; }
+
+private:
+    struct StageStats {
+        const char *name;
+        int numThreads = 0;
+        double busyMs = 0, starvedMs = 0, blockedMs = 0;
+    };
+
+    std::vector<ECBatchRun> runs;
+    ECBatchOptions options;
+    std::vector<RunSummary> summaries;
+    StageStats stages[3];
+    ECQuantileSketch waitTimes;
+    ECQuantileSketch tripTimes;
+    double wallMs;
+};
+
+//*****************************************************************************
+// Sketch files (ECBatchOptions::sketchFile): "ECSF", then the wait and trip
+// sketches. Throws std::runtime_error on a write error.
+void ECWriteSketchFile(const std::string &filename, const ECQuantileSketch &waitTimes, const ECQuantileSketch &tripTimes);
+// Merge the sketch files and print the combined percentiles; returns false if a
+// file could not be read
+bool ECReportSketchFiles(std::ostream &os, const std::vector<std::string> &filenames);
+
+#endif /* ECElevatorBatchRunner_h */
@@ -0,0 +1,193 @@
+//
+//  ECElevatorBench.cpp
+//
+//
+//  Throughput benchmarks for the simulation engines
+//
+
+#include "ECElevatorBench.h"
+#include "ECElevatorSimCompact.h"
+#include "ECElevatorSimSoA.h"
+#include "ECElevatorSimFixed.h"
+#include "ECElevatorSimBatch.h"
+#include "ECElevatorSimBank.h"
+#include "ECAllocTracker.h"
+#include <chrono>
+#include <iomanip>
+#include <optional>
+#include <random>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+template<int Floors>
+void RunFixed(int numFloors, int lenSim, vector<ECElevatorSimRequest> &listRequests) {
+    ECElevatorSimT<Floors, 1> sim(numFloors, listRequests);
+    sim.Simulate(lenSim);
+}
+
+void RunCompact(int numFloors, int lenSim, vector<ECElevatorSimRequest> &listRequests, bool guarded = false) {
+    ECRequestArena arena;
+    ECCompactTrace trace;
+    trace.numFloors = numFloors;
+    trace.lenSim = lenSim;
+    trace.numRequests = listRequests.size();
+    trace.requests = arena.AllocateArray<ECCompactRequest>(trace.numRequests);
+    for (size_t i = 0; i < listRequests.size(); i++) {
+        trace.requests[i] = ECCompactRequest(listRequests[i].GetTime(), listRequests[i].GetFloorSrc(), listRequests[i].GetFloorDest());
+    }
+    ECElevatorSimCompact sim(numFloors, trace);
+    {
+        optional<ECAllocTickGuard> guard;
+        if (guarded) {
+            guard.emplace();
+        }
+        sim.Simulate(lenSim);
+    }
+    for (size_t i = 0; i < listRequests.size(); i++) {
+        listRequests[i].SetFloorRequestDone(trace.requests[i].IsFloorRequestDone());
+        listRequests[i].SetServiced(trace.requests[i].IsServiced());
+        listRequests[i].SetArriveTime(trace.requests[i].GetArriveTime());
+    }
+}
+
+void RunBatch(int numFloors, int lenSim, vector<ECElevatorSimRequest> &listRequests) {
+    ECElevatorSimBatch sim;
+    sim.AddScenario(numFloors, lenSim, listRequests);
+    sim.Simulate();
+}
+
+bool SameResults(const vector<ECElevatorSimRequest> &a, const vector<ECElevatorSimRequest> &b) {
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].IsServiced() != b[i].IsServiced() || a[i].GetArriveTime() != b[i].GetArriveTime()) {
+            return false;
+        }
+    }
+    return a.size() == b.size();
+}
+
+// Best time over 'repeat' runs, in milliseconds
+double TimeEngine(const ECEngineRun &run, int numFloors, int lenSim, const vector<ECElevatorSimRequest> &trace,
+                  int repeat, vector<ECElevatorSimRequest> &result) {
+    double best = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        result = trace;
+        auto start = chrono::steady_clock::now();
+        run(numFloors, lenSim, result);
+        auto stop = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double, milli>(stop - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+vector<ECElevatorSimRequest> ECMakeRandomTrace(uint32_t seed, int numFloors, int numRequests, int lenRequests) {
+    mt19937 rng(seed);
+    vector<ECElevatorSimRequest> trace;
+    trace.reserve(numRequests);
+    for (int i = 0; i < numRequests; i++) {
+        int floorSrc = 1 + rng() % numFloors;
+        int floorDest = 1 + rng() % (numFloors - 1);
+        if (floorDest >= floorSrc) {
+            floorDest++;
+        }
+        trace.push_back(ECElevatorSimRequest(rng() % max(lenRequests, 1), floorSrc, floorDest));
+    }
+    return trace;
+}
+
+vector<ECEngineEntry> ECGetEngines(int numFloors) {
+    vector<ECEngineEntry> engines = {
+        {"ECElevatorSim", [](int nf, int len, vector<ECElevatorSimRequest> &l) { ECElevatorSim sim(nf, l); sim.Simulate(len); }},
+        {"ECElevatorSimCompact", [](int nf, int len, vector<ECElevatorSimRequest> &l) { RunCompact(nf, len, l); }},
+        {"ECElevatorSimSoA", [](int nf, int len, vector<ECElevatorSimRequest> &l) { ECElevatorSimSoA sim(nf, l); sim.Simulate(len); }},
+        {"ECElevatorSimBatch", RunBatch},
+        {"ECElevatorSimGeneric", [](int nf, int len, vector<ECElevatorSimRequest> &l) { ECElevatorSimGeneric sim(nf, l); sim.Simulate(len); }},
+        {"ECElevatorSimBank", [](int nf, int len, vector<ECElevatorSimRequest> &l) { ECElevatorSimBank sim(nf, l, 1); sim.Simulate(len); }},
+    };
+    // The smallest compiled-in building that fits
+    if (numFloors <= 10) {
+        engines.push_back({"ECElevatorSimT<10,1>", RunFixed<10>});
+    } else if (numFloors <= 20) {
+        engines.push_back({"ECElevatorSimT<20,1>", RunFixed<20>});
+    } else if (numFloors <= 40) {
+        engines.push_back({"ECElevatorSimT<40,1>", RunFixed<40>});
+    }
+    return engines;
+}
+
+void ECRunEngineBenchmarks(ostream &os, int repeat) {
+    struct Config {
+        int numFloors;
+        int numRequests;
+    };
+    const Config configs[] = {
+        {10, 500},
+        {20, 2000},
+        {40, 5000},
+    };
+
+    os << "Engine kernels: " << ECKernelGetPathName() << "\n";
+    for (const Config &config : configs) {
+        int lenRequests = config.numRequests * 4;
+        int lenSim = lenRequests + config.numRequests * config.numFloors;
+        vector<ECElevatorSimRequest> trace = ECMakeRandomTrace(2023, config.numFloors, config.numRequests, lenRequests);
+
+        vector<ECEngineEntry> engines = ECGetEngines(config.numFloors);
+
+        os << config.numFloors << " floors, " << config.numRequests << " requests, " << lenSim << " ticks\n";
+        vector<ECElevatorSimRequest> reference, result;
+        double msReference = TimeEngine(engines[0].run, config.numFloors, lenSim, trace, repeat, reference);
+        for (size_t e = 0; e < engines.size(); e++) {
+            const ECEngineEntry &engine = engines[e];
+            double ms = e == 0 ? msReference : TimeEngine(engine.run, config.numFloors, lenSim, trace, repeat, result);
+            if (e == 0) {
+                result = reference;
+            }
+            os << "  " << left << setw(24) << engine.name << right << fixed << setprecision(3)
+               << setw(10) << ms << " ms  x" << setprecision(1) << msReference / ms
+               << (SameResults(reference, result) ? "" : "  RESULTS DIFFER") << "\n";
+        }
+    }
+}
+
+int ECCheckEngineAllocations(ostream &os) {
+    const int numFloors = 20;
+    const int numRequests = 2000;
+    const int lenSim = numRequests * 4 + numRequests * numFloors;
+    const vector<ECElevatorSimRequest> trace = ECMakeRandomTrace(2023, numFloors, numRequests, numRequests * 4);
+
+    // Setup (construction, sorting the trace) may allocate; the ticks may not
+    auto simulateGuarded = [lenSim](auto &sim) {
+        ECAllocTickGuard guard;
+        sim.Simulate(lenSim);
+    };
+    auto stepGuarded = [lenSim](auto &sim) {
+        while (sim.GetTime() < lenSim) {
+            ECAllocTickGuard guard;
+            sim.Step();
+        }
+    };
+
+    int numFailed = 0;
+    auto check = [&](const char *name, const function<void(vector<ECElevatorSimRequest> &)> &run) {
+        vector<ECElevatorSimRequest> listRequests = trace;
+        ECAllocScope scope;
+        run(listRequests);
+        scope.Report(os, name);
+        if (scope.GetStats().numViolations > 0) {
+            numFailed++;
+        }
+    };
+    check("ECElevatorSim", [&](vector<ECElevatorSimRequest> &l) { ECElevatorSim sim(numFloors, l); simulateGuarded(sim); });
+    check("ECElevatorSimCompact", [&](vector<ECElevatorSimRequest> &l) { RunCompact(numFloors, lenSim, l, true); });
+    check("ECElevatorSimSoA", [&](vector<ECElevatorSimRequest> &l) { ECElevatorSimSoA sim(numFloors, l); simulateGuarded(sim); });
+    check("ECElevatorSimBatch", [&](vector<ECElevatorSimRequest> &l) { RunBatch(numFloors, lenSim, l); });
+    check("ECElevatorSimGeneric", [&](vector<ECElevatorSimRequest> &l) { ECElevatorSimGeneric sim(numFloors, l); stepGuarded(sim); });
+    check("ECElevatorSimT<20,1>", [&](vector<ECElevatorSimRequest> &l) { ECElevatorSimT<20, 1> sim(numFloors, l); stepGuarded(sim); });
+    check("ECElevatorSimGeneric, 4 cars", [&](vector<ECElevatorSimRequest> &l) { ECElevatorSimGeneric sim(numFloors, l, 4); stepGuarded(sim); });
+    return numFailed;
+}
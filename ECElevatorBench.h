@@ -0,0 +1,47 @@
+//
+//  ECElevatorBench.h
+//
+//
+//  Throughput benchmarks for the simulation engines
+//
+
+#ifndef ECElevatorBench_h
+#define ECElevatorBench_h
+
+#include "ECElevatorSim.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Runs one engine on a request list in place, as ECElevatorSim::Simulate would
+typedef std::function<void(int numFloors, int lenSim, std::vector<ECElevatorSimRequest> &listRequests)> ECEngineRun;
+
+struct ECEngineEntry {
+    std::string name;
+    ECEngineRun run;
+};
+
+// Every engine that can run a numFloors building with one car: ECElevatorSim
+// (the reference) first, then the optimized engines
+std::vector<ECEngineEntry> ECGetEngines(int numFloors);
+
+// Random trace: numRequests requests with times in [0, lenRequests), source and
+// destination floors in [1, numFloors], source != destination
+std::vector<ECElevatorSimRequest> ECMakeRandomTrace(uint32_t seed, int numFloors, int numRequests, int lenRequests);
+
+// Time every engine on a few standard building configurations and print one line
+// per engine with its time per run and speedup over ECElevatorSim. Each engine's
+// results are also checked against ECElevatorSim.
+void ECRunEngineBenchmarks(std::ostream &os, int repeat = 5);
+
+// Check that the engines allocate nothing per tick once constructed (needs
+// ECAllocTracker.cpp linked in). Each engine runs a random trace inside an
+// ECAllocScope; ECElevatorSimT is guarded tick by tick, the others around
+// Simulate. ECElevatorSimBatch sizes its tables per group inside Simulate, so it
+// is only measured. Prints one line per engine; returns the number that allocated
+// inside a guard.
+int ECCheckEngineAllocations(std::ostream &os);
+
+#endif /* ECElevatorBench_h */
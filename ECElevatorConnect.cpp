@@ -1,72 +1,104 @@
 #include "ECElevatorConnect.h"
 #include "ECElevatorObserver.h"
 #include <algorithm>
-#include <sstream>
+#include <climits>
 #include <iostream>
 
 ECElevatorConnect::ECElevatorConnect(const std::string& fname, ECElevatorObserver* observer) 
-    : filename(fname), nextPassengerIndex(0), elevatorObserver(observer),
-      totalPassengers(0), deliveredPassengers(0) {}
+    : filename(fname), batchNext(nullptr), batchEnd(nullptr), nextPassengerIndex(0), elevatorObserver(observer),
+      totalPassengers(0), deliveredPassengers(0), currentTime(0) {}
 
 void ECElevatorConnect::LoadSimulation() {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
+    if (ECIsTraceArchive(filename)) {
+        archive.reset(new ECTraceArchive);
+        if (!archive->Open(filename)) {
+            std::cerr << "Error: Could not read trace archive " << filename << std::endl;
+            archive.reset();
+            return;
+        }
+        numFloors = archive->GetNumFloors();
+        totalTime = archive->GetLenSim();
+        totalPassengers = static_cast<int>(std::min<uint64_t>(archive->GetNumRequests(), INT_MAX));
+        stream.reset(new ECTraceArchiveStream(*archive, INT_MIN));
+        if (elevatorObserver) {
+            // The archive may be far larger than what is on screen at once. Frames
+            // with more passengers than this in view grow the lists (and are
+            // counted by --alloc-check); the decoder thread's allocations are not.
+            elevatorObserver->ReservePassengers(std::min(totalPassengers, 1 << 16));
+        }
         return;
     }
 
-    std::string line;
-    
-    // Skip comment lines
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] != '#') {
-            break;
-        }
+    // Passengers are read straight into the arena and sorted by arrival time
+    if (!ECLoadCompactTrace(filename, arena, passengers, true)) {
+        std::cerr << "Error: Could not load " << filename << " (missing, or a value out of range)" << std::endl;
+        return;
     }
-    
-    // Parse first non-comment line for floors and time
-    std::stringstream ss(line);
-    ss >> numFloors >> totalTime;
-    
-    // Read passenger information
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;
-        
-        int time, start, dest;
-        std::stringstream ss(line);
-        ss >> time >> start >> dest;
-        passengers.push_back(PassengerInfo(time, start, dest));
-        totalPassengers++;
+
+    numFloors = passengers.numFloors;
+    totalTime = passengers.lenSim;
+    totalPassengers = static_cast<int>(passengers.numRequests);
+    batchNext = passengers.begin();
+    batchEnd = passengers.end();
+    if (elevatorObserver) {
+        elevatorObserver->ReservePassengers(totalPassengers);
     }
-    
-    // Sort passengers by arrival time
-    std::sort(passengers.begin(), passengers.end(),
-              [](const PassengerInfo& a, const PassengerInfo& b) {
-                  return a.arrivalTime < b.arrivalTime;
-              });
 }
 
-void ECElevatorConnect::Update(int currentTime) {
-    while (nextPassengerIndex < passengers.size() && 
-           passengers[nextPassengerIndex].arrivalTime <= currentTime) {
-        AddPassenger(passengers[nextPassengerIndex]);
+void ECElevatorConnect::Update(int time) {
+    currentTime = time;
+    while ((batchNext != batchEnd || NextBlock()) && batchNext->GetTime() <= currentTime) {
+        AddPassenger(*batchNext++);
         nextPassengerIndex++;
     }
 }
 
-void ECElevatorConnect::AddPassenger(const PassengerInfo& passenger) {
-    // Call the appropriate method in ECElevatorObserver to add a passenger
-    // This will depend on your ECElevatorObserver implementation
-    // For example:
-    if (passenger.destFloor > passenger.startFloor) {
-        // Going up
-        elevatorObserver->AddPassenger(passenger.startFloor, passenger.destFloor, true);
-    } else {
-        // Going down
-        elevatorObserver->AddPassenger(passenger.startFloor, passenger.destFloor, false);
+bool ECElevatorConnect::NextBlock() {
+    if (!stream) {
+        return false;
+    }
+    try {
+        do {
+            if (!stream->Next(block)) {
+                stream.reset();
+                return false;
+            }
+        } while (block.empty());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        stream.reset();
+        return false;
+    }
+    // The observer copies the records it is given, so the block's storage goes back
+    // to the stream at the next call
+    batchNext = block.data();
+    batchEnd = block.data() + block.size();
+    return true;
+}
+
+void ECElevatorConnect::AddPassenger(const ECCompactRequest& passenger) {
+    elevatorObserver->AddPassenger(passenger);
+
+    if (HasSubscribers(EC_EVENT_SIM_STATE)) {
+        ECEvent evt(EC_EVENT_SIM_STATE, EC_SIM_PASSENGER_ARRIVED);
+        evt.tick = passenger.GetTime();
+        evt.value = passenger.GetFloorSrc();
+        Notify(evt);
+    }
+}
+
+void ECElevatorConnect::IncrementDeliveredPassengers(int floor) {
+    deliveredPassengers++;
+
+    if (HasSubscribers(EC_EVENT_SIM_STATE)) {
+        ECEvent evt(EC_EVENT_SIM_STATE, EC_SIM_PASSENGER_DELIVERED);
+        evt.tick = currentTime;
+        evt.value = floor;
+        Notify(evt);
     }
 }
 
 bool ECElevatorConnect::HasMorePassengers() const {
-    return nextPassengerIndex < passengers.size();
+    return batchNext != batchEnd || stream != nullptr;
 }
\ No newline at end of file
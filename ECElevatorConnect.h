@@ -2,28 +2,34 @@
 #define ECElevatorConnect_h
 
 #include "ECElevatorObserver.h"
+#include "ECObserver.h"
+#include "ECElevatorRequestArena.h"
+#include "ECElevatorTraceArchive.h"
 #include <vector>
 #include <string>
 #include <fstream>
+#include <memory>
 
 // Connection between simulation and visualization
 // Purpose: Bridges simulation data with visual representation
 
-// PassengerInfo struct (Lines 9-16)
-// Purpose: Data structure for passenger information from input file
+// Passenger data from the input file is kept as ECCompactRequest records. A text
+// trace is loaded whole into a per-run arena. A trace archive (ECTraceArchive) is
+// streamed: a background thread decodes its blocks ahead of the viewer, and a
+// block's storage is reused once the viewer has taken its passengers, so memory
+// use does not grow with the archive. The observer keeps its own copy of each
+// passenger's record.
 
-struct PassengerInfo {
-    int arrivalTime;
-    int startFloor;
-    int destFloor;
-    
-    PassengerInfo(int time, int start, int dest) 
-        : arrivalTime(time), startFloor(start), destFloor(dest) {}
+// Codes of the EC_EVENT_SIM_STATE events sent to subscribers; the event's tick is
+// the simulation time and its value the floor.
+enum ECSimStateCode {
+    EC_SIM_PASSENGER_ARRIVED = 0,   // a passenger appeared at its start floor
+    EC_SIM_PASSENGER_DELIVERED      // a passenger got off at its destination
 };
 
 class ECElevatorObserver;
 
-class ECElevatorConnect {
+class ECElevatorConnect : public ECObserverSubject {
 public:
     ECElevatorConnect(const std::string& filename, ECElevatorObserver* observer);
     void LoadSimulation();
@@ -33,18 +39,27 @@ public:
     int GetNumFloors() const { return numFloors; }
     int GetTotalPassengers() const { return totalPassengers; }
     int GetDeliveredPassengers() const { return deliveredPassengers; }
-    void IncrementDeliveredPassengers() { deliveredPassengers++; }
+    void IncrementDeliveredPassengers(int floor = 0);
     
 private:
-    void AddPassenger(const PassengerInfo& passenger);
+    void AddPassenger(const ECCompactRequest& passenger);
+    // Move on to the next decoded block of an archive; false if there is none
+    bool NextBlock();
     
     std::string filename;
     int numFloors;
     int totalTime;
     int totalPassengers;
     int deliveredPassengers;
-    std::vector<PassengerInfo> passengers;
+    ECRequestArena arena;
+    ECCompactTrace passengers;
+    std::unique_ptr<ECTraceArchive> archive;
+    std::unique_ptr<ECTraceArchiveStream> stream;   // after archive: stopped before it is closed
+    std::vector<ECCompactRequest> block;            // the last block taken from the stream
+    const ECCompactRequest* batchNext;              // passengers not added yet (in the arena or block)
+    const ECCompactRequest* batchEnd;
     size_t nextPassengerIndex;
+    int currentTime;
     ECElevatorObserver* elevatorObserver;
 };
 
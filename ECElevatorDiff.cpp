@@ -0,0 +1,380 @@
+//
+//  ECElevatorDiff.cpp
+//
+//
+//  Differential testing of the optimized engines against ECElevatorSim
+//
+
+#include "ECElevatorDiff.h"
+#include "ECElevatorSimBatch.h"
+#include "ECElevatorSimFixed.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+vector<ECElevatorSimRequest> FreshCopy(const vector<ECElevatorSimRequest> &requests) {
+    vector<ECElevatorSimRequest> copy;
+    copy.reserve(requests.size());
+    for (const ECElevatorSimRequest &r : requests) {
+        copy.push_back(ECElevatorSimRequest(r.GetTime(), r.GetFloorSrc(), r.GetFloorDest()));
+    }
+    return copy;
+}
+
+// Run an engine; false (with the message in 'error') if it throws
+bool RunEngine(const ECEngineRun &run, const ECDiffTrace &trace, vector<ECElevatorSimRequest> &result, string &error) {
+    result = FreshCopy(trace.requests);
+    try {
+        run(trace.numFloors, trace.lenSim, result);
+    } catch (const exception &e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+bool SameResults(const vector<ECElevatorSimRequest> &expected, const vector<ECElevatorSimRequest> &actual, string *what) {
+    for (size_t i = 0; i < expected.size(); i++) {
+        const ECElevatorSimRequest &e = expected[i];
+        const ECElevatorSimRequest &a = actual[i];
+        if (e.IsFloorRequestDone() != a.IsFloorRequestDone() || e.IsServiced() != a.IsServiced() || e.GetArriveTime() != a.GetArriveTime()) {
+            if (what) {
+                ostringstream ss;
+                ss << "request " << i << " (" << e.GetTime() << " " << e.GetFloorSrc() << " " << e.GetFloorDest() << "): expected "
+                   << "picked up=" << e.IsFloorRequestDone() << " serviced=" << e.IsServiced() << " arrive=" << e.GetArriveTime()
+                   << ", got picked up=" << a.IsFloorRequestDone() << " serviced=" << a.IsServiced() << " arrive=" << a.GetArriveTime();
+                *what = ss.str();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Matches(const string &name, const string &filter) {
+    return filter.empty() || name.find(filter) != string::npos;
+}
+
+// Adds a trip back when a request boards, and every third request again two
+// ticks after it is admitted. The request list is shrunk before each add, so
+// every AddRequest moves it.
+class ReentrantListener : public ECSimListener
+{
+public:
+    ReentrantListener(ECElevatorSimGeneric &sim, vector<ECElevatorSimRequest> &requests)
+        : sim(sim), requests(requests), numOriginal(static_cast<int32_t>(requests.size())) {}
+
+    void OnRequestAdmitted(int32_t index, const ECElevatorSimRequest &request, int, int time) override {
+        if (index < numOriginal && index % 3 == 0) {
+            Add(index, request, time + 2, request.GetFloorSrc(), request.GetFloorDest());
+        }
+    }
+    void OnRequestBoarded(int32_t index, const ECElevatorSimRequest &request, int, int time) override {
+        if (index < numOriginal) {
+            Add(index, request, time + 1, request.GetFloorDest(), request.GetFloorSrc());
+        }
+    }
+
+    string error;
+
+private:
+    void Add(int32_t index, const ECElevatorSimRequest &request, int time, int floorSrc, int floorDest) {
+        if (floorSrc <= 0 || floorDest <= 0 || floorSrc == floorDest) {
+            return;
+        }
+        int before = request.GetFloorDest();
+        requests.shrink_to_fit();
+        sim.AddRequest(time, floorSrc, floorDest);
+        if (error.empty() && request.GetFloorDest() != before) {
+            error = "request " + to_string(index) + " changed under the listener while it added a request";
+        }
+    }
+
+    ECElevatorSimGeneric &sim;
+    vector<ECElevatorSimRequest> &requests;
+    int32_t numOriginal;
+};
+
+} // namespace
+
+//*****************************************************************************
+// Traces
+
+ECDiffTrace ECMakeDiffTrace(mt19937 &rng, const ECDiffTraceOptions &options) {
+    auto uniform = [&rng](int lo, int hi) { return lo + static_cast<int>(rng() % static_cast<uint32_t>(hi - lo + 1)); };
+    auto chance = [&rng](double p) { return (rng() % 1000000) < p * 1000000; };
+
+    ECDiffTrace trace;
+    trace.numFloors = uniform(options.minFloors, max(options.minFloors, options.maxFloors));
+    int numRequests = uniform(0, options.maxRequests);
+    int maxTime = max(options.maxTime, 1);
+    int time = 0;
+    for (int i = 0; i < numRequests; i++) {
+        if (!(i > 0 && chance(options.burstRate))) {
+            time = uniform(0, maxTime - 1);
+        }
+        if (chance(options.maintenanceRate)) {
+            trace.requests.push_back(ECElevatorSimRequest(time, -1, -1));
+            trace.requests.push_back(ECElevatorSimRequest(time + uniform(1, 50), 0, 0));
+            continue;
+        }
+        int floorSrc = uniform(1, trace.numFloors);
+        int floorDest = floorSrc;
+        if (!chance(options.sameFloorRate)) {
+            floorDest = uniform(1, trace.numFloors - 1);
+            if (floorDest >= floorSrc) {
+                floorDest++;
+            }
+        }
+        trace.requests.push_back(ECElevatorSimRequest(time, floorSrc, floorDest));
+    }
+    // Anything from cut short mid-run to long enough to finish
+    trace.lenSim = uniform(maxTime / 2, maxTime + numRequests * trace.numFloors);
+    return trace;
+}
+
+void ECWriteDiffTrace(ostream &os, const ECDiffTrace &trace) {
+    os << trace.numFloors << " " << trace.lenSim << "\n";
+    for (const ECElevatorSimRequest &r : trace.requests) {
+        os << r.GetTime() << " " << r.GetFloorSrc() << " " << r.GetFloorDest() << "\n";
+    }
+}
+
+//*****************************************************************************
+// Comparison and shrinking
+
+bool ECDiffCompare(const ECEngineRun &reference, const ECEngineRun &candidate, const ECDiffTrace &trace, string *what) {
+    vector<ECElevatorSimRequest> expected, actual;
+    string error;
+    if (!RunEngine(reference, trace, expected, error)) {
+        if (what) *what = "reference threw: " + error;
+        return false;
+    }
+    if (!RunEngine(candidate, trace, actual, error)) {
+        if (what) *what = "candidate threw: " + error;
+        return false;
+    }
+    return SameResults(expected, actual, what);
+}
+
+bool ECDiffCheckReentrant(const ECEngineRun &reference, const ECDiffTrace &trace, string *what) {
+    vector<ECElevatorSimRequest> actual = FreshCopy(trace.requests);
+    string error;
+    try {
+        ECElevatorSimGeneric sim(trace.numFloors, actual);
+        ReentrantListener listener(sim, actual);
+        sim.SetListener(&listener);
+        sim.Simulate(trace.lenSim);
+        error = listener.error;
+    } catch (const exception &e) {
+        error = string("candidate threw: ") + e.what();
+    }
+    if (!error.empty()) {
+        if (what) *what = error;
+        return false;
+    }
+
+    // The added requests, known from the start, come in at the same ticks
+    ECDiffTrace grown = trace;
+    grown.requests = FreshCopy(actual);
+    vector<ECElevatorSimRequest> expected;
+    if (!RunEngine(reference, grown, expected, error)) {
+        if (what) *what = "reference threw: " + error;
+        return false;
+    }
+    return SameResults(expected, actual, what);
+}
+
+ECDiffTrace ECShrinkDiffTrace(const ECDiffTrace &original, const function<bool(const ECDiffTrace &)> &fails) {
+    ECDiffTrace trace = original;
+    trace.requests = FreshCopy(original.requests);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        // Remove chunks of requests, from half the trace down to single requests
+        for (size_t chunk = max<size_t>(trace.requests.size() / 2, 1); chunk >= 1 && !trace.requests.empty(); chunk /= 2) {
+            for (size_t start = 0; start < trace.requests.size();) {
+                ECDiffTrace smaller = trace;
+                size_t end = min(start + chunk, smaller.requests.size());
+                smaller.requests.erase(smaller.requests.begin() + start, smaller.requests.begin() + end);
+                if (fails(smaller)) {
+                    trace = smaller;
+                    changed = true;
+                } else {
+                    start += chunk;
+                }
+            }
+        }
+
+        // Shorter run: smallest lenSim that still fails, searching downwards
+        for (int step = max(trace.lenSim / 2, 1); step >= 1; step /= 2) {
+            while (trace.lenSim - step >= 0) {
+                ECDiffTrace shorter = trace;
+                shorter.lenSim -= step;
+                if (!fails(shorter)) break;
+                trace = shorter;
+                changed = true;
+            }
+        }
+
+        // Earlier request times
+        for (size_t i = 0; i < trace.requests.size(); i++) {
+            for (int time = 0; time < trace.requests[i].GetTime(); time = time == 0 ? 1 : time * 2) {
+                ECDiffTrace earlier = trace;
+                const ECElevatorSimRequest &r = trace.requests[i];
+                earlier.requests[i] = ECElevatorSimRequest(time, r.GetFloorSrc(), r.GetFloorDest());
+                if (fails(earlier)) {
+                    trace = earlier;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+
+        // Fewer floors, while every request still fits
+        while (trace.numFloors > 1) {
+            ECDiffTrace lower = trace;
+            lower.numFloors--;
+            bool fits = all_of(lower.requests.begin(), lower.requests.end(), [&lower](const ECElevatorSimRequest &r) {
+                return r.GetFloorSrc() <= lower.numFloors && r.GetFloorDest() <= lower.numFloors;
+            });
+            if (!fits || !fails(lower)) break;
+            trace = lower;
+            changed = true;
+        }
+    }
+    return trace;
+}
+
+//*****************************************************************************
+// Drivers
+
+int ECRunDifferential(ostream &os, uint32_t seed, int iterations, const string &filter) {
+    mt19937 rng(seed);
+    ECDiffTraceOptions options;
+    vector<ECEngineEntry> engines = ECGetEngines(options.maxFloors);
+    vector<int> failures(engines.size(), 0);
+    vector<bool> reported(engines.size(), false);
+    int reentrantFailures = 0;
+
+    for (int it = 0; it < iterations; it++) {
+        ECDiffTrace trace = ECMakeDiffTrace(rng, options);
+        engines = ECGetEngines(trace.numFloors);
+        string what;
+        if (filter.empty() && !ECDiffCheckReentrant(engines[0].run, trace, &what) && reentrantFailures++ == 0) {
+            os << "MISMATCH reentrant listener (seed " << seed << ", iteration " << it << "): " << what << "\n";
+            os << "# trace\n";
+            ECWriteDiffTrace(os, trace);
+        }
+        for (size_t e = 1; e < engines.size() && e < failures.size(); e++) {
+            if (!Matches(engines[e].name, filter)) continue;
+            if (ECDiffCompare(engines[0].run, engines[e].run, trace)) continue;
+
+            failures[e]++;
+            if (reported[e]) continue;
+            reported[e] = true;
+
+            const ECEngineRun reference = engines[0].run, candidate = engines[e].run;
+            ECDiffTrace repro = ECShrinkDiffTrace(trace, [&](const ECDiffTrace &t) { return !ECDiffCompare(reference, candidate, t); });
+            string what;
+            ECDiffCompare(reference, candidate, repro, &what);
+            os << "MISMATCH " << engines[e].name << " (seed " << seed << ", iteration " << it << "), shrunk from "
+               << trace.requests.size() << " to " << repro.requests.size() << " requests: " << what << "\n";
+            os << "# repro\n";
+            ECWriteDiffTrace(os, repro);
+        }
+    }
+
+    int numFailed = 0;
+    engines = ECGetEngines(options.maxFloors);
+    for (size_t e = 1; e < engines.size(); e++) {
+        if (!Matches(engines[e].name, filter)) continue;
+        os << "  " << left << setw(24) << engines[e].name << right << (failures[e] ? " FAILED on " : " ok on ")
+           << (failures[e] ? failures[e] : iterations) << " traces\n";
+        numFailed += failures[e] > 0;
+    }
+    if (filter.empty()) {
+        os << "  " << left << setw(24) << "reentrant listener" << right << (reentrantFailures ? " FAILED on " : " ok on ")
+           << (reentrantFailures ? reentrantFailures : iterations) << " traces\n";
+        numFailed += reentrantFailures > 0;
+    }
+    return numFailed;
+}
+
+void ECRunDiffThroughput(ostream &os, uint32_t seed, int numTraces, const string &filter) {
+    mt19937 rng(seed);
+    ECDiffTraceOptions options;
+    options.minFloors = 10;
+    options.maxFloors = 40;
+    options.maxRequests = 3000;
+    options.maxTime = 12000;
+    options.maintenanceRate = 0.001;
+
+    vector<ECDiffTrace> traces;
+    size_t totalRequests = 0;
+    for (int i = 0; i < numTraces; i++) {
+        traces.push_back(ECMakeDiffTrace(rng, options));
+        totalRequests += traces.back().requests.size();
+    }
+
+    // Engines are matched by position; the fixed-size engine's template argument varies with the trace
+    vector<ECEngineEntry> engines = ECGetEngines(options.maxFloors);
+    size_t numEngines = engines.size();
+    vector<double> seconds(numEngines, 0);
+    vector<int> mismatches(numEngines, 0);
+    vector<vector<ECElevatorSimRequest>> expected(traces.size());
+    vector<ECElevatorSimRequest> actual;
+    for (size_t t = 0; t < traces.size(); t++) {
+        const ECDiffTrace &trace = traces[t];
+        vector<ECEngineEntry> traceEngines = ECGetEngines(trace.numFloors);
+        for (size_t e = 0; e < numEngines && e < traceEngines.size(); e++) {
+            // The batch engine is timed below on all traces at once, which is what it is for
+            if (e > 0 && (!Matches(engines[e].name, filter) || engines[e].name == "ECElevatorSimBatch")) continue;
+            vector<ECElevatorSimRequest> &result = e == 0 ? expected[t] : actual;
+            result = FreshCopy(trace.requests);
+            auto start = chrono::steady_clock::now();
+            bool ok = true;
+            try {
+                traceEngines[e].run(trace.numFloors, trace.lenSim, result);
+            } catch (const exception &) {
+                ok = false;
+            }
+            seconds[e] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (e > 0 && (!ok || !SameResults(expected[t], actual, nullptr))) {
+                mismatches[e]++;
+            }
+        }
+    }
+
+    for (size_t e = 1; e < numEngines; e++) {
+        if (engines[e].name != "ECElevatorSimBatch" || !Matches(engines[e].name, filter)) continue;
+        vector<vector<ECElevatorSimRequest>> results(traces.size());
+        ECElevatorSimBatch batch;
+        for (size_t t = 0; t < traces.size(); t++) {
+            results[t] = FreshCopy(traces[t].requests);
+            batch.AddScenario(traces[t].numFloors, traces[t].lenSim, results[t]);
+        }
+        auto start = chrono::steady_clock::now();
+        batch.Simulate();
+        seconds[e] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (size_t t = 0; t < traces.size(); t++) {
+            mismatches[e] += !SameResults(expected[t], results[t], nullptr);
+        }
+    }
+
+    os << numTraces << " traces, " << totalRequests << " requests\n";
+    for (size_t e = 0; e < numEngines; e++) {
+        if (e > 0 && !Matches(engines[e].name, filter)) continue;
+        string name = engines[e].name.find("ECElevatorSimT") == 0 ? "ECElevatorSimT<N,1>" : engines[e].name;
+        os << "  " << left << setw(24) << name << right << fixed << setprecision(3) << setw(10) << seconds[e] * 1000 << " ms  "
+           << setprecision(2) << setw(8) << totalRequests / seconds[e] / 1e6 << " M req/s  x" << setprecision(1) << seconds[0] / seconds[e]
+           << (mismatches[e] ? "  RESULTS DIFFER on " + to_string(mismatches[e]) + " traces" : "") << "\n";
+    }
+}
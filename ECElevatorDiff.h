@@ -0,0 +1,76 @@
+//
+//  ECElevatorDiff.h
+//
+//
+//  Differential testing of the optimized engines against ECElevatorSim
+//
+
+#ifndef ECElevatorDiff_h
+#define ECElevatorDiff_h
+
+#include "ECElevatorBench.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// A trace: what a simulation file holds
+
+struct ECDiffTrace {
+    int numFloors = 0;
+    int lenSim = 0;
+    std::vector<ECElevatorSimRequest> requests;     // fresh requests (nothing simulated yet)
+};
+
+// Shape of the random traces. Floors are always inside the building; besides
+// ordinary requests there are maintenance start/end pairs, bursts of requests at
+// the same time, and requests from a floor to itself.
+struct ECDiffTraceOptions {
+    int minFloors = 2;
+    int maxFloors = 20;
+    int maxRequests = 120;
+    int maxTime = 300;              // request times are in [0, maxTime)
+    double maintenanceRate = 0.03;  // per request: a maintenance start/end pair instead
+    double burstRate = 0.25;        // per request: same time as the previous one
+    double sameFloorRate = 0.01;    // per request: source == destination
+};
+
+ECDiffTrace ECMakeDiffTrace(std::mt19937 &rng, const ECDiffTraceOptions &options);
+
+// Print a trace in the simulation file format (loadable by ECLoadCompactTrace)
+void ECWriteDiffTrace(std::ostream &os, const ECDiffTrace &trace);
+
+// Run both engines on the trace and compare IsFloorRequestDone / IsServiced /
+// GetArriveTime request by request. Returns true if they agree; otherwise
+// 'what' says where they first differ (an exception thrown by an engine counts
+// as a difference).
+bool ECDiffCompare(const ECEngineRun &reference, const ECEngineRun &candidate, const ECDiffTrace &trace, std::string *what = nullptr);
+
+// Run ECElevatorSimGeneric (one car) with a listener that adds requests from
+// inside OnRequestAdmitted and OnRequestBoarded, moving listRequests each time,
+// then run 'reference' on the grown request list. Returns true if the results
+// agree and every request the listener was given stayed intact.
+bool ECDiffCheckReentrant(const ECEngineRun &reference, const ECDiffTrace &trace, std::string *what = nullptr);
+
+// Smallest trace found (by removing requests, then shortening the run, lowering
+// the request times and removing floors) for which 'fails' still holds
+ECDiffTrace ECShrinkDiffTrace(const ECDiffTrace &trace, const std::function<bool(const ECDiffTrace &)> &fails);
+
+//*****************************************************************************
+// Drivers (main's --diff and --diff-throughput)
+
+// Compare every engine from ECGetEngines with ECElevatorSim on 'iterations' random
+// traces. The first failing trace of each engine is shrunk and printed as a
+// repro. Only engines whose name contains 'filter' are tested; with no filter the
+// traces also go through ECDiffCheckReentrant. Returns the number of checks that
+// failed.
+int ECRunDifferential(std::ostream &os, uint32_t seed, int iterations, const std::string &filter = "");
+
+// Throughput on 'numTraces' larger random traces: total time per engine, requests
+// simulated per second and speedup over ECElevatorSim (results still compared)
+void ECRunDiffThroughput(std::ostream &os, uint32_t seed, int numTraces = 20, const std::string &filter = "");
+
+#endif /* ECElevatorDiff_h */
@@ -0,0 +1,57 @@
+//
+//  ECElevatorEtaTable.cpp
+//
+//
+//  Per-car estimated time of arrival at every floor, for group dispatch
+//
+
+#include "ECElevatorEtaTable.h"
+#include "ECElevatorBench.h"
+#include "ECElevatorSimFixed.h"
+#include "ECQuantileSketch.h"
+#include <chrono>
+#include <iomanip>
+
+using namespace std;
+
+namespace {
+
+class TimesCollector : public ECSimListener
+{
+public:
+    virtual void OnRequestServiced(int32_t, const ECElevatorSimRequest &request, int boardTime, int) override {
+        waitTimes.Add(boardTime >= 0 ? boardTime - request.GetTime() : 0);
+        tripTimes.Add(request.GetArriveTime() - request.GetTime());
+    }
+    ECQuantileSketch waitTimes;
+    ECQuantileSketch tripTimes;
+};
+
+} // namespace
+
+void ECRunDispatchBenchmark(ostream &os, int numCars, uint32_t seed) {
+    const int numFloors = 40;
+    const int numRequests = 12000 * numCars;
+    const int lenRequests = 200000;
+    const int lenSim = lenRequests + 20000;
+    const vector<ECElevatorSimRequest> trace = ECMakeRandomTrace(seed, numFloors, numRequests, lenRequests);
+
+    os << numFloors << " floors, " << numCars << " cars, " << numRequests << " requests, " << lenSim << " ticks\n";
+    const ECDispatchPolicy policies[] = {EC_DISPATCH_NEAREST, EC_DISPATCH_ETA};
+    const char *names[] = {"nearest", "eta"};
+    for (int i = 0; i < 2; i++) {
+        vector<ECElevatorSimRequest> result = trace;
+        TimesCollector times;
+        auto start = chrono::steady_clock::now();
+        ECElevatorSimGeneric sim(numFloors, result, numCars);
+        sim.SetDispatchPolicy(policies[i]);
+        sim.SetListener(&times);
+        sim.Simulate(lenSim);
+        auto stop = chrono::steady_clock::now();
+
+        os << "  " << setw(8) << left << names[i] << right << fixed << setprecision(1) << setw(8)
+           << chrono::duration<double, milli>(stop - start).count() << " ms, " << times.tripTimes.GetCount()
+           << " delivered, wait mean " << times.waitTimes.GetMean() << " p99 " << times.waitTimes.GetQuantile(0.99)
+           << ", trip mean " << times.tripTimes.GetMean() << " p99 " << times.tripTimes.GetQuantile(0.99) << "\n";
+    }
+}
@@ -0,0 +1,533 @@
+//
+//  ECElevatorEventLog.cpp
+//
+//
+//  Append-only simulation event log with keyframes, for replay and seeking
+//
+
+#include "ECElevatorEventLog.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char LOG_MAGIC[4] = {'E', 'C', 'E', 'L'};
+const char INDEX_MAGIC[4] = {'E', 'C', 'I', 'X'};
+const uint32_t LOG_VERSION = 2;
+// Version 1 logs have no id count in the index; they are read by scanning
+const uint32_t LOG_VERSION_NO_IDS = 1;
+const size_t HEADER_SIZE = 4 + 4 * sizeof(uint32_t);
+// Index trailer: uint64 offset of the index + magic
+const size_t TRAILER_SIZE = sizeof(uint64_t) + 4;
+
+const size_t FLUSH_SIZE = 1 << 20;
+
+enum RecordType {
+    REC_TIME = 1,
+    REC_ADMIT,
+    REC_ADMIT_RIDE,
+    REC_BOARD,
+    REC_ALIGHT,
+    REC_MOVE,
+    REC_STOP,
+    REC_KEYFRAME
+};
+
+} // namespace
+
+//*****************************************************************************
+// ECReplayState
+
+void ECReplayState::Reset(int numCars) {
+    time = -1;
+    numDelivered = 0;
+    cars.assign(numCars, ECReplayCar());
+    // Only the ids in use are set; the table keeps its size
+    for (const ECReplayPassenger &p : passengers) {
+        where[p.id] = -1;
+    }
+    passengers.clear();
+    logOffset = 0;
+    logTime = -1;
+}
+
+void ECReplayState::Reserve(size_t numPassengers, int32_t numIds) {
+    passengers.reserve(numPassengers);
+    if (numIds > static_cast<int32_t>(where.size())) {
+        where.resize(numIds, -1);
+    }
+}
+
+void ECReplayState::AddPassenger(const ECReplayPassenger &passenger) {
+    if (passenger.id < 0) {
+        return;
+    }
+    if (passenger.id >= static_cast<int32_t>(where.size())) {
+        where.resize(max<size_t>(passenger.id + 1, 2 * where.size()), -1);
+    }
+    where[passenger.id] = static_cast<int32_t>(passengers.size());
+    passengers.push_back(passenger);
+}
+
+void ECReplayState::BoardPassenger(int32_t id) {
+    if (id >= 0 && id < static_cast<int32_t>(where.size()) && where[id] >= 0) {
+        passengers[where[id]].riding = true;
+    }
+}
+
+void ECReplayState::RemovePassenger(int32_t id) {
+    if (id < 0 || id >= static_cast<int32_t>(where.size()) || where[id] < 0) {
+        return;
+    }
+    int32_t pos = where[id];
+    where[id] = -1;
+    if (pos + 1 != static_cast<int32_t>(passengers.size())) {
+        passengers[pos] = passengers.back();
+        where[passengers[pos].id] = pos;
+    }
+    passengers.pop_back();
+}
+
+//*****************************************************************************
+// ECEventLogWriter
+
+ECEventLogWriter::ECEventLogWriter(const string &filename, int numFloors, int numCars, int keyframeIntervalIn)
+    : file(nullptr), bytesFlushed(0), keyframeInterval(max(keyframeIntervalIn, 1)), lastTime(-1), lastKeyframe(-1),
+      lastTick(-1), numIds(0), failed(false), closed(false) {
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        throw runtime_error("ECEventLogWriter: cannot create " + filename);
+    }
+    buffer.reserve(FLUSH_SIZE + (1 << 16));
+
+    uint32_t header[4] = {LOG_VERSION, static_cast<uint32_t>(numFloors), static_cast<uint32_t>(numCars), static_cast<uint32_t>(keyframeInterval)};
+    PutRaw(LOG_MAGIC, sizeof(LOG_MAGIC));
+    PutRaw(header, sizeof(header));
+
+    state.Reset(numCars);
+    WriteKeyframe();
+}
+
+ECEventLogWriter::~ECEventLogWriter() {
+    Finish();
+}
+
+void ECEventLogWriter::PutVarint(uint64_t value) {
+    while (value >= 0x80) {
+        PutByte(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    PutByte(static_cast<uint8_t>(value));
+}
+
+void ECEventLogWriter::PutRaw(const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void ECEventLogWriter::FlushBuffer() {
+    if (!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        failed = true;
+    }
+    bytesFlushed += buffer.size();
+    buffer.clear();
+}
+
+void ECEventLogWriter::SetTime(int time) {
+    if (time != lastTime) {
+        PutByte(REC_TIME);
+        PutVarint(static_cast<uint64_t>(time - lastTime));
+        lastTime = time;
+    }
+}
+
+void ECEventLogWriter::WriteKeyframe() {
+    index.push_back(make_pair(static_cast<int64_t>(state.time), bytesFlushed + buffer.size()));
+    PutByte(REC_KEYFRAME);
+    PutVarint(static_cast<uint64_t>(state.time + 1));
+    PutVarint(static_cast<uint64_t>(state.numDelivered));
+    for (const ECReplayCar &car : state.cars) {
+        PutVarint(car.floor);
+        PutVarint(car.dir + 1);
+        PutVarint(static_cast<uint64_t>(car.lastStop + 1));
+    }
+    PutVarint(state.passengers.size());
+    for (const ECReplayPassenger &p : state.passengers) {
+        PutVarint(p.id);
+        PutVarint(static_cast<uint64_t>(p.floorSrc + 1));
+        PutVarint(static_cast<uint64_t>(p.floorDest + 1));
+        PutVarint(p.car);
+        PutByte(p.riding ? 1 : 0);
+    }
+    lastTime = state.time;
+    lastKeyframe = state.time;
+}
+
+void ECEventLogWriter::OnRequestAdmitted(int32_t index, const ECElevatorSimRequest &request, int car, int time) {
+    SetTime(time);
+    ECReplayPassenger p;
+    p.id = index;
+    p.floorSrc = request.GetFloorSrc();
+    p.floorDest = request.GetFloorDest();
+    p.car = car;
+    p.riding = request.IsFloorRequestDone();
+    numIds = max(numIds, index + 1);
+    PutByte(p.riding ? REC_ADMIT_RIDE : REC_ADMIT);
+    PutVarint(p.id);
+    PutVarint(static_cast<uint64_t>(p.floorSrc + 1));
+    PutVarint(static_cast<uint64_t>(p.floorDest + 1));
+    PutVarint(p.car);
+    state.AddPassenger(p);
+}
+
+void ECEventLogWriter::OnRequestBoarded(int32_t index, const ECElevatorSimRequest &, int, int time) {
+    SetTime(time);
+    PutByte(REC_BOARD);
+    PutVarint(index);
+    state.BoardPassenger(index);
+}
+
+void ECEventLogWriter::OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int, int) {
+    SetTime(request.GetArriveTime());
+    PutByte(REC_ALIGHT);
+    PutVarint(index);
+    state.RemovePassenger(index);
+    state.numDelivered++;
+}
+
+void ECEventLogWriter::OnCarStopped(int car, int, int time) {
+    SetTime(time);
+    PutByte(REC_STOP);
+    PutVarint(car);
+    state.cars[car].lastStop = time;
+}
+
+void ECEventLogWriter::OnCarMoved(int car, int floor, EC_ELEVATOR_DIR dir, int time) {
+    SetTime(time);
+    PutByte(REC_MOVE);
+    PutVarint(car);
+    PutVarint(floor);
+    PutVarint(dir + 1);
+    state.cars[car].floor = floor;
+    state.cars[car].dir = dir;
+}
+
+void ECEventLogWriter::OnTickEnd(int time) {
+    lastTick = time;
+    if (time - lastKeyframe >= keyframeInterval) {
+        state.time = time;
+        WriteKeyframe();
+    }
+    if (buffer.size() >= FLUSH_SIZE) {
+        FlushBuffer();
+    }
+}
+
+void ECEventLogWriter::Finish() {
+    if (closed) {
+        return;
+    }
+    closed = true;
+
+    FlushBuffer();
+    uint64_t indexOffset = bytesFlushed;
+    uint32_t count = static_cast<uint32_t>(index.size());
+    int64_t endTime = lastTick;
+    int64_t ids = numIds;
+    PutRaw(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    PutRaw(&count, sizeof(count));
+    PutRaw(&endTime, sizeof(endTime));
+    PutRaw(&ids, sizeof(ids));
+    for (const pair<int64_t, uint64_t> &entry : index) {
+        PutRaw(&entry.first, sizeof(entry.first));
+        PutRaw(&entry.second, sizeof(entry.second));
+    }
+    PutRaw(&indexOffset, sizeof(indexOffset));
+    PutRaw(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    FlushBuffer();
+
+    if (fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+}
+
+void ECEventLogWriter::Close() {
+    Finish();
+    if (failed) {
+        throw runtime_error("ECEventLogWriter: write failed");
+    }
+}
+
+//*****************************************************************************
+// ECEventLogReader
+
+bool ECEventLogReader::Open(const string &filename) {
+    Close();
+    if (!mapping.Open(filename) || mapping.GetSize() < HEADER_SIZE) {
+        mapping.Close();
+        return false;
+    }
+    data = mapping.GetData();
+    size = mapping.GetSize();
+
+    uint32_t header[4];
+    memcpy(header, data + 4, sizeof(header));
+    if (memcmp(data, LOG_MAGIC, 4) != 0 || (header[0] != LOG_VERSION && header[0] != LOG_VERSION_NO_IDS)) {
+        Close();
+        return false;
+    }
+    numFloors = header[1];
+    numCars = header[2];
+    keyframeInterval = header[3];
+
+    if (header[0] == LOG_VERSION_NO_IDS || !ReadIndex()) {
+        ScanIndex();
+    }
+    if (keyframes.empty()) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ECEventLogReader::Close() {
+    mapping.Close();
+    data = nullptr;
+    size = 0;
+    keyframes.clear();
+    endTime = -1;
+    numIds = 0;
+    recordsEnd = 0;
+}
+
+bool ECEventLogReader::ReadIndex() {
+    if (size < HEADER_SIZE + TRAILER_SIZE || memcmp(data + size - 4, INDEX_MAGIC, 4) != 0) {
+        return false;
+    }
+    uint64_t indexOffset;
+    memcpy(&indexOffset, data + size - TRAILER_SIZE, sizeof(indexOffset));
+    const size_t indexHeader = 4 + sizeof(uint32_t) + 2 * sizeof(int64_t);
+    if (indexOffset < HEADER_SIZE || indexOffset + indexHeader + TRAILER_SIZE > size || memcmp(data + indexOffset, INDEX_MAGIC, 4) != 0) {
+        return false;
+    }
+    uint32_t count;
+    int64_t end, ids;
+    memcpy(&count, data + indexOffset + 4, sizeof(count));
+    memcpy(&end, data + indexOffset + 4 + sizeof(count), sizeof(end));
+    memcpy(&ids, data + indexOffset + 4 + sizeof(count) + sizeof(end), sizeof(ids));
+    const size_t entrySize = sizeof(int64_t) + sizeof(uint64_t);
+    if (indexOffset + indexHeader + count * entrySize + TRAILER_SIZE != size) {
+        return false;
+    }
+    keyframes.resize(count);
+    const uint8_t *entry = data + indexOffset + indexHeader;
+    for (uint32_t i = 0; i < count; i++, entry += entrySize) {
+        memcpy(&keyframes[i].first, entry, sizeof(int64_t));
+        memcpy(&keyframes[i].second, entry + sizeof(int64_t), sizeof(uint64_t));
+    }
+    endTime = static_cast<int>(end);
+    numIds = static_cast<int32_t>(ids);
+    recordsEnd = indexOffset;
+    return true;
+}
+
+void ECEventLogReader::ScanIndex() {
+    keyframes.clear();
+    recordsEnd = size;
+    int recordTime = -1;
+    // Records after the last one that parses (e.g. cut off by a crash) are ignored
+    numIds = 0;
+    recordsEnd = Apply(HEADER_SIZE, recordTime, INT_MAX, nullptr, &keyframes, &numIds);
+    endTime = recordTime;
+}
+
+bool ECEventLogReader::GetVarint(uint64_t &offset, uint64_t &value) const {
+    value = 0;
+    for (int shift = 0; offset < recordsEnd && shift < 64; shift += 7) {
+        uint8_t byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ECEventLogReader::ReadKeyframe(uint64_t &offset, int &keyframeTime, ECReplayState *state, int32_t *foundIds) const {
+    uint64_t time, delivered, v[5];
+    offset++;
+    if (!GetVarint(offset, time) || !GetVarint(offset, delivered)) {
+        return false;
+    }
+    keyframeTime = static_cast<int>(time) - 1;
+    if (state) {
+        state->Reset(numCars);
+        state->time = keyframeTime;
+        state->numDelivered = delivered;
+    }
+    for (int car = 0; car < numCars; car++) {
+        if (!GetVarint(offset, v[0]) || !GetVarint(offset, v[1]) || !GetVarint(offset, v[2])) {
+            return false;
+        }
+        if (state) {
+            state->cars[car].floor = static_cast<int>(v[0]);
+            state->cars[car].dir = static_cast<EC_ELEVATOR_DIR>(static_cast<int>(v[1]) - 1);
+            state->cars[car].lastStop = static_cast<int>(v[2]) - 1;
+        }
+    }
+    uint64_t count;
+    if (!GetVarint(offset, count)) {
+        return false;
+    }
+    if (state) {
+        state->passengers.reserve(count);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        for (int f = 0; f < 4; f++) {
+            if (!GetVarint(offset, v[f])) {
+                return false;
+            }
+        }
+        if (offset >= recordsEnd) {
+            return false;
+        }
+        bool riding = data[offset++] != 0;
+        if (foundIds) {
+            *foundIds = max(*foundIds, static_cast<int32_t>(v[0]) + 1);
+        }
+        if (state) {
+            ECReplayPassenger p;
+            p.id = static_cast<int32_t>(v[0]);
+            p.floorSrc = static_cast<int>(v[1]) - 1;
+            p.floorDest = static_cast<int>(v[2]) - 1;
+            p.car = static_cast<int>(v[3]);
+            p.riding = riding;
+            state->AddPassenger(p);
+        }
+    }
+    return true;
+}
+
+uint64_t ECEventLogReader::Apply(uint64_t offset, int &recordTime, int time, ECReplayState *state,
+                                 vector<pair<int64_t, uint64_t>> *found, int32_t *foundIds) const {
+    uint64_t v[4];
+    while (offset < recordsEnd) {
+        uint64_t start = offset;
+        uint8_t type = data[offset++];
+        bool ok = true;
+        switch (type) {
+        case REC_TIME:
+            ok = GetVarint(offset, v[0]);
+            if (ok && recordTime + static_cast<int64_t>(v[0]) > time) {
+                return start;
+            }
+            recordTime += static_cast<int>(v[0]);
+            break;
+
+        case REC_ADMIT:
+        case REC_ADMIT_RIDE:
+            ok = GetVarint(offset, v[0]) && GetVarint(offset, v[1]) && GetVarint(offset, v[2]) && GetVarint(offset, v[3]);
+            if (ok && foundIds) {
+                *foundIds = max(*foundIds, static_cast<int32_t>(v[0]) + 1);
+            }
+            if (ok && state) {
+                ECReplayPassenger p;
+                p.id = static_cast<int32_t>(v[0]);
+                p.floorSrc = static_cast<int>(v[1]) - 1;
+                p.floorDest = static_cast<int>(v[2]) - 1;
+                p.car = static_cast<int>(v[3]);
+                p.riding = type == REC_ADMIT_RIDE;
+                state->AddPassenger(p);
+            }
+            break;
+
+        case REC_BOARD:
+            ok = GetVarint(offset, v[0]);
+            if (ok && state) {
+                state->BoardPassenger(static_cast<int32_t>(v[0]));
+            }
+            break;
+
+        case REC_ALIGHT:
+            ok = GetVarint(offset, v[0]);
+            if (ok && state) {
+                state->RemovePassenger(static_cast<int32_t>(v[0]));
+                state->numDelivered++;
+            }
+            break;
+
+        case REC_MOVE:
+            ok = GetVarint(offset, v[0]) && GetVarint(offset, v[1]) && GetVarint(offset, v[2]) && v[0] < static_cast<uint64_t>(numCars);
+            if (ok && state) {
+                state->cars[v[0]].floor = static_cast<int>(v[1]);
+                state->cars[v[0]].dir = static_cast<EC_ELEVATOR_DIR>(static_cast<int>(v[2]) - 1);
+            }
+            break;
+
+        case REC_STOP:
+            ok = GetVarint(offset, v[0]) && v[0] < static_cast<uint64_t>(numCars);
+            if (ok && state) {
+                state->cars[v[0]].lastStop = recordTime;
+            }
+            break;
+
+        case REC_KEYFRAME: {
+            int keyframeTime;
+            uint64_t peek = start + 1;
+            ok = GetVarint(peek, v[0]);
+            if (ok && static_cast<int64_t>(v[0]) - 1 > time) {
+                return start;
+            }
+            offset = start;
+            ok = ok && ReadKeyframe(offset, keyframeTime, state, foundIds);
+            if (ok) {
+                recordTime = keyframeTime;
+                if (found) {
+                    found->push_back(make_pair(static_cast<int64_t>(keyframeTime), start));
+                }
+            }
+            break;
+        }
+
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok) {
+            return start;
+        }
+    }
+    return offset;
+}
+
+void ECEventLogReader::Seek(int time, ECReplayState &state) const {
+    if (keyframes.empty()) {
+        state.Reset(numCars);
+        return;
+    }
+    time = max(time, static_cast<int>(keyframes.front().first));
+
+    // Last keyframe at or before 'time'
+    auto it = upper_bound(keyframes.begin(), keyframes.end(), time,
+                          [](int t, const pair<int64_t, uint64_t> &k) { return t < k.first; });
+    const pair<int64_t, uint64_t> &keyframe = *(it - 1);
+
+    uint64_t offset;
+    int recordTime;
+    if (state.logOffset != 0 && state.time <= time && state.time >= keyframe.first) {
+        offset = state.logOffset;
+        recordTime = state.logTime;
+    } else {
+        offset = keyframe.second;
+        ReadKeyframe(offset, recordTime, &state);
+    }
+    offset = Apply(offset, recordTime, time, &state);
+    state.time = time;
+    state.logOffset = offset;
+    state.logTime = recordTime;
+}
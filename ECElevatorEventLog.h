@@ -0,0 +1,187 @@
+//
+//  ECElevatorEventLog.h
+//
+//
+//  Append-only simulation event log with keyframes, for replay and seeking
+//
+
+#ifndef ECElevatorEventLog_h
+#define ECElevatorEventLog_h
+
+#include "ECElevatorSimFixed.h"
+#include "ECMappedFile.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// What the replay knows about the building at one point in time
+
+struct ECReplayCar {
+    ECReplayCar() : floor(1), dir(EC_ELEVATOR_STOPPED), lastStop(-1) {}
+    int floor;
+    EC_ELEVATOR_DIR dir;
+    int lastStop;               // last tick the car stopped to let passengers on or off
+};
+
+struct ECReplayPassenger {
+    int32_t id;                 // index of the request in the simulation
+    int floorSrc;
+    int floorDest;
+    int car;
+    bool riding;                // false: waiting at floorSrc
+};
+
+class ECReplayState
+{
+public:
+    ECReplayState() : time(-1), numDelivered(0), logOffset(0), logTime(-1) {}
+
+    void Reset(int numCars);
+    // Room for this many passengers at once and ids below numIds, so that replaying
+    // records does not allocate
+    void Reserve(size_t numPassengers, int32_t numIds);
+    void AddPassenger(const ECReplayPassenger &passenger);
+    void BoardPassenger(int32_t id);
+    void RemovePassenger(int32_t id);
+
+    int time;                                   // state at the end of this tick
+    int64_t numDelivered;
+    std::vector<ECReplayCar> cars;
+    std::vector<ECReplayPassenger> passengers;  // waiting or riding, in no particular order
+
+private:
+    friend class ECEventLogReader;
+    std::vector<int32_t> where;                 // id -> position in passengers, -1 if absent
+    uint64_t logOffset;                         // next record to apply (0: not read from a log)
+    int logTime;                                // time of the last TIME/KEYFRAME record applied
+};
+
+//*****************************************************************************
+// Log format
+//
+// Header: "ECEL", then uint32 version (2), numFloors, numCars, keyframeInterval.
+// Then records, each a type byte followed by unsigned LEB128 varints:
+//   TIME       ticks since the previous TIME/KEYFRAME; later records happen then
+//   ADMIT      id, src + 1, dest + 1, car  (request starts waiting at src)
+//   ADMIT_RIDE id, src + 1, dest + 1, car  (request was already on board)
+//   BOARD      id
+//   ALIGHT     id
+//   MOVE       car, floor, dir + 1
+//   STOP       car
+//   KEYFRAME   time + 1, delivered, then per car floor, dir + 1, lastStop + 1,
+//              then the number of passengers and per passenger
+//              id, src + 1, dest + 1, car, riding
+// A keyframe is the complete state at the end of its tick. One is written for
+// time -1 (the empty building) and then every keyframeInterval ticks.
+// Closing the log appends the index: "ECIX", uint32 count, int64 end time,
+// int64 number of ids (largest id + 1), count x {int64 time, uint64 offset} of the
+// keyframes, then uint64 offset of the index and "ECIX" again. A log without an
+// index (the run did not finish, or a version 1 log) can still be read; the
+// reader then rebuilds the index by scanning.
+// Integers in the header and index are native byte order.
+
+//*****************************************************************************
+// Records the simulation as it runs (set as the simulation's ECSimListener)
+
+class ECEventLogWriter : public ECSimListener
+{
+public:
+    // Throws std::runtime_error if the file cannot be created
+    ECEventLogWriter(const std::string &filename, int numFloors, int numCars, int keyframeInterval = 256);
+    // Calls Close(), ignoring write errors
+    virtual ~ECEventLogWriter();
+
+    ECEventLogWriter(const ECEventLogWriter &) = delete;
+    ECEventLogWriter &operator=(const ECEventLogWriter &) = delete;
+
+    virtual void OnRequestAdmitted(int32_t index, const ECElevatorSimRequest &request, int car, int time) override;
+    virtual void OnRequestBoarded(int32_t index, const ECElevatorSimRequest &request, int car, int time) override;
+    virtual void OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int boardTime, int car) override;
+    virtual void OnCarStopped(int car, int floor, int time) override;
+    virtual void OnCarMoved(int car, int floor, EC_ELEVATOR_DIR dir, int time) override;
+    virtual void OnTickEnd(int time) override;
+
+    // Write the index and close the file; throws std::runtime_error if any write failed
+    void Close();
+
+    size_t GetNumKeyframes() const { return index.size(); }
+
+private:
+    void SetTime(int time);
+    void PutByte(uint8_t byte) { buffer.push_back(static_cast<char>(byte)); }
+    void PutVarint(uint64_t value);
+    void PutRaw(const void *data, size_t size);
+    void WriteKeyframe();
+    void FlushBuffer();
+    void Finish();
+
+    FILE *file;
+    std::vector<char> buffer;
+    uint64_t bytesFlushed;
+    int keyframeInterval;
+    int lastTime;                               // time of the last TIME/KEYFRAME record
+    int lastKeyframe;
+    int lastTick;
+    ECReplayState state;                        // mirror of the simulation, for keyframes
+    std::vector<std::pair<int64_t, uint64_t>> index;
+    int32_t numIds;
+    bool failed;
+    bool closed;
+};
+
+//*****************************************************************************
+// Reads a log through a read-only memory map. Seek() starts from the closest
+// keyframe at or before the requested time (or from the given state when it is
+// already between that keyframe and the requested time) and applies the records
+// after it, so the cost does not depend on how far into the log the time is.
+
+class ECEventLogReader
+{
+public:
+    ECEventLogReader() : data(nullptr), size(0), numFloors(0), numCars(0), keyframeInterval(0), endTime(-1), numIds(0), recordsEnd(0) {}
+    ~ECEventLogReader() { Close(); }
+
+    ECEventLogReader(const ECEventLogReader &) = delete;
+    ECEventLogReader &operator=(const ECEventLogReader &) = delete;
+
+    // False if the file cannot be mapped or is not an event log
+    bool Open(const std::string &filename);
+    void Close();
+
+    // Fill 'state' with the state at the end of tick 'time'. Passing the state from
+    // a previous Seek to an equal or later time continues from there.
+    void Seek(int time, ECReplayState &state) const;
+
+    int GetNumFloors() const { return numFloors; }
+    int GetNumCars() const { return numCars; }
+    int GetEndTime() const { return endTime; }
+    size_t GetNumKeyframes() const { return keyframes.size(); }
+    // Largest request id in the log + 1 (for ECReplayState::Reserve)
+    int32_t GetNumIds() const { return numIds; }
+
+private:
+    bool ReadIndex();
+    void ScanIndex();
+    // Apply records from 'offset' up to the first one after 'time'; returns where it
+    // stopped. With no state the records are only parsed, keyframes listed in 'found'
+    // and the largest id + 1 kept in 'foundIds'.
+    uint64_t Apply(uint64_t offset, int &recordTime, int time, ECReplayState *state,
+                   std::vector<std::pair<int64_t, uint64_t>> *found = nullptr, int32_t *foundIds = nullptr) const;
+    bool ReadKeyframe(uint64_t &offset, int &keyframeTime, ECReplayState *state, int32_t *foundIds = nullptr) const;
+    bool GetVarint(uint64_t &offset, uint64_t &value) const;
+
+    ECMappedFile mapping;
+    const uint8_t *data;                        // the mapping's bytes
+    size_t size;
+    int numFloors;
+    int numCars;
+    int keyframeInterval;
+    int endTime;
+    int32_t numIds;
+    uint64_t recordsEnd;                        // records stop here (start of the index, if any)
+    std::vector<std::pair<int64_t, uint64_t>> keyframes;   // (time, offset), by time
+};
+
+#endif /* ECElevatorEventLog_h */
@@ -1,5 +1,6 @@
 #include "ECElevatorObserver.h"
 #include <cmath>
+#include <cstdio>
 #include <algorithm>
 #include <sstream>
 
@@ -8,48 +9,54 @@ ECElevatorObserver::ECElevatorObserver(ECGraphicViewImp* view)
       isMovingUp(false), isMoving(false), 
       currentPosition((NUM_FLOORS - 1) * FLOOR_HEIGHT),
       shouldStopAtNext(false), isAutomatic(true), stopTimer(0), 
-      isPaused(false), currentTime(0) {
+      isPaused(false), currentTime(0), speedNum(1), speedDen(FRAMES_PER_TICK),
+      tickAccum(0), isScrubbing(false),
+      waitingHistory({{1, TIME_BAR_WIDTH}, {60, TIME_BAR_WIDTH}, {900, TIME_BAR_WIDTH}}),
+      ridingHistory({{1, TIME_BAR_WIDTH}, {60, TIME_BAR_WIDTH}, {900, TIME_BAR_WIDTH}}) {
     
-    // Initialize button states
-    for (int i = 0; i < NUM_FLOORS; i++) {
-        upButtons[i] = false;
-        downButtons[i] = false;
-    }
+    // Initialize button states (floors 0..NUM_FLOORS)
+    upButtons.assign(NUM_FLOORS + 1, false);
+    downButtons.assign(NUM_FLOORS + 1, false);
+    sparklineColumns.reserve(4 * TIME_BAR_WIDTH);
 }
 
 ECElevatorObserver::~ECElevatorObserver() {
     // Empty destructor
 }
 
-void ECElevatorObserver::Update() {
+void ECElevatorObserver::OnEvent(const ECEvent& evt) {
     if (!graphicView) return;
 
-    ECGVEventType event = graphicView->GetCurrEvent();
-    
-    // Handle spacebar for pause/resume
-    if (event == ECGV_EV_KEY_UP_SPACE) {
-        isPaused = !isPaused;
+    if (evt.category == EC_EVENT_KEY) {
+        HandleKey(evt.code);
         return;
     }
-    
-    // Don't process other updates if paused
-    if (isPaused) {
-        DrawElevator();
-        DrawFloorButtons();
-        DrawPassengerCount();
-        DrawTimeBar();
-        DrawWaitingPassengers();
-        graphicView->SetRedraw(true);
+    if (evt.category == EC_EVENT_MOUSE) {
+        HandleMouse(evt);
+        return;
+    }
+    if (evt.category != EC_EVENT_TIMER) {
         return;
     }
 
-    // Only update on timer events when not paused
-    if (event == ECGV_EV_TIMER) {
-        static int timerCount = 0;
-        if (++timerCount >= 37) {
-            currentTime++;
-            timerCount = 0;
+    if (replay) {
+        if (!isPaused && !isScrubbing) {
+            int ticks = TicksThisFrame();
+            if (ticks > 0) {
+                SeekReplay(replayState.time + ticks);
+                graphicView->AddSimTicks(ticks);
+            }
         }
+        DrawReplay();
+        graphicView->SetRedraw(true);
+        return;
+    }
+
+    // Only advance when not paused; the scene is redrawn on every timer event
+    if (!isPaused) {
+        int ticks = TicksThisFrame();
+        currentTime += ticks;
+        graphicView->AddSimTicks(ticks);
         
         // Move elevator if not paused and there are requests
         if (!buttonQueue.empty()) {
@@ -58,6 +65,7 @@ void ECElevatorObserver::Update() {
         
         ProcessNewPassengers();
     }
+    RecordHistory(currentTime, static_cast<int>(waitingPassengers.size()), numPassengers);
     
     DrawElevator();
     DrawFloorButtons();
@@ -68,6 +76,73 @@ void ECElevatorObserver::Update() {
     graphicView->SetRedraw(true);
 }
 
+void ECElevatorObserver::HandleKey(int code) {
+    switch (code) {
+    case ECGV_EV_KEY_UP_SPACE:
+        isPaused = !isPaused;
+        break;
+    case ECGV_EV_KEY_UP_UP:
+        // Faster: fewer frames per tick, then more ticks per frame
+        if (speedDen > 1) {
+            speedDen = std::max(1, speedDen / 2);
+        } else if (speedNum < MAX_TICKS_PER_FRAME) {
+            speedNum *= 2;
+        }
+        tickAccum = 0;
+        break;
+    case ECGV_EV_KEY_UP_DOWN:
+        if (speedNum > 1) {
+            speedNum /= 2;
+        } else if (speedDen < MAX_FRAMES_PER_TICK) {
+            speedDen *= 2;
+        }
+        tickAccum = 0;
+        break;
+    case ECGV_EV_KEY_UP_RIGHT:
+        if (replay) {
+            isPaused = true;
+            SeekReplay(replayState.time + 1);
+        } else if (isPaused) {
+            currentTime++;
+            ProcessNewPassengers();
+        }
+        break;
+    case ECGV_EV_KEY_UP_LEFT:
+        // The live animation cannot go back; a replay just looks the time up
+        if (replay) {
+            isPaused = true;
+            SeekReplay(replayState.time - 1);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void ECElevatorObserver::HandleMouse(const ECEvent& evt) {
+    if (!replay) return;
+
+    bool onBar = evt.x >= TIME_BAR_X && evt.x <= TIME_BAR_X + TIME_BAR_WIDTH &&
+                 evt.y >= TIME_BAR_Y - 5 && evt.y <= TIME_BAR_Y + TIME_BAR_HEIGHT + 5;
+    if (evt.code == ECGV_EV_MOUSE_BUTTON_DOWN && onBar) {
+        isScrubbing = true;
+    } else if (evt.code == ECGV_EV_MOUSE_BUTTON_UP) {
+        isScrubbing = false;
+        return;
+    }
+    if (isScrubbing) {
+        int x = evt.x < TIME_BAR_X ? 0 : std::min(evt.x - TIME_BAR_X, static_cast<int>(TIME_BAR_WIDTH));
+        SeekReplay(static_cast<int>(static_cast<int64_t>(replay->GetEndTime()) * x / TIME_BAR_WIDTH));
+    }
+}
+
+int ECElevatorObserver::TicksThisFrame() {
+    tickAccum += speedNum;
+    int ticks = tickAccum / speedDen;
+    tickAccum %= speedDen;
+    return ticks;
+}
+
 void ECElevatorObserver::MoveElevator() {
     if (stopTimer > 0) {
         stopTimer--;
@@ -107,8 +182,8 @@ void ECElevatorObserver::MoveElevator() {
             }
             
             // Reset floor buttons
-            upButtons[currentFloor] = false;
-            downButtons[currentFloor] = false;
+            SetButton(upButtons, currentFloor, false);
+            SetButton(downButtons, currentFloor, false);
             
             stopTimer = STOP_DURATION;
         }
@@ -119,14 +194,14 @@ void ECElevatorObserver::ProcessPassengers() {
     // Pick up waiting passengers
     auto waitIt = waitingPassengers.begin();
     while (waitIt != waitingPassengers.end()) {
-        if (waitIt->startFloor == currentFloor) {
+        if (waitIt->GetStartFloor() == currentFloor) {
             passengers.push_back(*waitIt);
             numPassengers++;
             
             // Add destination to queue if not already there
-            if (std::find(buttonQueue.begin(), buttonQueue.end(), waitIt->destFloor) 
+            if (std::find(buttonQueue.begin(), buttonQueue.end(), waitIt->GetDestFloor()) 
                 == buttonQueue.end()) {
-                buttonQueue.push_back(waitIt->destFloor);
+                buttonQueue.push_back(waitIt->GetDestFloor());
             }
             waitIt = waitingPassengers.erase(waitIt);
         } else {
@@ -137,10 +212,10 @@ void ECElevatorObserver::ProcessPassengers() {
     // Drop off passengers
     auto it = passengers.begin();
     while (it != passengers.end()) {
-        if (it->destFloor == currentFloor) {
+        if (it->GetDestFloor() == currentFloor) {
             numPassengers--;
             if (simulator) {
-                simulator->IncrementDeliveredPassengers();
+                simulator->IncrementDeliveredPassengers(currentFloor);
             }
             it = passengers.erase(it);
         } else {
@@ -194,18 +269,11 @@ void ECElevatorObserver::DrawElevator() {
             passengerY,
             passengerX + PASSENGER_WIDTH,
             passengerY + PASSENGER_HEIGHT,
-            passenger.color
+            passenger.GetColor()
         );
         
-        // Draw destination dots inside passenger rectangle
-        for(int i = 0; i < passenger.destFloor; i++) {
-            graphicView->DrawFilledCircle(
-                passengerX + PASSENGER_WIDTH/2,
-                passengerY + 5 + (i * 5),
-                2,
-                ECGV_BLACK
-            );
-        }
+        // Destination floor inside the passenger rectangle
+        DrawNumber(passengerX + PASSENGER_WIDTH/2, passengerY + PASSENGER_HEIGHT/2, passenger.GetDestFloor(), ECGV_BLACK);
         
         passengerX += PASSENGER_WIDTH + 10;
     }
@@ -217,7 +285,7 @@ void ECElevatorObserver::DrawFloorButtons() {
     for (int floor = 0; floor < NUM_FLOORS; floor++) {
         int y = (NUM_FLOORS - 1 - floor) * FLOOR_HEIGHT + FLOOR_HEIGHT/2;
         
-        // Skip drawing floor number text
+        DrawNumber(LEFT_MARGIN - 120, y, floor, ECGV_BLACK);
         
         // Draw buttons
         ECGVColor upColor = upButtons[floor] ? ECGV_RED : ECGV_BLACK;
@@ -265,20 +333,37 @@ void ECElevatorObserver::DrawPassengerCount() {
     }
 }
 
-void ECElevatorObserver::AddPassenger(int startFloor, int destFloor, bool goingUp) {
+ECGVColor Passenger::GetColor() const {
+    // Color comes from the id (avoiding blue, the elevator color)
+    static const ECGVColor colors[] = {ECGV_RED, ECGV_GREEN, ECGV_YELLOW, ECGV_CYAN, ECGV_PURPLE};
+    return colors[id % 5];
+}
+
+void ECElevatorObserver::ReservePassengers(int count) {
+    // Reserve up front so adding passengers never reallocates mid-run
+    waitingPassengers.reserve(count);
+    passengers.reserve(count);
+    buttonQueue.reserve(2 * NUM_FLOORS);
+}
+
+void ECElevatorObserver::SetButton(std::vector<bool>& buttons, int floor, bool lit) {
+    // Floors the view does not draw have no button
+    if (floor >= 0 && floor < static_cast<int>(buttons.size())) {
+        buttons[floor] = lit;
+    }
+}
+
+void ECElevatorObserver::AddPassenger(const ECCompactRequest& request) {
     static int nextId = 0;
     
-    // Create passenger with random color (avoiding blue)
-    ECGVColor colors[] = {ECGV_RED, ECGV_GREEN, ECGV_YELLOW, ECGV_CYAN, ECGV_PURPLE};
-    ECGVColor randomColor = colors[nextId % 5];  // Changed from 5 to 4 since array has 4 colors
-    
-    Passenger newPassenger(nextId++, startFloor, destFloor, currentTime, randomColor);
+    Passenger newPassenger(nextId++, request);
+    int startFloor = request.GetFloorSrc();
     
     // Set appropriate button
-    if (goingUp) {
-        upButtons[startFloor] = true;
+    if (request.GetFloorDest() > startFloor) {
+        SetButton(upButtons, startFloor, true);
     } else {
-        downButtons[startFloor] = true;
+        SetButton(downButtons, startFloor, true);
     }
     
     waitingPassengers.push_back(newPassenger);
@@ -288,6 +373,12 @@ void ECElevatorObserver::AddPassenger(int startFloor, int destFloor, bool goingU
     }
 }
 
+void ECElevatorObserver::DrawNumber(int x, int y, int number, ECGVColor color) {
+    char text[16];
+    snprintf(text, sizeof(text), "%d", number);
+    graphicView->DrawText(x, y, text, color);
+}
+
 void ECElevatorObserver::ProcessNewPassengers() {
     // Check for new passengers at the current time
     if (simulator) {
@@ -295,13 +386,71 @@ void ECElevatorObserver::ProcessNewPassengers() {
     }
 }
 
+void ECElevatorObserver::RecordHistory(int time, int waiting, int riding) {
+    // One sample per tick shown; going back (a replay seek) starts the history over
+    if (time == waitingHistory.GetLastTime()) {
+        return;
+    }
+    if (time < waitingHistory.GetLastTime()) {
+        waitingHistory.Clear();
+        ridingHistory.Clear();
+    }
+    waitingHistory.Add(time, waiting);
+    ridingHistory.Add(time, riding);
+}
+
+void ECElevatorObserver::DrawSparkline(int y, const ECTimeSeries& series, ECGVColor color) {
+    graphicView->DrawRectangle(TIME_BAR_X, y, TIME_BAR_X + TIME_BAR_WIDTH, y + SPARKLINE_HEIGHT, 1, ECGV_BLACK);
+
+    // The finest level whose buckets span the whole history within the bar's width
+    int level = 0;
+    while (level + 1 < series.GetNumLevels() &&
+           series.GetLastTime() / series.GetWidth(level) >= TIME_BAR_WIDTH) {
+        level++;
+    }
+    size_t numBuckets = series.GetNumBuckets(level);
+    size_t first = numBuckets > static_cast<size_t>(TIME_BAR_WIDTH) ? numBuckets - TIME_BAR_WIDTH : 0;
+    float top = 1;
+    for (size_t i = first; i < numBuckets; i++) {
+        top = std::max(top, series.GetBucket(level, i).maxValue);
+    }
+
+    // One pixel column per bucket, from its min to its max, all in one draw call
+    sparklineColumns.clear();
+    for (size_t i = first; i < numBuckets; i++) {
+        const ECTimeBucket& b = series.GetBucket(level, i);
+        int x = TIME_BAR_X + static_cast<int>(i - first);
+        int yMin = y + SPARKLINE_HEIGHT - static_cast<int>(SPARKLINE_HEIGHT * b.minValue / top);
+        int yMax = y + SPARKLINE_HEIGHT - static_cast<int>(SPARKLINE_HEIGHT * b.maxValue / top);
+        sparklineColumns.insert(sparklineColumns.end(), {x, yMin, x, std::min(yMax, yMin - 1)});
+    }
+    graphicView->DrawLines(sparklineColumns.data(), static_cast<int>(sparklineColumns.size() / 4), color);
+}
+
 void ECElevatorObserver::DrawTimeBar() {
+    // Waiting and riding passengers over time
+    DrawSparkline(TIME_BAR_Y + TIME_BAR_HEIGHT + 10, waitingHistory, ECGV_PURPLE);
+    DrawSparkline(TIME_BAR_Y + TIME_BAR_HEIGHT + 20 + SPARKLINE_HEIGHT, ridingHistory, ECGV_YELLOW);
+
     // Draw outline
     graphicView->DrawRectangle(TIME_BAR_X, TIME_BAR_Y, 
                               TIME_BAR_X + TIME_BAR_WIDTH, 
                               TIME_BAR_Y + TIME_BAR_HEIGHT, 
                               ECGV_BLACK);
     
+    // A replay shows the playback position, with a playhead that can be dragged
+    if (replay) {
+        int endTime = std::max(replay->GetEndTime(), 1);
+        int filledWidth = static_cast<int>(static_cast<int64_t>(TIME_BAR_WIDTH) * replayState.time / endTime);
+        graphicView->DrawFilledRectangle(TIME_BAR_X, TIME_BAR_Y,
+                                       TIME_BAR_X + filledWidth,
+                                       TIME_BAR_Y + TIME_BAR_HEIGHT,
+                                       ECGV_GREEN);
+        graphicView->DrawLine(TIME_BAR_X + filledWidth, TIME_BAR_Y - 5,
+                              TIME_BAR_X + filledWidth, TIME_BAR_Y + TIME_BAR_HEIGHT + 5, 3, ECGV_RED);
+        return;
+    }
+
     // Calculate progress based on delivered passengers
     int totalPassengers = simulator ? simulator->GetTotalPassengers() : 0;
     int deliveredPassengers = simulator ? simulator->GetDeliveredPassengers() : 0;
@@ -322,7 +471,9 @@ void ECElevatorObserver::DrawWaitingPassengers() {
     if (!graphicView) return;
     
     for (const auto& passenger : waitingPassengers) {
-        int y = (NUM_FLOORS - 1 - passenger.startFloor) * FLOOR_HEIGHT + FLOOR_HEIGHT/2;
+        int startFloor = passenger.GetStartFloor();
+        int destFloor = passenger.GetDestFloor();
+        int y = (NUM_FLOORS - 1 - startFloor) * FLOOR_HEIGHT + FLOOR_HEIGHT/2;
         
         // Draw passenger
         graphicView->DrawFilledRectangle(
@@ -330,11 +481,11 @@ void ECElevatorObserver::DrawWaitingPassengers() {
             y - 15,
             LEFT_MARGIN - 45,
             y,
-            passenger.color
+            passenger.GetColor()
         );
         
         // Draw direction arrow
-        bool goingUp = passenger.destFloor > passenger.startFloor;
+        bool goingUp = destFloor > startFloor;
         int arrowY = y + (goingUp ? -20 : 5);
         int arrowTipY = arrowY + (goingUp ? -5 : 5);
         
@@ -346,15 +497,111 @@ void ECElevatorObserver::DrawWaitingPassengers() {
             ECGV_BLACK
         );
 
-        // Draw destination indicator: small dots showing how many floors to move
-        int numFloors = abs(passenger.destFloor - passenger.startFloor);
-        for(int i = 0; i < numFloors; i++) {
-            graphicView->DrawFilledCircle(
-                LEFT_MARGIN - 75,
-                y - 10 + (i * 5),
-                2,
-                ECGV_BLACK
-            );
+        // Destination floor
+        DrawNumber(LEFT_MARGIN - 75, y - 8, destFloor, ECGV_BLACK);
+    }
+}
+
+void ECElevatorObserver::SetReplay(const ECEventLogReader* reader) {
+    replay = reader;
+    if (!replay) return;
+
+    // Sized for every request at once, so seeking and playing never allocate
+    replayState = ECReplayState();
+    replayState.Reserve(replay->GetNumIds(), replay->GetNumIds());
+    replayWaitingUp.assign(replay->GetNumFloors() + 1, 0);
+    replayWaitingDown.assign(replay->GetNumFloors() + 1, 0);
+    replayRiders.assign(replay->GetNumCars(), 0);
+    SeekReplay(0);
+}
+
+void ECElevatorObserver::SeekReplay(int time) {
+    // Nearest keyframe plus the deltas after it; stepping forward continues from the current state
+    time = std::min(std::max(time, 0), replay->GetEndTime());
+    replay->Seek(time, replayState);
+    currentTime = time;
+    if (time == replay->GetEndTime()) {
+        isPaused = true;
+    }
+}
+
+void ECElevatorObserver::DrawReplay() {
+    const int numFloors = std::max(replay->GetNumFloors(), 1);
+    const int numCars = static_cast<int>(replayState.cars.size());
+    const int floorHeight = std::min(static_cast<int>(FLOOR_HEIGHT), graphicView->GetHeight() / numFloors);
+    const int shaftWidth = ELEVATOR_WIDTH + 20;
+    const int cellSize = std::max(floorHeight / 4, 3);
+
+    // Top of the row for a floor; floors outside the building are drawn at the nearest end
+    auto rowTop = [&](int floor) {
+        floor = std::min(std::max(floor, 1), numFloors);
+        return (numFloors - floor) * floorHeight;
+    };
+
+    std::fill(replayWaitingUp.begin(), replayWaitingUp.end(), 0);
+    std::fill(replayWaitingDown.begin(), replayWaitingDown.end(), 0);
+    std::fill(replayRiders.begin(), replayRiders.end(), 0);
+    for (const ECReplayPassenger& p : replayState.passengers) {
+        if (p.riding) {
+            replayRiders[p.car]++;
+        } else if (p.floorSrc >= 0 && p.floorSrc <= numFloors) {
+            (p.floorDest > p.floorSrc ? replayWaitingUp : replayWaitingDown)[p.floorSrc]++;
+        }
+    }
+    int numRiding = 0;
+    for (int riders : replayRiders) {
+        numRiding += riders;
+    }
+    RecordHistory(replayState.time, static_cast<int>(replayState.passengers.size()) - numRiding, numRiding);
+
+    // Floors, call buttons and waiting passengers (one square each, as many as fit)
+    for (int floor = 1; floor <= numFloors; floor++) {
+        int y = rowTop(floor);
+        graphicView->DrawLine(LEFT_MARGIN - 140, y, LEFT_MARGIN + numCars * (shaftWidth + 10), y, 1, ECGV_BLACK);
+
+        int yMid = y + floorHeight / 2;
+        graphicView->DrawFilledCircle(LEFT_MARGIN - 30, yMid - floorHeight / 4, BUTTON_SIZE / 2,
+                                      replayWaitingUp[floor] ? ECGV_RED : ECGV_BLACK);
+        graphicView->DrawFilledCircle(LEFT_MARGIN - 30, yMid + floorHeight / 4, BUTTON_SIZE / 2,
+                                      replayWaitingDown[floor] ? ECGV_RED : ECGV_BLACK);
+
+        int waiting = std::min(replayWaitingUp[floor] + replayWaitingDown[floor], 100 / (cellSize + 2));
+        for (int i = 0; i < waiting; i++) {
+            int x = LEFT_MARGIN - 45 - (i + 1) * (cellSize + 2);
+            graphicView->DrawFilledRectangle(x, yMid - cellSize / 2, x + cellSize, yMid + cellSize / 2, ECGV_PURPLE);
+        }
+    }
+
+    // Floor numbers, right of the shafts (every few floors when the rows are short)
+    const int labelStep = (ECGraphicViewImp::LABEL_FONT_SIZE + 2 + floorHeight - 1) / std::max(floorHeight, 1);
+    for (int floor = 1; floor <= numFloors; floor += labelStep) {
+        DrawNumber(LEFT_MARGIN + numCars * (shaftWidth + 10) + 15, rowTop(floor) + floorHeight / 2, floor, ECGV_BLACK);
+    }
+
+    // Shafts and cars; a car that stopped this tick has its doors (outline) open
+    for (int car = 0; car < numCars; car++) {
+        const ECReplayCar& c = replayState.cars[car];
+        int x = LEFT_MARGIN + car * (shaftWidth + 10);
+        graphicView->DrawRectangle(x, 0, x + shaftWidth, numFloors * floorHeight, 2, ECGV_BLACK);
+
+        int y = rowTop(c.floor);
+        graphicView->DrawFilledRectangle(x + 10, y + 2, x + 10 + ELEVATOR_WIDTH, y + floorHeight - 2, ECGV_BLUE);
+        if (c.lastStop == replayState.time) {
+            graphicView->DrawRectangle(x + 8, y, x + 12 + ELEVATOR_WIDTH, y + floorHeight, 2, ECGV_GREEN);
         }
+
+        int perRow = std::max(ELEVATOR_WIDTH / (cellSize + 2), 1);
+        int riders = std::min(replayRiders[car], perRow * std::max((floorHeight - 4) / (cellSize + 2), 1));
+        for (int i = 0; i < riders; i++) {
+            int rx = x + 12 + (i % perRow) * (cellSize + 2);
+            int ry = y + 4 + (i / perRow) * (cellSize + 2);
+            graphicView->DrawFilledRectangle(rx, ry, rx + cellSize, ry + cellSize, ECGV_YELLOW);
+        }
+    }
+
+    DrawTimeBar();
+    if (isPaused) {
+        graphicView->DrawFilledRectangle(TIME_BAR_X + TIME_BAR_WIDTH + 20, TIME_BAR_Y,
+                                         TIME_BAR_X + TIME_BAR_WIDTH + 40, TIME_BAR_Y + TIME_BAR_HEIGHT, ECGV_RED);
     }
 }
\ No newline at end of file
@@ -4,22 +4,28 @@
 #include "ECObserver.h"
 #include "ECGraphicViewImp.h"
 #include "ECElevatorConnect.h"
+#include "ECElevatorRequestArena.h"
+#include "ECElevatorEventLog.h"
+#include "ECElevatorTimeSeries.h"
 #include <string>
 #include <vector>
-#include <map>
 
 class ECElevatorConnect;
 class ECGraphicViewImp;
 
+// A passenger seen by the viewer: its request record plus an id. The record is
+// copied (12 bytes, no more than a pointer to it with the id), so the trace it
+// came from does not have to stay in memory.
 struct Passenger {
-    Passenger(int id, int start, int dest, int startTime, ECGVColor col) 
-        : id(id), startFloor(start), destFloor(dest), startTime(startTime), color(col) {}
+    Passenger(int id, const ECCompactRequest& req) : id(id), request(req) {}
+    
+    int GetStartFloor() const { return request.GetFloorSrc(); }
+    int GetDestFloor() const { return request.GetFloorDest(); }
+    int GetStartTime() const { return request.GetTime(); }
+    ECGVColor GetColor() const;
     
     int id;
-    int startFloor;
-    int destFloor;
-    int startTime;
-    ECGVColor color;
+    ECCompactRequest request;
 };
 
 class ECElevatorObserver : public ECObserver {
@@ -27,8 +33,16 @@ public:
     ECElevatorObserver(ECGraphicViewImp* view);
     virtual ~ECElevatorObserver();
     
-    virtual void Update() override;
-    virtual void AddPassenger(int startFloor, int destFloor, bool goingUp);
+    // Subscribe with ECEventMask(EC_EVENT_TIMER) | ECEventMask(EC_EVENT_KEY), plus
+    // ECEventMask(EC_EVENT_MOUSE) for clicking on the timeline in a replay.
+    // Controls: space pauses, up/down doubles/halves the speed, right steps one tick
+    // forward (when paused), left steps back (replay only), and clicking or dragging
+    // on the time bar jumps to that time (replay only).
+    virtual void OnEvent(const ECEvent& evt) override;
+    // Play back a recorded run (see ECEventLogReader) instead of animating the live one
+    void SetReplay(const ECEventLogReader* reader);
+    virtual void AddPassenger(const ECCompactRequest& request);
+    void ReservePassengers(int count);
     void SetCurrentTime(int time) { currentTime = time; }
     void TogglePause() { isPaused = !isPaused; }
     void SetSimulator(ECElevatorConnect* sim) { simulator = sim; }
@@ -36,8 +50,8 @@ public:
 protected:
     std::vector<Passenger> waitingPassengers;
     std::vector<int> buttonQueue;
-    std::map<int, bool> upButtons;    
-    std::map<int, bool> downButtons;
+    std::vector<bool> upButtons;        // per floor; sized once so lighting a button never allocates
+    std::vector<bool> downButtons;
     int currentTime;
 
 private:
@@ -46,10 +60,19 @@ private:
     void DrawPassengerCount();
     void MoveElevator();
     void ProcessPassengers();
-    void DrawText(int x, int y, const std::string& text, ECGVColor color);
+    // A number centered on (x, y), formatted without allocating
+    void DrawNumber(int x, int y, int number, ECGVColor color);
     void ProcessNewPassengers();
     void DrawTimeBar();
+    void RecordHistory(int time, int waiting, int riding);
+    void DrawSparkline(int y, const ECTimeSeries& series, ECGVColor color);
     void DrawWaitingPassengers();
+    void HandleKey(int code);
+    void HandleMouse(const ECEvent& evt);
+    int TicksThisFrame();
+    void SeekReplay(int time);
+    void DrawReplay();
+    static void SetButton(std::vector<bool>& buttons, int floor, bool lit);
     
     ECGraphicViewImp* graphicView;
     std::vector<Passenger> passengers;
@@ -64,6 +87,25 @@ private:
     bool isAutomatic;
     bool shouldStopAtNext;
     int stopTimer;
+
+    // Playback speed: speedNum ticks every speedDen timer frames
+    int speedNum;
+    int speedDen;
+    int tickAccum;
+
+    // Replay of a recorded run; the state is looked up in the log, never re-simulated
+    const ECEventLogReader* replay = nullptr;
+    ECReplayState replayState;
+    bool isScrubbing;
+    std::vector<int> replayWaitingUp;       // per floor, reused every frame
+    std::vector<int> replayWaitingDown;
+    std::vector<int> replayRiders;          // per car
+
+    // Number waiting and riding over time, drawn as sparklines under the time bar;
+    // each level holds one bucket per pixel of the bar
+    ECTimeSeries waitingHistory;
+    ECTimeSeries ridingHistory;
+    std::vector<int> sparklineColumns;      // x, yMin, x, yMax per pixel column, reused every frame
     
     // Constants
     static const int NUM_FLOORS = 10;
@@ -79,6 +121,10 @@ private:
     static const int TIME_BAR_HEIGHT = 20;
     static const int TIME_BAR_X = 400;
     static const int TIME_BAR_Y = 30;
+    static const int SPARKLINE_HEIGHT = 30;
+    static const int FRAMES_PER_TICK = 37;  // default speed
+    static const int MAX_TICKS_PER_FRAME = 256;
+    static const int MAX_FRAMES_PER_TICK = FRAMES_PER_TICK * 8;
     
     ECElevatorConnect* simulator = nullptr;
 };
@@ -0,0 +1,509 @@
+//
+//  ECElevatorOfflineSolver.cpp
+//
+//
+//  Offline lower bound on total trip time, for judging dispatch policies
+//
+
+#include "ECElevatorOfflineSolver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const int MAX_GROUP = 16;
+const int MAX_FLOORS = 1023;
+
+// One group of requests, with times as in the trace
+struct Group {
+    int n = 0;
+    int startTime = 0;
+    int startLow = 1, startHigh = 1;            // floors the car may start at
+    int time[MAX_GROUP], src[MAX_GROUP], dest[MAX_GROUP];
+};
+
+// The car before it picks its move at tick t: floor, whether it moved into the
+// floor (so a stop costs a tick), whether that tick is still owed, and who is
+// riding or delivered. cost is the trip time of those delivered.
+struct Node {
+    int64_t cost;
+    int32_t t;
+    int16_t floor;
+    uint8_t moving, dwell;
+    uint16_t riding, done;
+
+    bool SameState(const Node &rhs) const {
+        return t == rhs.t && floor == rhs.floor && moving == rhs.moving && dwell == rhs.dwell && riding == rhs.riding &&
+               done == rhs.done;
+    }
+};
+
+//*****************************************************************************
+// Lowest cost seen per state, shared by all threads: open addressing over
+// atomic keys, the cost lowered with compare-and-swap. Keys are only removed
+// by Clear() between groups, which resets just the slots each thread filled;
+// when the probe window is full the state is simply not remembered.
+
+class StateMemo
+{
+public:
+    StateMemo(int log2Slots, int numThreads)
+        : mask((size_t(1) << log2Slots) - 1), slots(new Slot[mask + 1]), filled(numThreads) {
+        for (size_t i = 0; i <= mask; i++) {
+            Reset(slots[i]);
+        }
+    }
+
+    void Clear() {
+        for (vector<size_t> &list : filled) {
+            for (size_t i : list) {
+                Reset(slots[i]);
+            }
+            list.clear();
+        }
+    }
+
+    // True if cost is the lowest seen for key (and is now recorded)
+    bool Improve(int thread, uint64_t key, int64_t cost) {
+        size_t i = Mix(key) & mask;
+        for (int probe = 0; probe < MAX_PROBES; probe++, i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            uint64_t k = slot.key.load(memory_order_acquire);
+            // On failure another thread took the slot first, and k is now its key
+            if (k == EMPTY && slot.key.compare_exchange_strong(k, key, memory_order_acq_rel)) {
+                filled[thread].push_back(i);
+                k = key;
+            }
+            if (k != key) {
+                continue;
+            }
+            int64_t old = slot.cost.load(memory_order_relaxed);
+            while (cost < old) {
+                if (slot.cost.compare_exchange_weak(old, cost, memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint64_t EMPTY = ~uint64_t(0);
+    static const int MAX_PROBES = 32;
+
+    struct Slot {
+        atomic<uint64_t> key;
+        atomic<int64_t> cost;
+    };
+
+    static void Reset(Slot &slot) {
+        slot.key.store(EMPTY, memory_order_relaxed);
+        slot.cost.store(INT64_MAX, memory_order_relaxed);
+    }
+
+    static uint64_t Mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    size_t mask;
+    unique_ptr<Slot[]> slots;
+    vector<vector<size_t>> filled;              // per thread: slots it claimed
+};
+
+//*****************************************************************************
+// Branch and bound over one group. Each thread works depth-first from the back
+// of its own deque and, when that is empty, steals from the front of another's
+// (the shallowest nodes there, so the most work per steal).
+
+class GroupSearch
+{
+public:
+    GroupSearch(const Group &group, StateMemo &memo, int numThreads, int64_t nodeLimit)
+        : group(group), memo(memo), nodeLimit(nodeLimit), all(static_cast<uint16_t>((1u << group.n) - 1)),
+          best(INT64_MAX), leftover(INT64_MAX), numNodes(0), numMemoHits(0), pending(0) {
+        for (int i = 0; i < numThreads; i++) {
+            workers.push_back(make_unique<Worker>());
+        }
+    }
+
+    void Run() {
+        for (int floor = group.startLow; floor <= group.startHigh; floor++) {
+            Node node = {0, group.startTime, static_cast<int16_t>(floor), 0, 0, 0, 0};
+            Process(node);
+            Push(static_cast<int>(floor % workers.size()), &node, 1);
+        }
+        vector<thread> threads;
+        for (size_t i = 1; i < workers.size(); i++) {
+            threads.emplace_back([this, i] { Work(static_cast<int>(i)); });
+        }
+        Work(0);
+        for (thread &t : threads) {
+            t.join();
+        }
+    }
+
+    // The group's optimum if IsExact(), else a lower bound on it
+    int64_t GetBound() const { return min(best.load(), leftover.load()); }
+    bool IsExact() const { return leftover.load() >= best.load(); }
+    int64_t GetNumNodes() const { return numNodes.load(); }
+    int64_t GetNumMemoHits() const { return numMemoHits.load(); }
+
+private:
+    struct alignas(64) Worker {
+        mutex lock;
+        deque<Node> nodes;
+    };
+
+    void Work(int me) {
+        Node node;
+        while (true) {
+            if (Take(me, node)) {
+                Expand(me, node);
+                pending.fetch_sub(1, memory_order_acq_rel);
+            } else if (pending.load(memory_order_acquire) == 0) {
+                return;
+            } else {
+                this_thread::yield();
+            }
+        }
+    }
+
+    bool Take(int me, Node &node) {
+        {
+            Worker &w = *workers[me];
+            lock_guard<mutex> guard(w.lock);
+            if (!w.nodes.empty()) {
+                node = w.nodes.back();
+                w.nodes.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < workers.size(); k++) {
+            Worker &w = *workers[(me + k) % workers.size()];
+            lock_guard<mutex> guard(w.lock);
+            if (!w.nodes.empty()) {
+                node = w.nodes.front();
+                w.nodes.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Push(int me, const Node *nodes, int count) {
+        pending.fetch_add(count, memory_order_acq_rel);
+        Worker &w = *workers[me];
+        lock_guard<mutex> guard(w.lock);
+        w.nodes.insert(w.nodes.end(), nodes, nodes + count);
+    }
+
+    static void LowerTo(atomic<int64_t> &value, int64_t x) {
+        int64_t old = value.load(memory_order_relaxed);
+        while (x < old && !value.compare_exchange_weak(old, x, memory_order_relaxed)) {
+        }
+    }
+
+    void Expand(int me, const Node &node) {
+        if (node.done == all) {
+            LowerTo(best, node.cost);
+            return;
+        }
+        int64_t bound = Bound(node);
+        if (bound >= best.load(memory_order_relaxed)) {
+            return;
+        }
+        if (numNodes.fetch_add(1, memory_order_relaxed) >= nodeLimit) {
+            LowerTo(leftover, bound);
+            return;
+        }
+        uint64_t key;
+        if (MakeKey(node, key) && !memo.Improve(me, key, node.cost)) {
+            numMemoHits.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        // One child per next stop: a waiting passenger's source or a rider's destination
+        Node children[MAX_GROUP];
+        int64_t bounds[MAX_GROUP];
+        int numChildren = 0;
+        for (int i = 0; i < group.n; i++) {
+            uint16_t bit = static_cast<uint16_t>(1u << i);
+            if (node.done & bit) {
+                continue;
+            }
+            Node child = Travel(node, i);
+            int64_t childBound = Bound(child);
+            if (childBound >= best.load(memory_order_relaxed)) {
+                continue;
+            }
+            int same = 0;
+            while (same < numChildren && !children[same].SameState(child)) {
+                same++;
+            }
+            if (same < numChildren) {
+                if (child.cost < children[same].cost) {
+                    children[same] = child;
+                    bounds[same] = childBound;
+                }
+                continue;
+            }
+            children[numChildren] = child;
+            bounds[numChildren] = childBound;
+            numChildren++;
+        }
+        // Most promising last, so it is expanded next
+        int order[MAX_GROUP];
+        for (int i = 0; i < numChildren; i++) {
+            order[i] = i;
+        }
+        sort(order, order + numChildren, [&](int a, int b) { return bounds[a] > bounds[b]; });
+        Node sorted[MAX_GROUP];
+        for (int i = 0; i < numChildren; i++) {
+            sorted[i] = children[order[i]];
+        }
+        if (numChildren > 0) {
+            Push(me, sorted, numChildren);
+        }
+    }
+
+    // Get on and off at the car's floor at tick node.t, as ECElevatorSim::ProcessFloorRequests
+    void Process(Node &node) const {
+        bool processed = false;
+        for (int i = 0; i < group.n; i++) {
+            uint16_t bit = static_cast<uint16_t>(1u << i);
+            if (node.done & bit) {
+                continue;
+            }
+            if (!(node.riding & bit) && group.time[i] <= node.t && group.src[i] == node.floor) {
+                node.riding |= bit;
+                processed = true;
+            }
+            if ((node.riding & bit) && group.dest[i] == node.floor) {
+                node.riding &= ~bit;
+                node.done |= bit;
+                node.cost += node.t - group.time[i];
+                processed = true;
+            }
+        }
+        if (processed && node.moving) {
+            node.dwell = 1;
+            node.moving = 0;
+        }
+    }
+
+    // Head for request i's next floor, tick by tick, until it gets on (or off)
+    Node Travel(const Node &node, int i) const {
+        uint16_t bit = static_cast<uint16_t>(1u << i);
+        bool riding = (node.riding & bit) != 0;
+        int goal = riding ? group.dest[i] : group.src[i];
+        Node c = node;
+        while (true) {
+            if (c.dwell) {
+                c.dwell = 0;
+            } else if (c.floor != goal) {
+                c.floor += c.floor < goal ? 1 : -1;
+                c.moving = 1;
+            } else {
+                c.moving = 0;
+            }
+            c.t++;
+            Process(c);
+            if ((c.done & bit) || (!riding && (c.riding & bit))) {
+                return c;
+            }
+        }
+    }
+
+    // Each passenger still needs the ride from the car to its source (no earlier
+    // than its call) and on to its destination
+    int64_t Bound(const Node &node) const {
+        int64_t bound = node.cost;
+        int ready = node.t + node.dwell;
+        for (int i = 0; i < group.n; i++) {
+            uint16_t bit = static_cast<uint16_t>(1u << i);
+            if (node.done & bit) {
+                continue;
+            }
+            if (node.riding & bit) {
+                bound += ready + abs(node.floor - group.dest[i]) - group.time[i];
+            } else {
+                int pickup = max(group.time[i], ready + abs(node.floor - group.src[i]));
+                bound += pickup + abs(group.src[i] - group.dest[i]) - group.time[i];
+            }
+        }
+        return bound;
+    }
+
+    // done 0..15, riding 16..31, dwell 32, moving 33, floor 34..43, time 44..62
+    bool MakeKey(const Node &node, uint64_t &key) const {
+        uint64_t t = static_cast<uint64_t>(node.t - group.startTime);
+        if (t >= (uint64_t(1) << 19)) {
+            return false;
+        }
+        key = node.done | (uint64_t(node.riding) << 16) | (uint64_t(node.dwell) << 32) | (uint64_t(node.moving) << 33) |
+              (uint64_t(node.floor) << 34) | (t << 44);
+        return true;
+    }
+
+    const Group &group;
+    StateMemo &memo;
+    const int64_t nodeLimit;
+    const uint16_t all;
+    vector<unique_ptr<Worker>> workers;
+    atomic<int64_t> best;                       // cheapest complete schedule
+    atomic<int64_t> leftover;                   // smallest bound of a node cut by the limit
+    atomic<int64_t> numNodes;
+    atomic<int64_t> numMemoHits;
+    atomic<int64_t> pending;                    // nodes pushed and not yet expanded
+};
+
+// Consecutive requests in time order, at most groupSize each, cut where the
+// gap between calls is widest (in the second half of the allowed size)
+vector<Group> MakeGroups(const vector<ECElevatorSimRequest> &requests, int groupSize) {
+    vector<Group> groups;
+    size_t start = 0;
+    while (start < requests.size()) {
+        size_t end = requests.size();
+        if (end - start > static_cast<size_t>(groupSize)) {
+            size_t first = start + max(1, groupSize / 2);
+            end = first;
+            for (size_t cut = first; cut <= start + groupSize; cut++) {
+                if (requests[cut].GetTime() - requests[cut - 1].GetTime() >=
+                    requests[end].GetTime() - requests[end - 1].GetTime()) {
+                    end = cut;
+                }
+            }
+        }
+        Group group;
+        group.n = static_cast<int>(end - start);
+        group.startTime = requests[start].GetTime();
+        group.startLow = INT32_MAX;
+        group.startHigh = 0;
+        for (int i = 0; i < group.n; i++) {
+            const ECElevatorSimRequest &request = requests[start + i];
+            group.time[i] = request.GetTime();
+            group.src[i] = request.GetFloorSrc();
+            group.dest[i] = request.GetFloorDest();
+            group.startLow = min({group.startLow, group.src[i], group.dest[i]});
+            group.startHigh = max({group.startHigh, group.src[i], group.dest[i]});
+        }
+        if (groups.empty()) {
+            // Where the car really is at the start
+            group.startTime = 0;
+            group.startLow = group.startHigh = 1;
+        }
+        groups.push_back(group);
+        start = end;
+    }
+    return groups;
+}
+
+} // namespace
+
+//*****************************************************************************
+// ECOfflineSolver
+
+ECOfflineSolver::ECOfflineSolver(int numFloors, const vector<ECElevatorSimRequest> &listRequests,
+                                 const ECOfflineOptions &options)
+    : numFloors(numFloors), options(options) {
+    if (numFloors < 1 || numFloors > MAX_FLOORS) {
+        throw invalid_argument("ECOfflineSolver: floors must be 1.." + to_string(MAX_FLOORS));
+    }
+    if (options.groupSize < 1 || options.groupSize > MAX_GROUP) {
+        throw invalid_argument("ECOfflineSolver: group size must be 1.." + to_string(MAX_GROUP));
+    }
+    if (options.numThreads < 0 || options.nodeLimit < 1) {
+        throw invalid_argument("ECOfflineSolver: bad thread count or node limit");
+    }
+    for (const ECElevatorSimRequest &request : listRequests) {
+        int src = request.GetFloorSrc(), dest = request.GetFloorDest();
+        if (src >= 1 && src <= numFloors && dest >= 1 && dest <= numFloors && request.GetTime() >= 0) {
+            requests.push_back(ECElevatorSimRequest(request.GetTime(), src, dest));
+        }
+    }
+    stable_sort(requests.begin(), requests.end(),
+                [](const ECElevatorSimRequest &a, const ECElevatorSimRequest &b) { return a.GetTime() < b.GetTime(); });
+}
+
+ECOfflineResult ECOfflineSolver::Solve() const {
+    auto start = chrono::steady_clock::now();
+    int numThreads = options.numThreads > 0 ? options.numThreads : max(1u, thread::hardware_concurrency());
+    int log2Slots = 16;
+    while (log2Slots < 22 && (int64_t(1) << log2Slots) < 2 * options.nodeLimit) {
+        log2Slots++;
+    }
+    StateMemo memo(log2Slots, numThreads);
+
+    ECOfflineResult result;
+    result.numRequests = static_cast<int>(requests.size());
+    vector<Group> groups = MakeGroups(requests, options.groupSize);
+    for (size_t i = 0; i < groups.size(); i++) {
+        memo.Clear();
+        GroupSearch search(groups[i], memo, numThreads, options.nodeLimit);
+        search.Run();
+        result.lowerBound += search.GetBound();
+        result.numGroupsExact += search.IsExact() ? 1 : 0;
+        result.numNodes += search.GetNumNodes();
+        result.numMemoHits += search.GetNumMemoHits();
+    }
+    result.numGroups = static_cast<int>(groups.size());
+    result.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+//*****************************************************************************
+
+void ECReportOfflineBound(ostream &os, int numFloors, const vector<ECElevatorSimRequest> &listRequests,
+                          const ECOfflineOptions &options) {
+    ECOfflineSolver solver(numFloors, listRequests, options);
+    ECOfflineResult result = solver.Solve();
+
+    // ECElevatorSim on the same requests, run until all are delivered
+    vector<ECElevatorSimRequest> policy;
+    int lastTime = 0;
+    for (const ECElevatorSimRequest &request : listRequests) {
+        int src = request.GetFloorSrc(), dest = request.GetFloorDest();
+        if (src >= 1 && src <= numFloors && dest >= 1 && dest <= numFloors && request.GetTime() >= 0) {
+            policy.push_back(ECElevatorSimRequest(request.GetTime(), src, dest));
+            lastTime = max(lastTime, request.GetTime());
+        }
+    }
+    ECElevatorSim sim(numFloors, policy);
+    sim.Simulate(lastTime + 2 * (numFloors + 1) * (static_cast<int>(policy.size()) + 1));
+    int64_t total = 0;
+    int numServiced = 0;
+    for (const ECElevatorSimRequest &request : policy) {
+        if (request.IsServiced()) {
+            total += request.GetArriveTime() - request.GetTime();
+            numServiced++;
+        }
+    }
+
+    os << result.numRequests << " requests, " << numFloors << " floors: " << result.numGroups << " groups of up to "
+       << options.groupSize << ", " << result.numGroupsExact << " solved exactly\n";
+    os << fixed << setprecision(1) << "  " << result.numNodes << " nodes, " << result.numMemoHits << " memo hits, "
+       << result.elapsedMs << " ms\n";
+    double n = max(result.numRequests, 1);
+    os << "  lower bound     total trip " << result.lowerBound << ", mean " << result.lowerBound / n << "\n";
+    os << "  ECElevatorSim   total trip " << total << ", mean " << total / n;
+    if (numServiced < result.numRequests) {
+        os << " (" << result.numRequests - numServiced << " not delivered)";
+    } else if (result.lowerBound > 0) {
+        os << ", " << setprecision(2) << static_cast<double>(total) / result.lowerBound << "x the bound";
+    }
+    os << "\n";
+}
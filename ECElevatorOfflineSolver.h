@@ -0,0 +1,81 @@
+//
+//  ECElevatorOfflineSolver.h
+//
+//
+//  Offline lower bound on total trip time, for judging dispatch policies
+//
+
+#ifndef ECElevatorOfflineSolver_h
+#define ECElevatorOfflineSolver_h
+
+#include "ECElevatorSim.h"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+//*****************************************************************************
+// Knowing every request in advance, how little total trip time (the sum of
+// arrive time - request time) could one car have managed? The car model is
+// ECElevatorSim's: one floor per tick, everyone waiting at or riding to the
+// car's floor gets on or off there, and doing so after moving costs a tick
+// standing still. The car heads straight for its next stop (waiting there if
+// the passenger has not called yet), as ECElevatorSim's does, but chooses its
+// stops with hindsight and may turn around anywhere.
+//
+// A trace of a few hundred requests is far beyond an exact search, so it is cut
+// into groups of up to groupSize consecutive requests (at the widest gaps in
+// time). Each group is solved on its own with the car free to start at any
+// floor when the group's first passenger calls (the first group starts where
+// ECElevatorSim does: floor 1 at time 0). Serving only a group's passengers can
+// be no slower than serving them among everyone else, so the sum of the group
+// optima is a lower bound for the whole trace; with one group it is the optimum.
+//
+// A group is solved by branch and bound over the car's next stop, pruned by an
+// admissible bound (each passenger still needs at least the ride from the car to
+// its source and on to its destination) and by a table of the cheapest cost seen
+// for each state. The search is shared by numThreads threads through
+// work-stealing deques; the state table is a lock-free hash table shared by all
+// of them. A group that exceeds nodeLimit nodes stops early and contributes the
+// smallest bound left in its search, so the result is still a lower bound (just
+// not the group's optimum).
+
+struct ECOfflineOptions {
+    int groupSize = 10;                 // 1..16; 16 gives a slightly tighter bound at about 4x the search
+    int numThreads = 0;                 // 0: one per core
+    int64_t nodeLimit = 1000000;        // per group
+};
+
+struct ECOfflineResult {
+    int64_t lowerBound = 0;             // total trip time, in ticks
+    int numRequests = 0;                // requests with both floors in the building
+    int numGroups = 0;
+    int numGroupsExact = 0;             // groups searched to the end
+    int64_t numNodes = 0;
+    int64_t numMemoHits = 0;            // nodes cut because a state was reached as cheaply before
+    double elapsedMs = 0;
+};
+
+class ECOfflineSolver
+{
+public:
+    // Requests with a floor outside 1..numFloors (maintenance) are left out.
+    // Throws std::invalid_argument on bad options or more than 1023 floors.
+    ECOfflineSolver(int numFloors, const std::vector<ECElevatorSimRequest> &listRequests,
+                    const ECOfflineOptions &options = ECOfflineOptions());
+
+    ECOfflineResult Solve() const;
+
+private:
+    int numFloors;
+    std::vector<ECElevatorSimRequest> requests;
+    ECOfflineOptions options;
+};
+
+//*****************************************************************************
+// Driver (main's --lower-bound): the lower bound next to ECElevatorSim's total
+// trip time on the same requests
+
+void ECReportOfflineBound(std::ostream &os, int numFloors, const std::vector<ECElevatorSimRequest> &listRequests,
+                          const ECOfflineOptions &options = ECOfflineOptions());
+
+#endif /* ECElevatorOfflineSolver_h */
@@ -0,0 +1,174 @@
+//
+//  ECElevatorOnlineDispatcher.cpp
+//
+//
+//  Online dispatcher: live hall calls fed into a running simulation
+//
+
+#include "ECElevatorOnlineDispatcher.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+int64_t NowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+//*****************************************************************************
+// ECLatencyRecorder
+
+int64_t ECLatencyRecorder::GetPercentile(double p) const {
+    size_t n = min(count, samples.size());
+    if (n == 0) {
+        return 0;
+    }
+    vector<int64_t> sorted(samples.begin(), samples.begin() + n);
+    size_t k = min(n - 1, static_cast<size_t>(p / 100.0 * (n - 1) + 0.5));
+    nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+//*****************************************************************************
+// ECElevatorOnlineDispatcher
+
+ECElevatorOnlineDispatcher::ECElevatorOnlineDispatcher(const Options &optionsIn)
+    : options(optionsIn), sim(optionsIn.numFloors, listRequests, optionsIn.numCars),
+      ingest(make_shared<Ingest>(optionsIn.queueCapacity, optionsIn.numFloors)), callsAccepted(0) {
+    sim.Reserve(options.expectedCalls);
+}
+
+ECElevatorOnlineDispatcher::~ECElevatorOnlineDispatcher() {
+    Stop();
+    for (thread &feed : feeds) {
+        // A feed blocked on stdin cannot be interrupted; it only holds the shared ingest state
+        feed.detach();
+    }
+}
+
+bool ECElevatorOnlineDispatcher::Ingest::Submit(int floorSrc, int floorDest, int time) {
+    if (!IsValid(floorSrc, floorDest)) {
+        callsRejected++;
+        return false;
+    }
+    ECLiveCall call;
+    call.time = time;
+    call.floorSrc = floorSrc;
+    call.floorDest = floorDest;
+    call.enqueueNs = NowNs();
+    return queue.TryPush(call);
+}
+
+bool ECElevatorOnlineDispatcher::Submit(int floorSrc, int floorDest, int time) {
+    return ingest->Submit(floorSrc, floorDest, time);
+}
+
+bool ECElevatorOnlineDispatcher::StartFeed(const string &name) {
+    // Opened here so a missing file is reported to the caller, not lost in the thread
+    unique_ptr<ifstream> file;
+    if (name != "-") {
+        file.reset(new ifstream(name));
+        if (!file->is_open()) {
+            return false;
+        }
+    }
+    feeds.push_back(thread(&ECElevatorOnlineDispatcher::ReadFeed, ingest, std::move(file)));
+    return true;
+}
+
+void ECElevatorOnlineDispatcher::ReadFeed(shared_ptr<Ingest> ingest, unique_ptr<ifstream> file) {
+    istream *in = file ? file.get() : &cin;
+    string line;
+    while (!ingest->stopRequested.load() && getline(*in, line)) {
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line.erase(comment);
+        }
+        int vals[3];
+        int n = 0;
+        stringstream ss(line);
+        while (n < 3 && ss >> vals[n]) {
+            n++;
+        }
+        if (n < 2) {
+            continue;
+        }
+        int time = n == 3 ? vals[0] : -1;
+        int floorSrc = n == 3 ? vals[1] : vals[0];
+        int floorDest = n == 3 ? vals[2] : vals[1];
+
+        // Queue full: back off until the dispatcher catches up
+        while (!ingest->Submit(floorSrc, floorDest, time) && ingest->IsValid(floorSrc, floorDest) && !ingest->stopRequested.load()) {
+            this_thread::yield();
+        }
+    }
+    ingest->feedsFinished++;
+}
+
+void ECElevatorOnlineDispatcher::Run() {
+    auto deadline = chrono::steady_clock::now();
+    const auto period = chrono::microseconds(options.tickPeriodUs);
+
+    while (!ingest->stopRequested.load()) {
+        if (options.tickPeriodUs > 0) {
+            deadline += period;
+            this_thread::sleep_until(deadline);
+        }
+
+        int64_t start = NowNs();
+        ECLiveCall call;
+        for (int n = 0; n < options.maxCallsPerTick && ingest->queue.TryPop(call); n++) {
+            sim.AddRequest(call.time < 0 ? sim.GetTime() : call.time, call.floorSrc, call.floorDest);
+            queueLatency.Record(NowNs() - call.enqueueNs);
+            callsAccepted++;
+        }
+        sim.Step();
+        decisionLatency.Record(NowNs() - start);
+
+        if (options.maxTicks >= 0) {
+            if (sim.GetTime() >= options.maxTicks) break;
+        } else if (FeedsDone() && ingest->queue.SizeApprox() == 0 && sim.GetNumPending() == 0) {
+            break;
+        }
+        if (options.tickPeriodUs == 0 && sim.GetNumPending() == 0 && ingest->queue.SizeApprox() == 0) {
+            // Free-running with nothing to do: don't spin the core while waiting for input
+            this_thread::yield();
+        }
+    }
+}
+
+void ECElevatorOnlineDispatcher::Report(ostream &os) const {
+    size_t serviced = 0;
+    int64_t totalWait = 0;
+    for (const ECElevatorSimRequest &request : listRequests) {
+        if (request.IsServiced()) {
+            serviced++;
+            totalWait += request.GetArriveTime() - request.GetTime();
+        }
+    }
+
+    os << "Ticks: " << sim.GetTime() << ", calls accepted: " << callsAccepted << ", rejected: " << ingest->callsRejected.load()
+       << ", serviced: " << serviced << ", pending: " << sim.GetNumPending() << "\n";
+    if (serviced > 0) {
+        os << "Average journey time: " << fixed << setprecision(2) << (double)totalWait / serviced << " ticks\n";
+    }
+
+    const double percentiles[] = {50, 90, 99, 99.9};
+    const char *percentileNames[] = {"p50", "p90", "p99", "p99.9"};
+    const ECLatencyRecorder *recorders[] = {&decisionLatency, &queueLatency};
+    const char *names[] = {"Decision latency (us)", "Queueing latency (us)"};
+    for (int r = 0; r < 2; r++) {
+        os << names[r] << ":";
+        for (int i = 0; i < 4; i++) {
+            os << " " << percentileNames[i] << "=" << fixed << setprecision(2) << recorders[r]->GetPercentile(percentiles[i]) / 1000.0;
+        }
+        os << " max=" << recorders[r]->GetMax() / 1000.0 << " (n=" << recorders[r]->GetCount() << ")\n";
+    }
+}
@@ -0,0 +1,137 @@
+//
+//  ECElevatorOnlineDispatcher.h
+//
+//
+//  Online dispatcher: live hall calls fed into a running simulation
+//
+
+#ifndef ECElevatorOnlineDispatcher_h
+#define ECElevatorOnlineDispatcher_h
+
+#include "ECBoundedQueue.h"
+#include "ECElevatorSimFixed.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Latency samples kept in a fixed ring (the most recent 'capacity' samples);
+// percentiles are computed on demand
+
+class ECLatencyRecorder
+{
+public:
+    explicit ECLatencyRecorder(size_t capacity = 1 << 20) : samples(capacity), count(0), maxSample(0) {}
+
+    void Record(int64_t ns) {
+        samples[count % samples.size()] = ns;
+        count++;
+        maxSample = std::max(maxSample, ns);
+    }
+
+    // p in [0, 100]; 0 when there are no samples
+    int64_t GetPercentile(double p) const;
+    int64_t GetMax() const { return maxSample; }
+    size_t GetCount() const { return count; }
+
+private:
+    std::vector<int64_t> samples;
+    size_t count;
+    int64_t maxSample;
+};
+
+//*****************************************************************************
+// A call as it travels through the ingestion queue
+
+struct ECLiveCall {
+    int time;               // -1: "now", i.e. the tick at which the dispatcher picks it up
+    int floorSrc;
+    int floorDest;
+    int64_t enqueueNs;      // steady clock at submission, for queueing latency
+};
+
+//*****************************************************************************
+// Runs an ECElevatorSimGeneric as an online dispatcher. Any number of threads
+// submit calls through a lock-free bounded queue; the dispatcher thread (the one
+// calling Run) drains the queue (up to maxCallsPerTick calls, so a burst cannot
+// stall a tick) at the start of every tick, then makes that tick's
+// dispatch decision (ECElevatorSimGeneric::Step). The time spent per tick is the
+// decision latency; the time from Submit to the call entering the simulation is
+// the queueing latency. Both are reported as percentiles.
+//
+// Feeds are text streams with one call per line, either "src dest" (for now) or
+// "time src dest"; '#' starts a comment. "-" is stdin; any other name is opened as
+// a file, so a named pipe works as a stand-in for a socket.
+
+class ECElevatorOnlineDispatcher
+{
+public:
+    struct Options {
+        Options() : numFloors(10), numCars(1), tickPeriodUs(0), maxTicks(-1), maxCallsPerTick(1024), queueCapacity(1 << 16), expectedCalls(1 << 20) {}
+        int numFloors;
+        int numCars;
+        int tickPeriodUs;           // real-time clock mode: one tick per period; 0 = run ticks back to back
+        int maxTicks;               // stop after this many ticks; -1 = when the feeds are done and all calls are serviced
+        int maxCallsPerTick;        // calls taken off the queue per tick; the rest wait for the next tick
+        size_t queueCapacity;
+        size_t expectedCalls;       // requests reserved up front (ECElevatorSimT::Reserve) so ticks do not reallocate
+    };
+
+    explicit ECElevatorOnlineDispatcher(const Options &options);
+    ~ECElevatorOnlineDispatcher();
+
+    // Thread-safe; returns false if the call is malformed or the queue is full
+    bool Submit(int floorSrc, int floorDest, int time = -1);
+
+    // Start a producer thread reading calls from a feed ("-" for stdin); false if
+    // the file cannot be opened
+    bool StartFeed(const std::string &name);
+
+    // Dispatcher loop; returns when done (see Options::maxTicks) or after Stop()
+    void Run();
+    void Stop() { ingest->stopRequested.store(true); }
+
+    void Report(std::ostream &os) const;
+
+    const std::vector<ECElevatorSimRequest> &GetRequests() const { return listRequests; }
+    const ECElevatorSimGeneric &GetSim() const { return sim; }
+
+private:
+    // Everything the producer threads touch. Shared with them so that a feed still
+    // blocked on stdin when the dispatcher goes away can be detached safely.
+    struct Ingest {
+        Ingest(size_t capacity, int numFloors) : queue(capacity), numFloors(numFloors), feedsFinished(0), stopRequested(false), callsRejected(0) {}
+        bool IsValid(int floorSrc, int floorDest) const {
+            return floorSrc >= 1 && floorSrc <= numFloors && floorDest >= 1 && floorDest <= numFloors && floorSrc != floorDest;
+        }
+        bool Submit(int floorSrc, int floorDest, int time);
+
+        ECBoundedQueue<ECLiveCall> queue;
+        int numFloors;
+        std::atomic<int> feedsFinished;
+        std::atomic<bool> stopRequested;
+        std::atomic<size_t> callsRejected;
+    };
+
+    // file: nullptr for stdin
+    static void ReadFeed(std::shared_ptr<Ingest> ingest, std::unique_ptr<std::ifstream> file);
+    bool FeedsDone() const { return ingest->feedsFinished.load() == static_cast<int>(feeds.size()); }
+
+    Options options;
+    std::vector<ECElevatorSimRequest> listRequests;
+    ECElevatorSimGeneric sim;
+    std::shared_ptr<Ingest> ingest;
+    std::vector<std::thread> feeds;
+
+    ECLatencyRecorder decisionLatency;
+    ECLatencyRecorder queueLatency;
+    size_t callsAccepted;
+};
+
+#endif /* ECElevatorOnlineDispatcher_h */
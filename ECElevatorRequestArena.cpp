@@ -0,0 +1,164 @@
+//
+//  ECElevatorRequestArena.cpp
+//
+//
+//  Compact request records and the per-run arena they live in
+//
+
+#include "ECElevatorRequestArena.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+//*****************************************************************************
+// ECRequestArena
+
+ECRequestArena::ECRequestArena(size_t chunkBytesIn)
+    : chunkBytes(chunkBytesIn), head(nullptr), cursor(nullptr), limit(nullptr), bytesUsed(0), bytesReserved(0) {}
+
+ECRequestArena::~ECRequestArena() {
+    Release();
+}
+
+void *ECRequestArena::Allocate(size_t bytes, size_t align) {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+    if (cursor == nullptr || p + bytes > reinterpret_cast<uintptr_t>(limit)) {
+        AddChunk(bytes + align);
+        p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    cursor = reinterpret_cast<char *>(p + bytes);
+    bytesUsed += bytes;
+    return reinterpret_cast<void *>(p);
+}
+
+void ECRequestArena::AddChunk(size_t minBytes) {
+    // Through operator new (which throws std::bad_alloc), so ECAllocTracker sees chunks
+    size_t size = std::max(chunkBytes, minBytes + sizeof(Chunk));
+    Chunk *chunk = static_cast<Chunk *>(::operator new(size));
+    chunk->next = head;
+    chunk->size = size;
+    head = chunk;
+    cursor = reinterpret_cast<char *>(chunk + 1);
+    limit = reinterpret_cast<char *>(chunk) + size;
+    bytesReserved += size;
+}
+
+void ECRequestArena::Reset() {
+    // Keep the oldest chunk around for the next run, free the rest
+    Chunk *keep = head;
+    while (keep != nullptr && keep->next != nullptr) {
+        Chunk *next = keep->next;
+        bytesReserved -= keep->size;
+        ::operator delete(keep);
+        keep = next;
+    }
+    head = keep;
+    cursor = keep ? reinterpret_cast<char *>(keep + 1) : nullptr;
+    limit = keep ? reinterpret_cast<char *>(keep) + keep->size : nullptr;
+    bytesUsed = 0;
+}
+
+void ECRequestArena::Release() {
+    while (head != nullptr) {
+        Chunk *next = head->next;
+        ::operator delete(head);
+        head = next;
+    }
+    cursor = limit = nullptr;
+    bytesUsed = bytesReserved = 0;
+}
+
+//*****************************************************************************
+// Trace loading
+
+namespace {
+
+// Parse up to 'maxVals' integers from a line; returns how many were read
+int ParseInts(const char *line, long *vals, int maxVals) {
+    int n = 0;
+    char *end = nullptr;
+    while (n < maxVals) {
+        long v = std::strtol(line, &end, 10);
+        if (end == line) {
+            break;
+        }
+        vals[n++] = v;
+        line = end;
+    }
+    return n;
+}
+
+bool FitsTime(long time) {
+    return time >= std::numeric_limits<int32_t>::min() && time <= std::numeric_limits<int32_t>::max();
+}
+
+bool IsSkippedLine(const char *line) {
+    while (*line == ' ' || *line == '\t') {
+        ++line;
+    }
+    return *line == '#' || *line == '\n' || *line == '\r' || *line == '\0';
+}
+
+} // namespace
+
+bool ECLoadCompactTrace(const std::string &filename, ECRequestArena &arena, ECCompactTrace &trace, bool sortByTime) {
+    FILE *file = std::fopen(filename.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char line[256];
+    long vals[3];
+    bool haveHeader = false;
+    size_t count = 0;
+
+    // First pass: header and number of requests
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        if (IsSkippedLine(line)) continue;
+        if (!haveHeader) {
+            if (ParseInts(line, vals, 2) != 2) break;
+            if (!ECCompactRequest::FitsFloor(vals[0]) || !FitsTime(vals[1])) break;
+            trace.numFloors = static_cast<int>(vals[0]);
+            trace.lenSim = static_cast<int>(vals[1]);
+            haveHeader = true;
+        }
+        else if (ParseInts(line, vals, 3) == 3) {
+            // Out-of-range values are rejected rather than wrapped into 16 bits
+            if (!FitsTime(vals[0]) || !ECCompactRequest::FitsFloor(vals[1]) || !ECCompactRequest::FitsFloor(vals[2])) {
+                std::fclose(file);
+                return false;
+            }
+            ++count;
+        }
+    }
+    if (!haveHeader) {
+        std::fclose(file);
+        return false;
+    }
+
+    // Second pass: fill the records
+    trace.requests = arena.AllocateArray<ECCompactRequest>(count);
+    trace.numRequests = 0;
+    std::rewind(file);
+    haveHeader = false;
+    while (std::fgets(line, sizeof(line), file) != nullptr && trace.numRequests < count) {
+        if (IsSkippedLine(line)) continue;
+        if (!haveHeader) {
+            haveHeader = true;
+        }
+        else if (ParseInts(line, vals, 3) == 3) {
+            trace.requests[trace.numRequests++] = ECCompactRequest(static_cast<int>(vals[0]), static_cast<int>(vals[1]), static_cast<int>(vals[2]));
+        }
+    }
+    std::fclose(file);
+
+    if (sortByTime) {
+        std::sort(trace.begin(), trace.end(),
+                  [](const ECCompactRequest &a, const ECCompactRequest &b) {
+                      return a.GetTime() < b.GetTime();
+                  });
+    }
+    return true;
+}
@@ -0,0 +1,147 @@
+//
+//  ECElevatorRequestArena.h
+//
+//
+//  Compact request records and the per-run arena they live in
+//
+
+#ifndef ECElevatorRequestArena_h
+#define ECElevatorRequestArena_h
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+//*****************************************************************************
+// Per-run bump arena
+//
+// Memory is carved out of large chunks in order and is never freed piece by piece:
+// Reset() rewinds the arena for the next run (keeping its first chunk) and Release()
+// hands everything back to the heap in one shot.
+
+class ECRequestArena
+{
+public:
+    explicit ECRequestArena(size_t chunkBytes = 1 << 20);
+    ~ECRequestArena();
+    ECRequestArena(const ECRequestArena &) = delete;
+    ECRequestArena &operator=(const ECRequestArena &) = delete;
+
+    void *Allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    template<class T>
+    T *AllocateArray(size_t n) { return static_cast<T *>(Allocate(n * sizeof(T), alignof(T))); }
+
+    void Reset();
+    void Release();
+
+    size_t GetBytesUsed() const { return bytesUsed; }
+    size_t GetBytesReserved() const { return bytesReserved; }
+
+private:
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+    void AddChunk(size_t minBytes);
+
+    size_t chunkBytes;
+    Chunk *head;        // most recent chunk (allocation happens here)
+    char *cursor;
+    char *limit;
+    size_t bytesUsed;
+    size_t bytesReserved;
+};
+
+//*****************************************************************************
+// Compact request record
+//
+// Same contents and accessors as ECElevatorSimRequest in 12 bytes instead of 20:
+// floors are 16 bit, the arrival time is stored as a delta from the request time
+// and the two stage flags share a word with it.
+
+class ECCompactRequest
+{
+public:
+    ECCompactRequest() : time(0), floorSrc(0), floorDest(0), bits(0) {}
+    ECCompactRequest(int timeIn, int floorSrcIn, int floorDestIn)
+        : time(timeIn), floorSrc(static_cast<int16_t>(floorSrcIn)), floorDest(static_cast<int16_t>(floorDestIn)), bits(0) {}
+
+    int GetTime() const { return time; }
+    int GetFloorSrc() const { return floorSrc; }
+    int GetFloorDest() const { return floorDest; }
+    bool IsGoingUp() const { return floorDest >= floorSrc; }
+
+    bool IsFloorRequestDone() const { return (bits & FLOOR_REQ_DONE) != 0; }
+    void SetFloorRequestDone(bool f) { bits = f ? (bits | FLOOR_REQ_DONE) : (bits & ~FLOOR_REQ_DONE); }
+
+    bool IsServiced() const { return (bits & SERVICED) != 0; }
+    void SetServiced(bool f) { bits = f ? (bits | SERVICED) : (bits & ~SERVICED); }
+
+    int GetRequestedFloor() const {
+        if (IsServiced()) {
+            return -1;
+        }
+        else if (IsFloorRequestDone()) {
+            return GetFloorDest();
+        }
+        else {
+            return GetFloorSrc();
+        }
+    }
+
+    // Arrival time is kept as (timeArrive - time + 1) so that 0 means "not arrived yet"
+    int GetArriveTime() const {
+        uint32_t delta = bits >> FLAG_BITS;
+        return delta == 0 ? -1 : time + static_cast<int>(delta) - 1;
+    }
+    void SetArriveTime(int t) {
+        uint32_t delta = t < 0 ? 0 : static_cast<uint32_t>(t - time + 1);
+        bits = (bits & FLAG_MASK) | (delta << FLAG_BITS);
+    }
+
+    bool IsMaintenanceStart() const { return floorSrc == -1 && floorDest == -1; }
+    bool IsMaintenanceEnd() const { return floorSrc == 0 && floorDest == 0; }
+
+    // Whether a floor can be stored (the constructor does not check)
+    static bool FitsFloor(long floor) {
+        return floor >= std::numeric_limits<int16_t>::min() && floor <= std::numeric_limits<int16_t>::max();
+    }
+
+private:
+    static const uint32_t FLOOR_REQ_DONE = 1u;
+    static const uint32_t SERVICED = 2u;
+    static const uint32_t FLAG_MASK = 3u;
+    static const int FLAG_BITS = 2;
+
+    int32_t time;
+    int16_t floorSrc;
+    int16_t floorDest;
+    uint32_t bits;      // bit 0: floor request done, bit 1: serviced, bits 2..31: arrive delta
+};
+
+//*****************************************************************************
+// A whole trace loaded into an arena: one contiguous array of records
+
+struct ECCompactTrace {
+    ECCompactTrace() : numFloors(0), lenSim(0), requests(nullptr), numRequests(0) {}
+
+    ECCompactRequest *begin() { return requests; }
+    ECCompactRequest *end() { return requests + numRequests; }
+    const ECCompactRequest *begin() const { return requests; }
+    const ECCompactRequest *end() const { return requests + numRequests; }
+
+    int numFloors;
+    int lenSim;
+    ECCompactRequest *requests;
+    size_t numRequests;
+};
+
+// Load a trace file ("# comments", then "numFloors lenSim", then "time src dest" lines)
+// into the arena. The file is scanned twice so the record array is allocated exactly once.
+// If sortByTime is set, records are ordered by request time. False if the file cannot be
+// read, or a floor or time does not fit in a record (floors are 16 bit).
+bool ECLoadCompactTrace(const std::string &filename, ECRequestArena &arena, ECCompactTrace &trace, bool sortByTime = false);
+
+#endif /* ECElevatorRequestArena_h */
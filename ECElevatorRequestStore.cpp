@@ -0,0 +1,52 @@
+//
+//  ECElevatorRequestStore.cpp
+//
+//
+//  Structure-of-arrays request store
+//
+
+#include "ECElevatorRequestStore.h"
+
+void ECElevatorRequestStore::Assign(const std::vector<ECElevatorSimRequest> &listRequests) {
+    Clear();
+    Reserve(listRequests.size());
+    for (const auto &request : listRequests) {
+        time.push_back(request.GetTime());
+        floorSrc.push_back(request.GetFloorSrc());
+        floorDest.push_back(request.GetFloorDest());
+        state.push_back((request.IsFloorRequestDone() ? FLOOR_REQ_DONE : 0) | (request.IsServiced() ? SERVICED : 0));
+        timeArrive.push_back(request.GetArriveTime());
+    }
+}
+
+void ECElevatorRequestStore::WriteBack(std::vector<ECElevatorSimRequest> &listRequests) const {
+    for (size_t i = 0; i < listRequests.size() && i < Size(); i++) {
+        listRequests[i].SetFloorRequestDone(IsFloorRequestDone(i));
+        listRequests[i].SetServiced(IsServiced(i));
+        listRequests[i].SetArriveTime(timeArrive[i]);
+    }
+}
+
+void ECElevatorRequestStore::Add(int timeIn, int floorSrcIn, int floorDestIn) {
+    time.push_back(timeIn);
+    floorSrc.push_back(floorSrcIn);
+    floorDest.push_back(floorDestIn);
+    state.push_back(0);
+    timeArrive.push_back(-1);
+}
+
+void ECElevatorRequestStore::Reserve(size_t n) {
+    time.reserve(n);
+    floorSrc.reserve(n);
+    floorDest.reserve(n);
+    state.reserve(n);
+    timeArrive.reserve(n);
+}
+
+void ECElevatorRequestStore::Clear() {
+    time.clear();
+    floorSrc.clear();
+    floorDest.clear();
+    state.clear();
+    timeArrive.clear();
+}
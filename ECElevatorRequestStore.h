@@ -0,0 +1,63 @@
+//
+//  ECElevatorRequestStore.h
+//
+//
+//  Structure-of-arrays request store
+//
+
+#ifndef ECElevatorRequestStore_h
+#define ECElevatorRequestStore_h
+
+#include "ECElevatorSim.h"
+#include <cstdint>
+#include <vector>
+
+//*****************************************************************************
+// Requests stored column by column: one contiguous int32 array per field.
+// The scanning kernels in ECElevatorSimKernels.h read only the columns they need,
+// and every column has the same element width so a SIMD register covers the
+// same requests in each of them.
+
+class ECElevatorRequestStore
+{
+public:
+    // State bits
+    static const int32_t FLOOR_REQ_DONE = 1;
+    static const int32_t SERVICED = 2;
+
+    ECElevatorRequestStore() {}
+    explicit ECElevatorRequestStore(const std::vector<ECElevatorSimRequest> &listRequests) { Assign(listRequests); }
+
+    // Replace the contents with a copy of the given requests (including their stage and arrive time)
+    void Assign(const std::vector<ECElevatorSimRequest> &listRequests);
+
+    // Copy stage flags and arrive times back into the request objects (same order as Assign)
+    void WriteBack(std::vector<ECElevatorSimRequest> &listRequests) const;
+
+    void Add(int time, int floorSrc, int floorDest);
+    void Reserve(size_t n);
+    void Clear();
+
+    size_t Size() const { return time.size(); }
+
+    const int32_t *GetTimes() const { return time.data(); }
+    const int32_t *GetFloorSrcs() const { return floorSrc.data(); }
+    const int32_t *GetFloorDests() const { return floorDest.data(); }
+    const int32_t *GetStates() const { return state.data(); }
+    int32_t *GetStates() { return state.data(); }
+    const int32_t *GetArriveTimes() const { return timeArrive.data(); }
+    int32_t *GetArriveTimes() { return timeArrive.data(); }
+
+    bool IsServiced(size_t i) const { return (state[i] & SERVICED) != 0; }
+    bool IsFloorRequestDone(size_t i) const { return (state[i] & FLOOR_REQ_DONE) != 0; }
+    int GetArriveTime(size_t i) const { return timeArrive[i]; }
+
+private:
+    std::vector<int32_t> time;
+    std::vector<int32_t> floorSrc;
+    std::vector<int32_t> floorDest;
+    std::vector<int32_t> state;
+    std::vector<int32_t> timeArrive;
+};
+
+#endif /* ECElevatorRequestStore_h */
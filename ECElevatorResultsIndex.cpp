@@ -0,0 +1,400 @@
+//
+//  ECElevatorResultsIndex.cpp
+//
+//
+//  Precomputed range aggregates over a run's per-passenger results
+//
+
+#include "ECElevatorResultsIndex.h"
+#include "ECElevatorResultsWriter.h"
+#include <algorithm>
+#include <barrier>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const char INDEX_MAGIC[4] = {'E', 'C', 'R', 'X'};
+const uint32_t INDEX_VERSION = 1;
+const size_t HEADER_SIZE = 64;
+
+// The header after the magic
+struct IndexHeader {
+    uint32_t version;
+    uint32_t numFloors;
+    uint32_t numBins;
+    uint32_t floorWidth;
+    uint32_t numFloorBuckets;
+    uint32_t pairWidth;
+    uint32_t numPairBuckets;
+    uint32_t reserved;
+    uint64_t numResults;
+    uint64_t floorOffset;
+    uint64_t pairOffset;
+};
+static_assert(4 + sizeof(IndexHeader) <= HEADER_SIZE, "index header too large");
+static_assert(sizeof(ECIndexAggregate) % 8 == 0, "index entries must stay 8-byte aligned");
+
+// Rows are keyed by floor, or by pair with the top bit set
+const uint32_t PAIR_KEY = 0x80000000u;
+const int MAX_FLOOR = 0x7fff;
+
+uint32_t FloorKey(int floor) { return static_cast<uint32_t>(floor); }
+uint32_t PairKey(int src, int dest) { return PAIR_KEY | static_cast<uint32_t>(src) << 15 | static_cast<uint32_t>(dest); }
+
+// One thread's rows while building: entry b + 1 of a row holds bucket b until
+// Finish() turns the row into prefix sums
+class RowBuilder
+{
+public:
+    RowBuilder(int self, int numThreads, const ECIndexOptions &options)
+        : self(self), numThreads(numThreads), options(options) {}
+
+    void Add(const ECResultsBlock &block) {
+        for (size_t i = 0; i < block.count; i++) {
+            int time = block.time[i], src = block.floorSrc[i], dest = block.floorDest[i];
+            if (time < 0 || src < 1 || dest < 1) {
+                continue;
+            }
+            uint32_t floorKey = FloorKey(src), pairKey = PairKey(src, dest);
+            bool ownFloor = Owner(floorKey) == self, ownPair = Owner(pairKey) == self;
+            if (!ownFloor && !ownPair) {
+                continue;
+            }
+            int board = block.boardTime[i] >= 0 ? block.boardTime[i] : time;
+            int arrive = block.arriveTime[i];
+            int wait = max(board - time, 0), ride = max(arrive - board, 0), trip = max(arrive - time, 0);
+            if (ownFloor) {
+                Entry(floorKey, time / options.floorWidth).Add(wait, ride, trip);
+            }
+            if (ownPair) {
+                Entry(pairKey, time / options.pairWidth).Add(wait, ride, trip);
+            }
+        }
+    }
+
+    void Finish() {
+        for (auto &[key, row] : rows) {
+            for (size_t b = 1; b < row.size(); b++) {
+                row[b] += row[b - 1];
+            }
+        }
+    }
+
+    const vector<ECIndexAggregate> *Find(uint32_t key) const {
+        auto it = rows.find(key);
+        return it == rows.end() ? nullptr : &it->second;
+    }
+
+    const unordered_map<uint32_t, vector<ECIndexAggregate>> &GetRows() const { return rows; }
+
+    static int Owner(uint32_t key, int numThreads) { return static_cast<int>(((key * 2654435761u) >> 16) % numThreads); }
+
+private:
+    int Owner(uint32_t key) const { return Owner(key, numThreads); }
+
+    ECIndexAggregate &Entry(uint32_t key, int bucket) {
+        vector<ECIndexAggregate> &row = rows[key];
+        if (row.size() < static_cast<size_t>(bucket) + 2) {
+            row.resize(bucket + 2);
+        }
+        return row[bucket + 1];
+    }
+
+    const int self;
+    const int numThreads;
+    const ECIndexOptions options;
+    unordered_map<uint32_t, vector<ECIndexAggregate>> rows;
+};
+
+void WriteBytes(FILE *file, const void *data, size_t size) {
+    if (fwrite(data, 1, size, file) != size) {
+        throw runtime_error("ECBuildResultsIndex: write failed");
+    }
+}
+
+// A row padded to numBuckets + 1 entries (the last prefix repeated; zeros if the row is absent)
+void WriteRow(FILE *file, const vector<ECIndexAggregate> *row, int numBuckets) {
+    static const ECIndexAggregate empty;
+    size_t have = row ? row->size() : 0;
+    if (have > 0) {
+        WriteBytes(file, row->data(), have * sizeof(ECIndexAggregate));
+    }
+    const ECIndexAggregate &last = have > 0 ? row->back() : empty;
+    for (size_t b = have; b < static_cast<size_t>(numBuckets) + 1; b++) {
+        WriteBytes(file, &last, sizeof(last));
+    }
+}
+
+} // namespace
+
+//*****************************************************************************
+// ECIndexAggregate
+
+void ECIndexAggregate::Add(int wait, int ride, int trip) {
+    count++;
+    sum[EC_INDEX_WAIT] += wait;
+    sum[EC_INDEX_RIDE] += ride;
+    sum[EC_INDEX_TRIP] += trip;
+    hist[EC_INDEX_WAIT][Bin(wait)]++;
+    hist[EC_INDEX_RIDE][Bin(ride)]++;
+    hist[EC_INDEX_TRIP][Bin(trip)]++;
+}
+
+ECIndexAggregate ECIndexAggregate::operator-(const ECIndexAggregate &rhs) const {
+    ECIndexAggregate result;
+    result.count = count - rhs.count;
+    for (int m = 0; m < EC_NUM_INDEX_METRICS; m++) {
+        result.sum[m] = sum[m] - rhs.sum[m];
+        for (int bin = 0; bin < NUM_BINS; bin++) {
+            result.hist[m][bin] = hist[m][bin] - rhs.hist[m][bin];
+        }
+    }
+    return result;
+}
+
+ECIndexAggregate &ECIndexAggregate::operator+=(const ECIndexAggregate &rhs) {
+    count += rhs.count;
+    for (int m = 0; m < EC_NUM_INDEX_METRICS; m++) {
+        sum[m] += rhs.sum[m];
+        for (int bin = 0; bin < NUM_BINS; bin++) {
+            hist[m][bin] += rhs.hist[m][bin];
+        }
+    }
+    return *this;
+}
+
+int ECIndexAggregate::GetQuantile(ECIndexMetric metric, double q) const {
+    if (count <= 0) {
+        return -1;
+    }
+    int64_t rank = max<int64_t>(1, min<int64_t>(count, static_cast<int64_t>(ceil(q * count))));
+    int64_t seen = 0;
+    for (int bin = 0; bin < NUM_BINS; bin++) {
+        seen += hist[metric][bin];
+        if (seen >= rank) {
+            return BinMax(bin);
+        }
+    }
+    return BinMax(NUM_BINS - 1);
+}
+
+int ECIndexAggregate::Bin(int ticks) {
+    if (ticks < 16) {
+        return max(ticks, 0);
+    }
+    int e = bit_width(static_cast<uint32_t>(ticks)) - 1;
+    return min(16 + (e - 4) * 8 + ((ticks >> (e - 3)) & 7), NUM_BINS - 1);
+}
+
+int ECIndexAggregate::BinMax(int bin) {
+    if (bin < 16) {
+        return bin;
+    }
+    int e = (bin - 16) / 8 + 4, s = (bin - 16) % 8;
+    return ((9 + s) << (e - 3)) - 1;
+}
+
+//*****************************************************************************
+// Building
+
+ECIndexBuildSummary ECBuildResultsIndex(const string &resultsFile, const string &indexFile, const ECIndexOptions &options) {
+    if (options.floorWidth < 1 || options.pairWidth < 1 || options.numThreads < 0) {
+        throw invalid_argument("ECBuildResultsIndex: bucket widths must be at least 1");
+    }
+    auto start = chrono::steady_clock::now();
+    ECResultsReader reader;
+    if (!reader.Open(resultsFile)) {
+        throw runtime_error("ECBuildResultsIndex: cannot read results file " + resultsFile);
+    }
+    const int numThreads = options.numThreads > 0 ? options.numThreads : max(1u, thread::hardware_concurrency());
+    vector<RowBuilder> builders;
+    for (int i = 0; i < numThreads; i++) {
+        builders.emplace_back(i, numThreads, options);
+    }
+
+    // The reader fills one block while the builders work through the other
+    ECIndexBuildSummary summary;
+    ECResultsBlock blocks[2];
+    int current = 0;
+    bool running = reader.ReadBlock(blocks[0]);
+    barrier sync(numThreads + 1);
+    vector<thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i] {
+            while (true) {
+                sync.arrive_and_wait();
+                if (!running) {
+                    break;
+                }
+                builders[i].Add(blocks[current]);
+                sync.arrive_and_wait();
+            }
+            builders[i].Finish();
+        });
+    }
+    while (running) {
+        sync.arrive_and_wait();
+        const ECResultsBlock &block = blocks[current];
+        for (size_t i = 0; i < block.count; i++) {
+            bool indexed = block.time[i] >= 0 && block.floorSrc[i] >= 1 && block.floorDest[i] >= 1;
+            summary.numResults += indexed ? 1 : 0;
+            summary.numSkipped += indexed ? 0 : 1;
+            summary.numFloors = max<int>({summary.numFloors, indexed ? block.floorSrc[i] : 0, indexed ? block.floorDest[i] : 0});
+        }
+        bool more = reader.ReadBlock(blocks[1 - current]);
+        sync.arrive_and_wait();
+        current = 1 - current;
+        running = more;
+    }
+    sync.arrive_and_wait();
+    for (thread &t : threads) {
+        t.join();
+    }
+    if (summary.numFloors > MAX_FLOOR) {
+        throw runtime_error("ECBuildResultsIndex: floors above " + to_string(MAX_FLOOR));
+    }
+
+    for (const RowBuilder &builder : builders) {
+        for (const auto &[key, row] : builder.GetRows()) {
+            int numBuckets = static_cast<int>(row.size()) - 1;
+            if (key & PAIR_KEY) {
+                summary.numPairBuckets = max(summary.numPairBuckets, numBuckets);
+            } else {
+                summary.numFloorBuckets = max(summary.numFloorBuckets, numBuckets);
+            }
+        }
+    }
+    auto find = [&](uint32_t key) { return builders[RowBuilder::Owner(key, numThreads)].Find(key); };
+
+    const int numFloors = summary.numFloors;
+    const size_t entrySize = sizeof(ECIndexAggregate);
+    IndexHeader header = {};
+    header.version = INDEX_VERSION;
+    header.numFloors = numFloors;
+    header.numBins = ECIndexAggregate::NUM_BINS;
+    header.floorWidth = options.floorWidth;
+    header.numFloorBuckets = summary.numFloorBuckets;
+    header.pairWidth = options.pairWidth;
+    header.numPairBuckets = summary.numPairBuckets;
+    header.numResults = summary.numResults;
+    header.floorOffset = HEADER_SIZE;
+    header.pairOffset = HEADER_SIZE + static_cast<uint64_t>(numFloors + 1) * (summary.numFloorBuckets + 1) * entrySize;
+
+    FILE *file = fopen(indexFile.c_str(), "wb");
+    if (!file) {
+        throw runtime_error("ECBuildResultsIndex: cannot create " + indexFile);
+    }
+    try {
+        char head[HEADER_SIZE] = {};
+        memcpy(head, INDEX_MAGIC, 4);
+        memcpy(head + 4, &header, sizeof(header));
+        WriteBytes(file, head, sizeof(head));
+
+        // Row 0: the floor rows summed, entry by entry
+        vector<ECIndexAggregate> all(summary.numFloorBuckets + 1);
+        for (int floor = 1; floor <= numFloors; floor++) {
+            const vector<ECIndexAggregate> *row = find(FloorKey(floor));
+            for (size_t b = 0; row && b < all.size(); b++) {
+                all[b] += (*row)[min(b, row->size() - 1)];
+            }
+        }
+        WriteRow(file, &all, summary.numFloorBuckets);
+        for (int floor = 1; floor <= numFloors; floor++) {
+            WriteRow(file, find(FloorKey(floor)), summary.numFloorBuckets);
+        }
+        for (int src = 1; src <= numFloors; src++) {
+            for (int dest = 1; dest <= numFloors; dest++) {
+                WriteRow(file, find(PairKey(src, dest)), summary.numPairBuckets);
+            }
+        }
+    }
+    catch (...) {
+        fclose(file);
+        throw;
+    }
+    if (fclose(file) != 0) {
+        throw runtime_error("ECBuildResultsIndex: write failed");
+    }
+    summary.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return summary;
+}
+
+//*****************************************************************************
+// ECResultsIndex
+
+bool ECResultsIndex::Open(const string &filename) {
+    Close();
+    if (!mapping.Open(filename) || mapping.GetSize() < HEADER_SIZE) {
+        mapping.Close();
+        return false;
+    }
+    data = mapping.GetData();
+    size = mapping.GetSize();
+
+    IndexHeader header;
+    memcpy(&header, data + 4, sizeof(header));
+    const uint64_t entrySize = sizeof(ECIndexAggregate);
+    const uint64_t floorBytes = static_cast<uint64_t>(header.numFloors + 1) * (header.numFloorBuckets + 1) * entrySize;
+    const uint64_t pairBytes =
+        static_cast<uint64_t>(header.numFloors) * header.numFloors * (header.numPairBuckets + 1) * entrySize;
+    if (memcmp(data, INDEX_MAGIC, 4) != 0 || header.version != INDEX_VERSION ||
+        header.numBins != ECIndexAggregate::NUM_BINS || header.floorWidth < 1 || header.pairWidth < 1 ||
+        header.numFloors > MAX_FLOOR || header.floorOffset != HEADER_SIZE ||
+        header.pairOffset != HEADER_SIZE + floorBytes || header.pairOffset + pairBytes != size) {
+        Close();
+        return false;
+    }
+    numFloors = header.numFloors;
+    floorWidth = header.floorWidth;
+    numFloorBuckets = header.numFloorBuckets;
+    pairWidth = header.pairWidth;
+    numPairBuckets = header.numPairBuckets;
+    numResults = header.numResults;
+    floorRows = reinterpret_cast<const ECIndexAggregate *>(data + header.floorOffset);
+    pairRows = reinterpret_cast<const ECIndexAggregate *>(data + header.pairOffset);
+    return true;
+}
+
+void ECResultsIndex::Close() {
+    mapping.Close();
+    data = nullptr;
+    size = 0;
+    numFloors = 0;
+    floorRows = pairRows = nullptr;
+}
+
+ECIndexAggregate ECResultsIndex::GetFloorRange(int floor, int begin, int end) const {
+    if (!data || floor < 0 || floor > numFloors) {
+        return ECIndexAggregate();
+    }
+    return Range(floorRows + static_cast<size_t>(floor) * (numFloorBuckets + 1), floorWidth, numFloorBuckets, begin, end);
+}
+
+ECIndexAggregate ECResultsIndex::GetPairRange(int src, int dest, int begin, int end) const {
+    if (!data || src < 1 || src > numFloors || dest < 1 || dest > numFloors) {
+        return ECIndexAggregate();
+    }
+    size_t row = static_cast<size_t>(src - 1) * numFloors + (dest - 1);
+    return Range(pairRows + row * (numPairBuckets + 1), pairWidth, numPairBuckets, begin, end);
+}
+
+ECIndexAggregate ECResultsIndex::Range(const ECIndexAggregate *row, int width, int numBuckets, int begin, int end) {
+    // Buckets [first, last): first holds begin, last - 1 holds end - 1
+    int64_t first = max<int64_t>(begin, 0) / width;
+    int64_t last = end > 0 ? (static_cast<int64_t>(end) + width - 1) / width : 0;
+    first = min<int64_t>(first, numBuckets);
+    last = min<int64_t>(last, numBuckets);
+    if (last <= first) {
+        return ECIndexAggregate();
+    }
+    return row[last] - row[first];
+}
@@ -0,0 +1,137 @@
+//
+//  ECElevatorResultsIndex.h
+//
+//
+//  Precomputed range aggregates over a run's per-passenger results
+//
+
+#ifndef ECElevatorResultsIndex_h
+#define ECElevatorResultsIndex_h
+
+#include "ECMappedFile.h"
+#include <cstdint>
+#include <string>
+
+//*****************************************************************************
+// Times indexed per passenger: waiting for the car (board - call), riding it
+// (arrive - board) and the whole trip (arrive - call)
+
+enum ECIndexMetric
+{
+    EC_INDEX_WAIT = 0,
+    EC_INDEX_RIDE,
+    EC_INDEX_TRIP,
+    EC_NUM_INDEX_METRICS
+};
+
+//*****************************************************************************
+// Count, sums and histograms of the three times for a set of passengers. The
+// histogram is log-linear: exact below 16 ticks, then 8 bins per power of two
+// up to 65535 ticks (longer times go to the last bin), so a quantile is within
+// 1/8 of the true value.
+
+struct ECIndexAggregate {
+    static const int NUM_BINS = 16 + 8 * 12;
+
+    int64_t count = 0;
+    int64_t sum[EC_NUM_INDEX_METRICS] = {};
+    uint32_t hist[EC_NUM_INDEX_METRICS][NUM_BINS] = {};
+
+    void Add(int wait, int ride, int trip);
+    // This minus rhs (rhs a prefix of this)
+    ECIndexAggregate operator-(const ECIndexAggregate &rhs) const;
+    ECIndexAggregate &operator+=(const ECIndexAggregate &rhs);
+
+    double GetMean(ECIndexMetric metric) const { return count ? static_cast<double>(sum[metric]) / count : 0; }
+    // The largest time in the bin holding the q-th (0..1) passenger; -1 if empty
+    int GetQuantile(ECIndexMetric metric, double q) const;
+
+    static int Bin(int ticks);
+    static int BinMax(int bin);
+};
+
+//*****************************************************************************
+// Index file (native byte order, every section 8-byte aligned):
+//   header: "ECRX", uint32 version (1), numFloors, NUM_BINS, floorWidth,
+//           numFloorBuckets, pairWidth, numPairBuckets, uint64 results indexed,
+//           uint64 offset of the floor section, uint64 offset of the pair section,
+//           padded to 64 bytes
+//   floor section: (numFloors + 1) rows of numFloorBuckets + 1 ECIndexAggregate;
+//           row 0 is every floor, row f the passengers calling from floor f
+//   pair section: numFloors * numFloors rows of numPairBuckets + 1; row
+//           (src - 1) * numFloors + dest - 1 is the trips from src to dest
+// Entry b of a row holds the passengers who called in [0, b * width): prefix
+// sums, so any range of buckets is one subtraction of two entries. A passenger
+// is in the bucket of its call time. Passengers calling after the last bucket
+// of a row's data simply leave its remaining entries equal.
+
+struct ECIndexOptions {
+    int floorWidth = 300;               // ticks per bucket of the per-floor rows
+    int pairWidth = 3600;               // ticks per bucket of the per-pair rows
+    int numThreads = 0;                 // 0: one per core
+};
+
+struct ECIndexBuildSummary {
+    uint64_t numResults = 0;            // passengers indexed
+    uint64_t numSkipped = 0;            // without floors in the building (maintenance) or with a negative time
+    int numFloors = 0;                  // the highest floor seen
+    int numFloorBuckets = 0;
+    int numPairBuckets = 0;
+    double elapsedMs = 0;
+};
+
+// Index a results file written in EC_RESULTS_COLUMNAR (ECResultsWriter). One
+// thread reads blocks while numThreads threads add each block to the rows they
+// own (a row belongs to one thread, picked by hash, so nothing is shared or
+// merged), then turn their rows into prefix sums. Throws std::runtime_error if
+// a file cannot be read or written and std::invalid_argument on bad options.
+ECIndexBuildSummary ECBuildResultsIndex(const std::string &resultsFile, const std::string &indexFile,
+                                        const ECIndexOptions &options = ECIndexOptions());
+
+//*****************************************************************************
+// An index file mapped into memory; a range query reads two entries of a row.
+// Ranges are of call times [begin, end), widened to whole buckets.
+
+class ECResultsIndex
+{
+public:
+    ECResultsIndex() : data(nullptr), size(0), numFloors(0), floorWidth(1), numFloorBuckets(0), pairWidth(1),
+                       numPairBuckets(0), numResults(0), floorRows(nullptr), pairRows(nullptr) {}
+    ~ECResultsIndex() { Close(); }
+
+    ECResultsIndex(const ECResultsIndex &) = delete;
+    ECResultsIndex &operator=(const ECResultsIndex &) = delete;
+
+    // False if the file cannot be mapped or is not an index
+    bool Open(const std::string &filename);
+    void Close();
+
+    int GetNumFloors() const { return numFloors; }
+    int GetFloorWidth() const { return floorWidth; }
+    int GetNumFloorBuckets() const { return numFloorBuckets; }
+    int GetPairWidth() const { return pairWidth; }
+    int GetNumPairBuckets() const { return numPairBuckets; }
+    uint64_t GetNumResults() const { return numResults; }
+
+    // Passengers calling from floor (0: any floor), or travelling src to dest;
+    // empty for floors outside the building
+    ECIndexAggregate GetFloorRange(int floor, int begin, int end) const;
+    ECIndexAggregate GetPairRange(int src, int dest, int begin, int end) const;
+
+private:
+    static ECIndexAggregate Range(const ECIndexAggregate *row, int width, int numBuckets, int begin, int end);
+
+    ECMappedFile mapping;
+    const uint8_t *data;                        // the mapping's bytes
+    size_t size;
+    int numFloors;
+    int floorWidth;
+    int numFloorBuckets;
+    int pairWidth;
+    int numPairBuckets;
+    uint64_t numResults;
+    const ECIndexAggregate *floorRows;
+    const ECIndexAggregate *pairRows;
+};
+
+#endif /* ECElevatorResultsIndex_h */
@@ -0,0 +1,234 @@
+//
+//  ECElevatorResultsWriter.cpp
+//
+//
+//  Streams per-passenger results to disk from a background thread
+//
+
+#include "ECElevatorResultsWriter.h"
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const char COLUMNAR_MAGIC[4] = {'E', 'C', 'R', 'C'};
+const uint32_t COLUMNAR_VERSION = 1;
+const uint32_t COLUMNAR_COLUMNS = 7;
+
+// Bytes of CSV one row can take: 7 numbers of at most 20 characters plus separators
+const size_t MAX_CSV_ROW = 7 * 21;
+const size_t CSV_BUFFER_SIZE = 1 << 20;
+
+template<class T>
+char *AppendNumber(char *out, T value, char sep) {
+    out = to_chars(out, out + 20, value).ptr;
+    *out++ = sep;
+    return out;
+}
+
+} // namespace
+
+//*****************************************************************************
+// ECResultsBlock
+
+void ECResultsBlock::Resize(size_t capacity) {
+    id.resize(capacity);
+    time.resize(capacity);
+    boardTime.resize(capacity);
+    arriveTime.resize(capacity);
+    floorSrc.resize(capacity);
+    floorDest.resize(capacity);
+    car.resize(capacity);
+    count = min(count, capacity);
+}
+
+//*****************************************************************************
+// ECResultsWriter
+
+ECResultsWriter::ECResultsWriter(const string &filename, ECResultsFormat formatIn, size_t blockSize, int numBlocks)
+    : file(nullptr), format(formatIn), current(nullptr), filled(max(numBlocks, 2)), empty(max(numBlocks, 2)),
+      filledSignal(0), emptySignal(0), stopRequested(false), failed(false), numAdded(0), closed(false) {
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        throw runtime_error("ECResultsWriter: cannot create " + filename);
+    }
+    // We only ever hand stdio large chunks
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    if (format == EC_RESULTS_CSV) {
+        text.resize(CSV_BUFFER_SIZE);
+        static const char header[] = "id,time,board,arrive,src,dest,car\n";
+        WriteBytes(header, sizeof(header) - 1);
+    } else {
+        WriteBytes(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+        WriteBytes(&COLUMNAR_VERSION, sizeof(COLUMNAR_VERSION));
+        WriteBytes(&COLUMNAR_COLUMNS, sizeof(COLUMNAR_COLUMNS));
+    }
+
+    for (int i = 0; i < max(numBlocks, 2); i++) {
+        blocks.push_back(unique_ptr<ECResultsBlock>(new ECResultsBlock(max<size_t>(blockSize, 1))));
+    }
+    current = blocks[0].get();
+    for (size_t i = 1; i < blocks.size(); i++) {
+        empty.TryPush(blocks[i].get());
+    }
+    writer = thread(&ECResultsWriter::Work, this);
+}
+
+ECResultsWriter::~ECResultsWriter() {
+    Finish();
+}
+
+ECResultsFormat ECResultsWriter::FormatFromName(const string &filename) {
+    size_t n = filename.size();
+    return n >= 4 && filename.compare(n - 4, 4, ".csv") == 0 ? EC_RESULTS_CSV : EC_RESULTS_COLUMNAR;
+}
+
+void ECResultsWriter::Submit() {
+    filled.TryPush(current);
+    filledSignal.fetch_add(1, memory_order_release);
+    filledSignal.notify_one();
+
+    // Take back an empty block; only waits if the writer is numBlocks-1 blocks behind
+    for (;;) {
+        uint32_t seen = emptySignal.load(memory_order_acquire);
+        if (empty.TryPop(current)) {
+            break;
+        }
+        emptySignal.wait(seen, memory_order_acquire);
+    }
+    current->count = 0;
+}
+
+void ECResultsWriter::Work() {
+    ECResultsBlock *block;
+    for (;;) {
+        uint32_t seen = filledSignal.load(memory_order_acquire);
+        if (filled.TryPop(block)) {
+            WriteBlock(*block);
+            empty.TryPush(block);
+            emptySignal.fetch_add(1, memory_order_release);
+            emptySignal.notify_one();
+            continue;
+        }
+        if (stopRequested.load()) {
+            break;
+        }
+        filledSignal.wait(seen, memory_order_acquire);
+    }
+}
+
+void ECResultsWriter::WriteBytes(const void *data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, file) != size) {
+        failed.store(true);
+    }
+}
+
+void ECResultsWriter::WriteBlock(const ECResultsBlock &b) {
+    if (b.count == 0) {
+        return;
+    }
+    if (format == EC_RESULTS_COLUMNAR) {
+        uint32_t n = static_cast<uint32_t>(b.count);
+        WriteBytes(&n, sizeof(n));
+        WriteBytes(b.id.data(), n * sizeof(int64_t));
+        WriteBytes(b.time.data(), n * sizeof(int32_t));
+        WriteBytes(b.boardTime.data(), n * sizeof(int32_t));
+        WriteBytes(b.arriveTime.data(), n * sizeof(int32_t));
+        WriteBytes(b.floorSrc.data(), n * sizeof(int16_t));
+        WriteBytes(b.floorDest.data(), n * sizeof(int16_t));
+        WriteBytes(b.car.data(), n * sizeof(int16_t));
+        return;
+    }
+
+    char *begin = text.data();
+    char *end = begin + text.size() - MAX_CSV_ROW;
+    char *out = begin;
+    for (size_t i = 0; i < b.count; i++) {
+        out = AppendNumber(out, b.id[i], ',');
+        out = AppendNumber(out, b.time[i], ',');
+        out = AppendNumber(out, b.boardTime[i], ',');
+        out = AppendNumber(out, b.arriveTime[i], ',');
+        out = AppendNumber(out, b.floorSrc[i], ',');
+        out = AppendNumber(out, b.floorDest[i], ',');
+        out = AppendNumber(out, b.car[i], '\n');
+        if (out >= end) {
+            WriteBytes(begin, out - begin);
+            out = begin;
+        }
+    }
+    WriteBytes(begin, out - begin);
+}
+
+void ECResultsWriter::Finish() {
+    if (closed) {
+        return;
+    }
+    closed = true;
+    if (current->count > 0) {
+        filled.TryPush(current);
+    }
+    current = nullptr;
+    stopRequested.store(true);
+    filledSignal.fetch_add(1, memory_order_release);
+    filledSignal.notify_one();
+    writer.join();
+    if (fclose(file) != 0) {
+        failed.store(true);
+    }
+    file = nullptr;
+}
+
+void ECResultsWriter::Close() {
+    Finish();
+    if (failed.load()) {
+        throw runtime_error("ECResultsWriter: write failed");
+    }
+}
+
+//*****************************************************************************
+// ECResultsReader
+
+bool ECResultsReader::Open(const string &filename) {
+    Close();
+    file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[4];
+    uint32_t header[2];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, COLUMNAR_MAGIC, 4) != 0 ||
+        fread(header, sizeof(uint32_t), 2, file) != 2 || header[0] != COLUMNAR_VERSION || header[1] != COLUMNAR_COLUMNS) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool ECResultsReader::ReadBlock(ECResultsBlock &block) {
+    uint32_t n;
+    if (!file || fread(&n, sizeof(n), 1, file) != 1) {
+        return false;
+    }
+    if (block.Capacity() < n) {
+        block.Resize(n);
+    }
+    block.count = n;
+    return fread(block.id.data(), sizeof(int64_t), n, file) == n &&
+           fread(block.time.data(), sizeof(int32_t), n, file) == n &&
+           fread(block.boardTime.data(), sizeof(int32_t), n, file) == n &&
+           fread(block.arriveTime.data(), sizeof(int32_t), n, file) == n &&
+           fread(block.floorSrc.data(), sizeof(int16_t), n, file) == n &&
+           fread(block.floorDest.data(), sizeof(int16_t), n, file) == n &&
+           fread(block.car.data(), sizeof(int16_t), n, file) == n;
+}
+
+void ECResultsReader::Close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
@@ -0,0 +1,160 @@
+//
+//  ECElevatorResultsWriter.h
+//
+//
+//  Streams per-passenger results to disk from a background thread
+//
+
+#ifndef ECElevatorResultsWriter_h
+#define ECElevatorResultsWriter_h
+
+#include "ECBoundedQueue.h"
+#include "ECElevatorSimFixed.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// One block of results, stored by column
+
+struct ECResultsBlock {
+    explicit ECResultsBlock(size_t capacity = 0) { Resize(capacity); }
+    void Resize(size_t capacity);
+    size_t Capacity() const { return id.size(); }
+
+    size_t count = 0;
+    std::vector<int64_t> id;
+    std::vector<int32_t> time;
+    std::vector<int32_t> boardTime;
+    std::vector<int32_t> arriveTime;
+    std::vector<int16_t> floorSrc;
+    std::vector<int16_t> floorDest;
+    std::vector<int16_t> car;
+};
+
+//*****************************************************************************
+// Output formats
+//
+// EC_RESULTS_CSV: a header line "id,time,board,arrive,src,dest,car", then one line
+// per request.
+//
+// EC_RESULTS_COLUMNAR: the header "ECRC", uint32 version (1) and uint32 number of
+// columns (7), followed by blocks until the end of the file. Each block is a uint32
+// row count n, then the columns one after the other: id (int64[n]), time, board,
+// arrive (int32[n] each), src, dest, car (int16[n] each). Native byte order.
+
+enum ECResultsFormat
+{
+    EC_RESULTS_CSV = 0,
+    EC_RESULTS_COLUMNAR
+};
+
+//*****************************************************************************
+// Results sink. Add() (or the simulation, through ECSimListener) appends to
+// the current block; a full block is handed to the writer thread, which formats
+// and writes it in large chunks while the simulation fills the next one. Only
+// 'numBlocks' blocks exist, so memory use does not grow with the run. If the
+// writer falls that far behind, Add() waits for a block to come back.
+
+class ECResultsWriter : public ECSimListener
+{
+public:
+    // Throws std::runtime_error if the file cannot be created
+    ECResultsWriter(const std::string &filename, ECResultsFormat format, size_t blockSize = 1 << 16, int numBlocks = 4);
+    // Calls Close(), ignoring write errors
+    virtual ~ECResultsWriter();
+
+    ECResultsWriter(const ECResultsWriter &) = delete;
+    ECResultsWriter &operator=(const ECResultsWriter &) = delete;
+
+    // Throws std::logic_error after Close(), and std::out_of_range if a floor or the
+    // car does not fit in the 16-bit columns
+    void Add(int64_t id, int time, int boardTime, int arriveTime, int floorSrc, int floorDest, int car) {
+        if (closed) {
+            throw std::logic_error("ECResultsWriter: Add after Close");
+        }
+        if (!FitsColumn(floorSrc) || !FitsColumn(floorDest) || !FitsColumn(car)) {
+            throw std::out_of_range("ECResultsWriter: floor or car does not fit in 16 bits");
+        }
+        ECResultsBlock &b = *current;
+        size_t i = b.count;
+        b.id[i] = id;
+        b.time[i] = time;
+        b.boardTime[i] = boardTime;
+        b.arriveTime[i] = arriveTime;
+        b.floorSrc[i] = static_cast<int16_t>(floorSrc);
+        b.floorDest[i] = static_cast<int16_t>(floorDest);
+        b.car[i] = static_cast<int16_t>(car);
+        if (++b.count == b.Capacity()) {
+            Submit();
+        }
+        numAdded++;
+    }
+
+    virtual void OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int boardTime, int car) override {
+        Add(index, request.GetTime(), boardTime, request.GetArriveTime(), request.GetFloorSrc(), request.GetFloorDest(), car);
+    }
+
+    // Write out what is left and close the file; throws std::runtime_error if any write failed
+    void Close();
+
+    uint64_t GetNumAdded() const { return numAdded; }
+
+    // EC_RESULTS_CSV for names ending in ".csv", EC_RESULTS_COLUMNAR otherwise
+    static ECResultsFormat FormatFromName(const std::string &filename);
+
+private:
+    static bool FitsColumn(int value) {
+        return value >= std::numeric_limits<int16_t>::min() && value <= std::numeric_limits<int16_t>::max();
+    }
+    void Submit();
+    void Finish();
+    void Work();
+    void WriteBlock(const ECResultsBlock &b);
+    void WriteBytes(const void *data, size_t size);
+
+    FILE *file;
+    const ECResultsFormat format;
+    std::vector<std::unique_ptr<ECResultsBlock>> blocks;
+    ECResultsBlock *current;
+    ECBoundedQueue<ECResultsBlock *> filled;        // to the writer thread
+    ECBoundedQueue<ECResultsBlock *> empty;         // back to the producer
+    std::atomic<uint32_t> filledSignal;             // bumped on every hand-over, for std::atomic::wait
+    std::atomic<uint32_t> emptySignal;
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> failed;
+    std::vector<char> text;                         // CSV formatting buffer (writer thread only)
+    uint64_t numAdded;
+    bool closed;
+    std::thread writer;
+};
+
+//*****************************************************************************
+// Reads a file written in EC_RESULTS_COLUMNAR one block at a time
+
+class ECResultsReader
+{
+public:
+    ECResultsReader() : file(nullptr) {}
+    ~ECResultsReader() { Close(); }
+
+    ECResultsReader(const ECResultsReader &) = delete;
+    ECResultsReader &operator=(const ECResultsReader &) = delete;
+
+    // False if the file cannot be opened or is not a columnar results file
+    bool Open(const std::string &filename);
+    // False at the end of the file (or on a truncated block)
+    bool ReadBlock(ECResultsBlock &block);
+    void Close();
+
+private:
+    FILE *file;
+};
+
+#endif /* ECElevatorResultsWriter_h */
@@ -15,6 +15,7 @@
 #include <string>
 #include <queue>
 #include <algorithm>
+#include <cstdlib>
 
 using namespace std;
 //*****************************************************************************
@@ -40,7 +41,8 @@ class ECElevatorSimRequest
 {
 public:
     ECElevatorSimRequest(int timeIn, int floorSrcIn, int floorDestIn) : time(timeIn), floorSrc(floorSrcIn), floorDest(floorDestIn), fFloorReqDone(false), fServiced(false), timeArrive(-1) {} 
-    ECElevatorSimRequest(const ECElevatorSimRequest &rhs) : time(rhs.time), floorSrc(rhs.floorSrc), floorDest(rhs.floorDest), fFloorReqDone(rhs.fFloorReqDone), fServiced(rhs.fServiced), timeArrive(rhs.timeArrive) {}
+    ECElevatorSimRequest(const ECElevatorSimRequest &rhs) = default;
+    ECElevatorSimRequest &operator=(const ECElevatorSimRequest &rhs) = default;
     int GetTime() const {return time; }
     int GetFloorSrc() const { return floorSrc; }
     int GetFloorDest() const { return floorDest; }
@@ -97,6 +99,108 @@ typedef enum
     EC_ELEVATOR_DOWN            // moving down
 } EC_ELEVATOR_DIR;
 
+//*****************************************************************************
+// The ECElevatorSim policy, over any request list whose records have
+// ECElevatorSimRequest's accessors (ECElevatorSim's vector, ECElevatorSimCompact's
+// ECCompactTrace), so that every engine built on it runs the same copy
+
+// Board everyone waiting at 'floor', then let off everyone going there; true if
+// anyone did
+template<class Requests>
+bool ECSimServeFloor(Requests &requests, int floor, int time) {
+    bool processedRequest = false;
+    for (auto &request : requests) {
+        if (request.GetTime() > time || request.IsServiced()) {
+            continue;
+        }
+
+        // Handle pickup
+        if (!request.IsFloorRequestDone() && request.GetFloorSrc() == floor) {
+            request.SetFloorRequestDone(true);
+            processedRequest = true;
+        }
+
+        // Handle dropoff
+        if (request.IsFloorRequestDone() && request.GetFloorDest() == floor) {
+            request.SetServiced(true);
+            request.SetArriveTime(time);
+            processedRequest = true;
+        }
+    }
+    return processedRequest;
+}
+
+// The nearest requested floor the car's way, else the closest one (the one above
+// on a tie); -1 if none
+template<class Requests>
+int ECSimNextDestination(const Requests &requests, int numFloors, int currFloor, EC_ELEVATOR_DIR currDir, int time) {
+    int nextFloor = -1;
+    int minDistance = numFloors + 1;
+
+    // First handle requests in current direction
+    for (const auto &request : requests) {
+        if (request.GetTime() > time) continue;
+
+        int targetFloor = request.GetRequestedFloor();
+        if (targetFloor == -1) continue;
+
+        if (currDir == EC_ELEVATOR_UP && targetFloor >= currFloor) {
+            if (nextFloor == -1 || targetFloor < nextFloor) {
+                nextFloor = targetFloor;
+            }
+        } else if (currDir == EC_ELEVATOR_DOWN && targetFloor <= currFloor) {
+            if (nextFloor == -1 || targetFloor > nextFloor) {
+                nextFloor = targetFloor;
+            }
+        }
+    }
+
+    // If no requests in current direction, find closest request
+    if (nextFloor == -1) {
+        for (const auto &request : requests) {
+            if (request.GetTime() > time) continue;
+
+            int targetFloor = request.GetRequestedFloor();
+            if (targetFloor == -1) continue;
+
+            int distance = std::abs(targetFloor - currFloor);
+            if (distance < minDistance || (distance == minDistance && targetFloor > currFloor)) {
+                minDistance = distance;
+                nextFloor = targetFloor;
+            }
+        }
+    }
+
+    return nextFloor;
+}
+
+// Head for nextFloor (stop if it is -1): a stopped car picks its direction, then
+// the car moves one floor
+inline void ECSimMoveToward(int nextFloor, int &currFloor, EC_ELEVATOR_DIR &currDir, bool &isMoving) {
+    if (nextFloor == -1) {
+        currDir = EC_ELEVATOR_STOPPED;
+        isMoving = false;
+        return;
+    }
+
+    // Start moving if not already moving
+    if (!isMoving) {
+        if (nextFloor > currFloor) {
+            currDir = EC_ELEVATOR_UP;
+        } else if (nextFloor < currFloor) {
+            currDir = EC_ELEVATOR_DOWN;
+        }
+        isMoving = true;
+    }
+
+    // Move one floor
+    if (currDir == EC_ELEVATOR_UP) {
+        currFloor++;
+    } else if (currDir == EC_ELEVATOR_DOWN) {
+        currFloor--;
+    }
+}
+
 //*****************************************************************************
 // Add your own classes here...
 
@@ -149,106 +253,20 @@ public:
     }
     
     void ProcessFloorRequests(int time) override {
-        bool processedRequest = false;
-        
-        // Process all requests at current floor
-        for (auto &request : listRequests) {
-            if (request.GetTime() > time || request.IsServiced()) {
-                continue;
-            }
-
-            // Handle pickup
-            if (!request.IsFloorRequestDone() && request.GetFloorSrc() == currFloor) {
-                request.SetFloorRequestDone(true);
-                processedRequest = true;
-            }
-
-            // Handle dropoff
-            if (request.IsFloorRequestDone() && !request.IsServiced() && 
-                request.GetFloorDest() == currFloor) {
-                request.SetServiced(true);
-                request.SetArriveTime(time);
-                processedRequest = true;
-            }
-        }
-
         // Set wait time only once for all requests at this floor
-        if (processedRequest && isMoving) {
+        if (ECSimServeFloor(listRequests, currFloor, time) && isMoving) {
             waitTime = 1;
             isMoving = false;
         }
     }
     
     void MoveElevator(int time) override {
-        int nextFloor = GetNextDestination(time);
-        if (nextFloor == -1) {
-            currDir = EC_ELEVATOR_STOPPED;
-            isMoving = false;
-            return;
-        }
-
-        // Start moving if not already moving
-        if (!isMoving) {
-            if (nextFloor > currFloor) {
-                currDir = EC_ELEVATOR_UP;
-            } else if (nextFloor < currFloor) {
-                currDir = EC_ELEVATOR_DOWN;
-            }
-            isMoving = true;
-        }
-
-        // Move one floor
-        if (currDir == EC_ELEVATOR_UP) {
-            currFloor++;
-        } else if (currDir == EC_ELEVATOR_DOWN) {
-            currFloor--;
-        }
+        ECSimMoveToward(ECSimNextDestination(listRequests, numFloors, currFloor, currDir, time), currFloor, currDir, isMoving);
     }
 
 private:
     bool isMoving;
     int waitTime;
-
-    int GetNextDestination(int time) {
-        int nextFloor = -1;
-        int minDistance = numFloors + 1;
-
-        // First handle requests in current direction
-        for (const auto &request : listRequests) {
-            if (request.GetTime() > time) continue;
-
-            int targetFloor = request.GetRequestedFloor();
-            if (targetFloor == -1) continue;
-
-            if (currDir == EC_ELEVATOR_UP && targetFloor >= currFloor) {
-                if (nextFloor == -1 || targetFloor < nextFloor) {
-                    nextFloor = targetFloor;
-                }
-            } else if (currDir == EC_ELEVATOR_DOWN && targetFloor <= currFloor) {
-                if (nextFloor == -1 || targetFloor > nextFloor) {
-                    nextFloor = targetFloor;
-                }
-            }
-        }
-
-        // If no requests in current direction, find closest request
-        if (nextFloor == -1) {
-            for (const auto &request : listRequests) {
-                if (request.GetTime() > time) continue;
-
-                int targetFloor = request.GetRequestedFloor();
-                if (targetFloor == -1) continue;
-
-                int distance = abs(targetFloor - currFloor);
-                if (distance < minDistance || (distance == minDistance && targetFloor > currFloor)) {
-                    minDistance = distance;
-                    nextFloor = targetFloor;
-                }
-            }
-        }
-
-        return nextFloor;
-    }
 };
 
 #endif /* ECElevatorSim_h */
\ No newline at end of file
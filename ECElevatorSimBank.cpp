@@ -0,0 +1,355 @@
+//
+//  ECElevatorSimBank.cpp
+//
+//
+//  Large elevator bank with the per-car work of each tick spread over threads
+//
+
+#include "ECElevatorSimBank.h"
+#include "ECElevatorSimKernels.h"
+#include "ECElevatorSimFixed.h"
+#include "ECElevatorBench.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// Polls before blocking: a car phase is a few microseconds, much less than
+// a futex round trip
+const int SPIN_LIMIT = 4096;
+
+// Size a per-car table with a cache line of unused capacity after it, so the
+// live part never shares a line with the next car's table on the heap
+template<class T>
+void ResizePadded(vector<T> &table, int size, T fill) {
+    table.reserve(size + 64 / sizeof(T));
+    table.resize(size, fill);
+}
+
+// Append, keeping the same cache line of spare capacity after a growing table
+template<class T>
+void PushPadded(vector<T> &table, const T &value) {
+    const size_t pad = (64 + sizeof(T) - 1) / sizeof(T);
+    if (table.size() + pad >= table.capacity()) {
+        table.reserve(2 * table.capacity() + pad);
+    }
+    table.push_back(value);
+}
+
+} // namespace
+
+ECElevatorSimBank::ECElevatorSimBank(int numFloors, vector<ECElevatorSimRequest> &listRequests, int numCars, int numThreadsIn)
+    : numFloors(numFloors), numCars(numCars), numThreads(max(1, min(numThreadsIn, numCars))), numSlots(max(numFloors, 1) + 1),
+      listRequests(listRequests), currTime(0), nextArrival(0), numAdmitted(0), epoch(0), remaining(0), stopping(false) {
+    if (numCars < 1) {
+        throw invalid_argument("ECElevatorSimBank: need at least one car");
+    }
+    cars.resize(numCars);
+    for (Car &c : cars) {
+        ResizePadded<int32_t>(c.waitHead, numSlots, -1);
+        ResizePadded<int32_t>(c.rideHead, numSlots, -1);
+        ResizePadded<uint8_t>(c.callMask, numSlots, 0);
+    }
+
+    // Requests enter the floor lists in order of request time
+    arrivalOrder.resize(listRequests.size());
+    iota(arrivalOrder.begin(), arrivalOrder.end(), 0);
+    stable_sort(arrivalOrder.begin(), arrivalOrder.end(),
+                [&listRequests](int32_t a, int32_t b) { return listRequests[a].GetTime() < listRequests[b].GetTime(); });
+
+    for (int t = 1; t < numThreads; t++) {
+        workers.emplace_back(&ECElevatorSimBank::Worker, this, t);
+    }
+}
+
+ECElevatorSimBank::~ECElevatorSimBank() {
+    stopping = true;
+    epoch.fetch_add(1, memory_order_release);
+    epoch.notify_all();
+    for (thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ECElevatorSimBank::Simulate(int lenSim) {
+    while (currTime < lenSim) {
+        Step();
+    }
+}
+
+void ECElevatorSimBank::Step() {
+    int time = currTime;
+
+    // Serial phase: admit and assign
+    while (nextArrival < arrivalOrder.size() && listRequests[arrivalOrder[nextArrival]].GetTime() <= time) {
+        Admit(arrivalOrder[nextArrival]);
+        nextArrival++;
+    }
+
+    // Car phase: thread 0 (this one) takes the first run of cars
+    if (numThreads == 1) {
+        RunCars(0, numCars);
+    } else {
+        remaining.store(numThreads - 1, memory_order_relaxed);
+        epoch.fetch_add(1, memory_order_release);
+        epoch.notify_all();
+        RunCars(0, numCars / numThreads);
+
+        int spins = 0;
+        for (int left = remaining.load(memory_order_acquire); left != 0; left = remaining.load(memory_order_acquire)) {
+            if (++spins > SPIN_LIMIT) {
+                remaining.wait(left, memory_order_acquire);
+            }
+        }
+    }
+    Publish(time);
+    currTime++;
+}
+
+void ECElevatorSimBank::Worker(int thread) {
+    const int first = static_cast<int>(static_cast<int64_t>(numCars) * thread / numThreads);
+    const int last = static_cast<int>(static_cast<int64_t>(numCars) * (thread + 1) / numThreads);
+    uint32_t seen = 0;
+    while (true) {
+        int spins = 0;
+        uint32_t now;
+        while ((now = epoch.load(memory_order_acquire)) == seen) {
+            if (++spins > SPIN_LIMIT) {
+                epoch.wait(seen, memory_order_acquire);
+            }
+        }
+        seen = now;
+        if (stopping) {
+            return;
+        }
+        RunCars(first, last);
+        if (remaining.fetch_sub(1, memory_order_acq_rel) == 1) {
+            remaining.notify_one();
+        }
+    }
+}
+
+size_t ECElevatorSimBank::GetNumPending() const {
+    int64_t numServiced = 0;
+    for (const Car &c : cars) {
+        numServiced += c.numServiced;
+    }
+    return static_cast<size_t>(numAdmitted - numServiced) + (arrivalOrder.size() - nextArrival);
+}
+
+void ECElevatorSimBank::EnsureFloor(int floor) {
+    if (floor < 0) {
+        throw out_of_range("ECElevatorSimBank: negative floor in request");
+    }
+    if (floor < numSlots) {
+        return;
+    }
+    numSlots = floor + 1;
+    for (Car &c : cars) {
+        ResizePadded<int32_t>(c.waitHead, numSlots, -1);
+        ResizePadded<int32_t>(c.rideHead, numSlots, -1);
+        ResizePadded<uint8_t>(c.callMask, numSlots, 0);
+    }
+}
+
+int ECElevatorSimBank::AssignCar(int floorSrc) const {
+    int best = 0;
+    for (int car = 1; car < numCars; car++) {
+        if (abs(cars[car].floor - floorSrc) < abs(cars[best].floor - floorSrc)) {
+            best = car;
+        }
+    }
+    return best;
+}
+
+void ECElevatorSimBank::Admit(int32_t index) {
+    const ECElevatorSimRequest &request = listRequests[index];
+    if (request.IsServiced() || request.GetFloorSrc() == -1) {
+        return;
+    }
+    int floorSrc = request.GetFloorSrc();
+    int floorDest = request.GetFloorDest();
+    EnsureFloor(floorSrc);
+    if (floorDest != -1) {
+        EnsureFloor(floorDest);
+    }
+    Car &c = cars[AssignCar(floorSrc)];
+    int floor = request.IsFloorRequestDone() ? floorDest : floorSrc;
+    if (floor != -1) {
+        vector<int32_t> &heads = request.IsFloorRequestDone() ? c.rideHead : c.waitHead;
+        int32_t entry = NewEntry(c, index, floorDest);
+        c.entries[entry].next = heads[floor];
+        heads[floor] = entry;
+        c.callMask[floor] = 1;
+    }
+    numAdmitted += floorDest != -1;
+}
+
+int32_t ECElevatorSimBank::NewEntry(Car &c, int32_t index, int floorDest) {
+    int32_t entry = c.freeEntry;
+    if (entry >= 0) {
+        c.freeEntry = c.entries[entry].next;
+    } else {
+        entry = static_cast<int32_t>(c.entries.size());
+        PushPadded(c.entries, Entry());
+    }
+    c.entries[entry].request = index;
+    c.entries[entry].floorDest = floorDest;
+    return entry;
+}
+
+void ECElevatorSimBank::FreeEntry(Car &c, int32_t entry) {
+    c.entries[entry].next = c.freeEntry;
+    c.freeEntry = entry;
+}
+
+void ECElevatorSimBank::RunCars(int first, int last) {
+    for (int car = first; car < last; car++) {
+        Car &c = cars[car];
+        if (ServeFloor(c) && c.moving) {
+            c.waitTime = 1;
+            c.moving = false;
+        }
+        if (c.waitTime > 0) {
+            c.waitTime--;
+            continue;
+        }
+        MoveCar(c);
+    }
+}
+
+bool ECElevatorSimBank::ServeFloor(Car &c) {
+    int floor = c.floor;
+    if (floor < 0 || floor >= numSlots || !c.callMask[floor]) {
+        return false;
+    }
+
+    // Board everyone waiting here, then let off everyone going here
+    int32_t entry = c.waitHead[floor];
+    c.waitHead[floor] = -1;
+    while (entry >= 0) {
+        Entry &e = c.entries[entry];
+        int32_t next = e.next;
+        PushPadded(c.boarded, e.request);
+        if (e.floorDest != -1) {
+            e.next = c.rideHead[e.floorDest];
+            c.rideHead[e.floorDest] = entry;
+            c.callMask[e.floorDest] = 1;
+        } else {
+            FreeEntry(c, entry);
+        }
+        entry = next;
+    }
+
+    entry = c.rideHead[floor];
+    c.rideHead[floor] = -1;
+    while (entry >= 0) {
+        int32_t next = c.entries[entry].next;
+        PushPadded(c.arrived, c.entries[entry].request);
+        FreeEntry(c, entry);
+        c.numServiced++;
+        entry = next;
+    }
+
+    c.callMask[floor] = 0;
+    return true;
+}
+
+void ECElevatorSimBank::Publish(int time) {
+    for (Car &c : cars) {
+        for (int32_t index : c.boarded) {
+            listRequests[index].SetFloorRequestDone(true);
+        }
+        for (int32_t index : c.arrived) {
+            listRequests[index].SetServiced(true);
+            listRequests[index].SetArriveTime(time);
+        }
+        c.boarded.clear();
+        c.arrived.clear();
+    }
+}
+
+void ECElevatorSimBank::MoveCar(Car &c) {
+    // One pass over this car's floors for the nearest call at/above and at/below it
+    ECFloorBounds bounds;
+    const uint8_t *called = c.callMask.data();
+    for (int floor = 0; floor < numSlots; floor++) {
+        bounds.minAbove = min<int32_t>(bounds.minAbove, (called[floor] && floor >= c.floor) ? floor : INT_MAX);
+        bounds.maxBelow = max<int32_t>(bounds.maxBelow, (called[floor] && floor <= c.floor) ? floor : INT_MIN);
+    }
+
+    int nextFloor = ECChooseNextFloor(bounds, c.dir, c.floor, numFloors);
+    if (nextFloor == -1) {
+        c.dir = EC_ELEVATOR_STOPPED;
+        c.moving = false;
+        return;
+    }
+
+    if (!c.moving) {
+        if (nextFloor > c.floor) {
+            c.dir = EC_ELEVATOR_UP;
+        } else if (nextFloor < c.floor) {
+            c.dir = EC_ELEVATOR_DOWN;
+        }
+        c.moving = true;
+    }
+
+    if (c.dir == EC_ELEVATOR_UP) {
+        c.floor++;
+    } else if (c.dir == EC_ELEVATOR_DOWN) {
+        c.floor--;
+    }
+}
+
+//*****************************************************************************
+// Driver
+
+void ECRunBankBenchmark(ostream &os, int numCars) {
+    const int numFloors = 80;
+    const int numRequests = 400000;
+    const int lenRequests = 100000;
+    const int lenSim = lenRequests + 20000;
+    const vector<ECElevatorSimRequest> trace = ECMakeRandomTrace(2023, numFloors, numRequests, lenRequests);
+
+    os << numFloors << " floors, " << numCars << " cars, " << numRequests << " requests, " << lenSim << " ticks\n";
+    auto timeRun = [](const function<void()> &run) {
+        auto start = chrono::steady_clock::now();
+        run();
+        auto stop = chrono::steady_clock::now();
+        return chrono::duration<double, milli>(stop - start).count();
+    };
+
+    vector<ECElevatorSimRequest> reference = trace;
+    double msReference = timeRun([&]() {
+        ECElevatorSimGeneric sim(numFloors, reference, numCars);
+        sim.Simulate(lenSim);
+    });
+    os << "  " << left << setw(26) << "ECElevatorSimGeneric" << right << fixed << setprecision(1) << setw(9) << msReference << " ms\n";
+
+    const unsigned int hardwareThreads = max(1u, thread::hardware_concurrency());
+    for (int numThreads = 1; numThreads <= 8; numThreads *= 2) {
+        vector<ECElevatorSimRequest> result = trace;
+        double ms = timeRun([&]() {
+            ECElevatorSimBank sim(numFloors, result, numCars, numThreads);
+            sim.Simulate(lenSim);
+        });
+        bool same = true;
+        for (size_t i = 0; i < result.size(); i++) {
+            if (result[i].IsServiced() != reference[i].IsServiced() || result[i].GetArriveTime() != reference[i].GetArriveTime()) {
+                same = false;
+                break;
+            }
+        }
+        string name = "ECElevatorSimBank, " + to_string(numThreads) + (numThreads == 1 ? " thread" : " threads");
+        os << "  " << left << setw(26) << name << right << setw(9) << ms << " ms  x" << setprecision(2) << msReference / ms
+           << setprecision(1) << (same ? "" : "  RESULTS DIFFER")
+           << (static_cast<unsigned int>(numThreads) > hardwareThreads ? "  (more threads than cores)" : "") << "\n";
+    }
+}
@@ -0,0 +1,121 @@
+//
+//  ECElevatorSimBank.h
+//
+//
+//  Large elevator bank with the per-car work of each tick spread over threads
+//
+
+#ifndef ECElevatorSimBank_h
+#define ECElevatorSimBank_h
+
+#include "ECElevatorSim.h"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Same policy and results as ECElevatorSimGeneric with numCars cars, for banks
+// with many cars. Each tick has two phases:
+//   - serial: requests that arrive are admitted and given to the car closest
+//     to their source floor (the only step that looks at every car)
+//   - parallel: every car serves its floor (boarding, alighting) and moves.
+//     A car only touches its own state, so the cars are split into contiguous
+//     runs, one per thread.
+// Each car keeps its state in its own 64-byte aligned block, and its floor lists,
+// the links of the requests on them and what happened to them this tick in
+// tables of its own, padded by a cache line (car-major rather than
+// ECElevatorSimT's floor-major tables). The car phase does not write the shared
+// request list: boardings and arrivals are copied into it by the serial phase
+// at the end of the tick. So two threads never write to the same cache line.
+//
+// The threads are started by the constructor and stay parked between ticks.
+// A tick releases them by bumping an epoch counter and the last one to finish
+// wakes the simulating thread; both sides spin briefly before blocking on
+// std::atomic::wait. There is no listener: ECSimListener hooks would be called
+// from several threads.
+
+class ECElevatorSimBank
+{
+public:
+    // numThreads includes the calling thread and is capped at numCars
+    ECElevatorSimBank(int numFloors, std::vector<ECElevatorSimRequest> &listRequests, int numCars, int numThreads = 1);
+    ~ECElevatorSimBank();
+
+    ECElevatorSimBank(const ECElevatorSimBank &) = delete;
+    ECElevatorSimBank &operator=(const ECElevatorSimBank &) = delete;
+
+    // Run until time lenSim (a later call continues where the last one stopped)
+    void Simulate(int lenSim);
+    // Advance by one tick
+    void Step();
+
+    int GetNumCars() const { return numCars; }
+    int GetNumThreads() const { return numThreads; }
+    int GetTime() const { return currTime; }
+    // Requests not serviced yet: still to arrive, waiting, or riding
+    size_t GetNumPending() const;
+    int GetCurrFloor(int car = 0) const { return cars[car].floor; }
+    EC_ELEVATOR_DIR GetCurrDir(int car = 0) const { return cars[car].dir; }
+
+private:
+    struct Entry {
+        int32_t request;                        // index in listRequests
+        int32_t next;                           // next entry on the same list
+        int32_t floorDest;
+    };
+    struct alignas(64) Car {
+        int floor = 1;
+        EC_ELEVATOR_DIR dir = EC_ELEVATOR_STOPPED;
+        bool moving = false;
+        int waitTime = 0;
+        int64_t numServiced = 0;
+        std::vector<int32_t> waitHead;          // per floor: first entry waiting there
+        std::vector<int32_t> rideHead;          // per floor: first rider going there
+        std::vector<uint8_t> callMask;          // per floor: any of the two lists non-empty
+        std::vector<Entry> entries;             // this car's requests (free ones are reused)
+        int32_t freeEntry = -1;                 // first free entry, linked through next
+        std::vector<int32_t> boarded;           // requests that boarded this tick
+        std::vector<int32_t> arrived;           // requests that arrived this tick
+    };
+
+    void EnsureFloor(int floor);
+    int AssignCar(int floorSrc) const;
+    void Admit(int32_t index);
+    int32_t NewEntry(Car &c, int32_t index, int floorDest);
+    void FreeEntry(Car &c, int32_t entry);
+    void RunCars(int first, int last);
+    // Copy the car phase's boardings and arrivals into listRequests
+    void Publish(int time);
+    bool ServeFloor(Car &c);
+    void MoveCar(Car &c);
+    void Worker(int thread);
+
+    int numFloors;
+    int numCars;
+    int numThreads;
+    int numSlots;                               // floors 0..numSlots-1 have table entries
+    std::vector<ECElevatorSimRequest> &listRequests;
+    int currTime;
+
+    std::vector<Car> cars;
+    std::vector<int32_t> arrivalOrder;          // request indices sorted by time
+    size_t nextArrival;
+    int64_t numAdmitted;                        // admitted with a destination (see ECElevatorSimT)
+
+    // Fork-join between ticks
+    std::vector<std::thread> workers;
+    alignas(64) std::atomic<uint32_t> epoch;    // bumped to start the car phase
+    alignas(64) std::atomic<int> remaining;     // workers still in the car phase
+    bool stopping;
+};
+
+//*****************************************************************************
+// Driver (main's --bank): a busy 48-car bank run with ECElevatorSimGeneric and
+// with ECElevatorSimBank on 1, 2, 4 and 8 threads; prints the times and whether
+// the results match
+
+void ECRunBankBenchmark(std::ostream &os, int numCars = 48);
+
+#endif /* ECElevatorSimBank_h */
@@ -0,0 +1,230 @@
+//
+//  ECElevatorSimBatch.cpp
+//
+//
+//  Lockstep simulation of many independent single-car scenarios
+//
+
+#include "ECElevatorSimBatch.h"
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+namespace {
+
+const int32_t DONE = 1;
+const int32_t SERVICED = 2;
+
+} // namespace
+
+void ECElevatorSimBatch::AddScenario(int numFloors, int lenSim, std::vector<ECElevatorSimRequest> &listRequests) {
+    Scenario scenario;
+    scenario.numFloors = numFloors;
+    scenario.lenSim = lenSim;
+    scenario.listRequests = &listRequests;
+    scenario.finalFloor = 1;
+    scenario.finalDir = EC_ELEVATOR_STOPPED;
+    scenarios.push_back(scenario);
+}
+
+void ECElevatorSimBatch::Simulate() {
+    // Pack scenarios of like length and size together, so that a group's lanes
+    // finish at about the same tick and scan about the same number of slots
+    packOrder.resize(scenarios.size());
+    std::iota(packOrder.begin(), packOrder.end(), 0);
+    std::stable_sort(packOrder.begin(), packOrder.end(), [this](size_t a, size_t b) {
+        const Scenario &x = scenarios[a], &y = scenarios[b];
+        if (x.lenSim != y.lenSim) return x.lenSim < y.lenSim;
+        return x.listRequests->size() < y.listRequests->size();
+    });
+    for (size_t first = 0; first < scenarios.size(); first += LANES) {
+        SimulateGroup(packOrder.data() + first, std::min<size_t>(LANES, scenarios.size() - first));
+    }
+}
+
+void ECElevatorSimBatch::SimulateGroup(const size_t *group, size_t count) {
+    const int L = LANES;
+
+    // Lane state; lanes past 'count' are padding with lenSim 0 and never run.
+    // lenSim of a lane is cut short once nothing can change in it any more.
+    int32_t numFloors[L], lenSim[L], lastArrival[L], floor[L], dir[L], moving[L], waitTime[L];
+    size_t numSlots = 0;
+    for (int k = 0; k < L; k++) {
+        bool used = k < (int)count;
+        numFloors[k] = used ? scenarios[group[k]].numFloors : 1;
+        lenSim[k] = used ? scenarios[group[k]].lenSim : 0;
+        lastArrival[k] = -1;
+        floor[k] = 1;
+        dir[k] = EC_ELEVATOR_STOPPED;
+        moving[k] = 0;
+        waitTime[k] = 0;
+        if (used) {
+            numSlots = std::max(numSlots, scenarios[group[k]].listRequests->size());
+        }
+    }
+
+    // Interleave the requests by lane, each lane sorted by request time so that
+    // slots [0, arrivedEnd) cover every request that has arrived in any lane.
+    // Padding slots never arrive and count as serviced.
+    slotTime.assign(numSlots * L, INT_MAX);
+    slotSrc.assign(numSlots * L, 0);
+    slotDest.assign(numSlots * L, 0);
+    slotState.assign(numSlots * L, SERVICED);
+    slotArrive.assign(numSlots * L, -1);
+    slotIndex.assign(numSlots * L, -1);
+    std::vector<int32_t> order;
+    for (size_t k = 0; k < count; k++) {
+        const std::vector<ECElevatorSimRequest> &list = *scenarios[group[k]].listRequests;
+        order.resize(list.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&list](int32_t a, int32_t b) { return list[a].GetTime() < list[b].GetTime(); });
+        for (size_t j = 0; j < list.size(); j++) {
+            const ECElevatorSimRequest &request = list[order[j]];
+            size_t slot = j * L + k;
+            slotTime[slot] = request.GetTime();
+            slotSrc[slot] = request.GetFloorSrc();
+            slotDest[slot] = request.GetFloorDest();
+            slotState[slot] = (request.IsFloorRequestDone() ? DONE : 0) | (request.IsServiced() ? SERVICED : 0);
+            slotArrive[slot] = request.GetArriveTime();
+            slotIndex[slot] = order[j];
+            if (request.GetTime() < lenSim[k]) {
+                lastArrival[k] = request.GetTime();
+            }
+        }
+    }
+
+    int32_t *time = slotTime.data();
+    const int32_t *src = slotSrc.data();
+    const int32_t *dest = slotDest.data();
+    int32_t *state = slotState.data();
+    int32_t *arrive = slotArrive.data();
+
+    size_t firstLive = 0;
+    size_t arrivedEnd = 0;
+
+    for (int t = 0; ; t++) {
+        int32_t live[L], processed[L];
+        int32_t anyLive = 0;
+        for (int k = 0; k < L; k++) {
+            live[k] = t < lenSim[k];
+            processed[k] = 0;
+            anyLive |= live[k];
+        }
+        if (!anyLive) {
+            break;
+        }
+
+        // Slot window for this tick. A slot stops pinning the front of the window
+        // once no lane can still act on it: serviced, its lane is finished, or its
+        // requested floor is -1 (a maintenance start, never picked up)
+        while (arrivedEnd < numSlots && *std::min_element(time + arrivedEnd * L, time + arrivedEnd * L + L) <= t) {
+            arrivedEnd++;
+        }
+        while (firstLive < arrivedEnd) {
+            const int32_t *s = state + firstLive * L;
+            const int32_t *fs = src + firstLive * L;
+            const int32_t *fd = dest + firstLive * L;
+            int32_t pending = 0;
+            for (int k = 0; k < L; k++) {
+                int32_t target = (s[k] & DONE) ? fd[k] : fs[k];
+                pending |= live[k] & ((s[k] & SERVICED) == 0) & (target != -1);
+            }
+            if (pending) break;
+            firstLive++;
+        }
+
+        // Pickups and dropoffs at each lane's current floor
+        for (size_t j = firstLive; j < arrivedEnd; j++) {
+            int32_t *s = state + j * L;
+            int32_t *a = arrive + j * L;
+            const int32_t *tm = time + j * L;
+            const int32_t *fs = src + j * L;
+            const int32_t *fd = dest + j * L;
+            for (int k = 0; k < L; k++) {
+                int32_t active = live[k] & (tm[k] <= t) & ((s[k] & SERVICED) == 0);
+                int32_t pick = active & ((s[k] & DONE) == 0) & (fs[k] == floor[k]);
+                int32_t drop = active & (((s[k] & DONE) != 0) | pick) & (fd[k] == floor[k]);
+                s[k] |= pick * DONE | drop * SERVICED;
+                a[k] = drop ? t : a[k];
+                processed[k] |= pick | drop;
+            }
+        }
+
+        // Door stop and wait timer
+        int32_t doMove[L];
+        int32_t anyMove = 0;
+        for (int k = 0; k < L; k++) {
+            int32_t stop = live[k] & processed[k] & moving[k];
+            waitTime[k] = stop ? 1 : waitTime[k];
+            moving[k] = stop ? 0 : moving[k];
+            int32_t waiting = live[k] & (waitTime[k] > 0);
+            waitTime[k] -= waiting;
+            doMove[k] = live[k] & !waiting;
+            anyMove |= doMove[k];
+        }
+        if (!anyMove) {
+            continue;
+        }
+
+        // Nearest requested floor at/above and at/below each car
+        int32_t minAbove[L], maxBelow[L];
+        for (int k = 0; k < L; k++) {
+            minAbove[k] = INT_MAX;
+            maxBelow[k] = INT_MIN;
+        }
+        for (size_t j = firstLive; j < arrivedEnd; j++) {
+            const int32_t *s = state + j * L;
+            const int32_t *tm = time + j * L;
+            const int32_t *fs = src + j * L;
+            const int32_t *fd = dest + j * L;
+            for (int k = 0; k < L; k++) {
+                int32_t target = (s[k] & DONE) ? fd[k] : fs[k];
+                int32_t valid = (tm[k] <= t) & ((s[k] & SERVICED) == 0) & (target != -1);
+                minAbove[k] = std::min(minAbove[k], (valid & (target >= floor[k])) ? target : INT_MAX);
+                maxBelow[k] = std::max(maxBelow[k], (valid & (target <= floor[k])) ? target : INT_MIN);
+            }
+        }
+
+        // Next destination and car movement (same rules as ECElevatorSim::MoveElevator)
+        for (int k = 0; k < L; k++) {
+            int32_t haveAbove = minAbove[k] != INT_MAX;
+            int32_t haveBelow = maxBelow[k] != INT_MIN;
+            int64_t distAbove = haveAbove ? (int64_t)minAbove[k] - floor[k] : INT64_MAX;
+            int64_t distBelow = haveBelow ? (int64_t)floor[k] - maxBelow[k] : INT64_MAX;
+            int32_t closest = distAbove <= distBelow ? (distAbove <= numFloors[k] + 1 ? minAbove[k] : -1)
+                                                     : (distBelow <= numFloors[k] ? maxBelow[k] : -1);
+            int32_t next = (dir[k] == EC_ELEVATOR_UP && haveAbove) ? minAbove[k]
+                         : (dir[k] == EC_ELEVATOR_DOWN && haveBelow) ? maxBelow[k] : closest;
+
+            int32_t none = next == -1;
+            int32_t start = !none & !moving[k];
+            int32_t newDir = next > floor[k] ? EC_ELEVATOR_UP : (next < floor[k] ? EC_ELEVATOR_DOWN : dir[k]);
+            newDir = start ? newDir : dir[k];
+            newDir = none ? EC_ELEVATOR_STOPPED : newDir;
+            int32_t step = (newDir == EC_ELEVATOR_UP) - (newDir == EC_ELEVATOR_DOWN);
+
+            dir[k] = doMove[k] ? newDir : dir[k];
+            moving[k] = doMove[k] ? !none : moving[k];
+            floor[k] += doMove[k] & !none ? step : 0;
+
+            // A stopped car with nothing to do and nothing left to arrive stays so
+            lenSim[k] = (doMove[k] & none & (lastArrival[k] <= t)) ? t + 1 : lenSim[k];
+        }
+    }
+
+    // Write results back to each scenario's request list
+    for (size_t k = 0; k < count; k++) {
+        Scenario &scenario = scenarios[group[k]];
+        std::vector<ECElevatorSimRequest> &list = *scenario.listRequests;
+        for (size_t j = 0; j < list.size(); j++) {
+            size_t slot = j * L + k;
+            ECElevatorSimRequest &request = list[slotIndex[slot]];
+            request.SetFloorRequestDone((state[slot] & DONE) != 0);
+            request.SetServiced((state[slot] & SERVICED) != 0);
+            request.SetArriveTime(arrive[slot]);
+        }
+        scenario.finalFloor = floor[k];
+        scenario.finalDir = static_cast<EC_ELEVATOR_DIR>(dir[k]);
+    }
+}
@@ -0,0 +1,70 @@
+//
+//  ECElevatorSimBatch.h
+//
+//
+//  Lockstep simulation of many independent single-car scenarios
+//
+
+#ifndef ECElevatorSimBatch_h
+#define ECElevatorSimBatch_h
+
+#include "ECElevatorSim.h"
+#include <cstdint>
+#include <vector>
+
+//*****************************************************************************
+// Runs many small, independent ECElevatorSim scenarios at once. Scenarios are
+// packed LANES at a time into a group; each group keeps the car state (floor,
+// direction, moving, wait timer) as one small array per field, and its requests
+// interleaved by lane, so request slot j of all lanes is one contiguous vector.
+// Every tick advances all lanes of a group together: the per-request predicates
+// and the car state updates are branch-free lane loops with the per-lane decisions
+// applied as masks, which the compiler turns into SIMD code. Scenarios are packed
+// by lenSim and number of requests, a lane stops once its car is idle with no
+// request left to arrive, and a group ends when all its lanes have stopped.
+//
+// Results (IsFloorRequestDone / IsServiced / GetArriveTime and the final car
+// floor and direction) are identical to running ECElevatorSim::Simulate on each
+// scenario separately.
+
+class ECElevatorSimBatch
+{
+public:
+    static const int LANES = 8;
+
+    ECElevatorSimBatch() {}
+
+    // The request list is simulated in place; it must stay alive until Simulate returns
+    void AddScenario(int numFloors, int lenSim, std::vector<ECElevatorSimRequest> &listRequests);
+    void Clear() { scenarios.clear(); }
+
+    void Simulate();
+
+    size_t GetNumScenarios() const { return scenarios.size(); }
+    int GetCurrFloor(size_t scenario) const { return scenarios[scenario].finalFloor; }
+    EC_ELEVATOR_DIR GetCurrDir(size_t scenario) const { return scenarios[scenario].finalDir; }
+
+private:
+    struct Scenario {
+        int numFloors;
+        int lenSim;
+        std::vector<ECElevatorSimRequest> *listRequests;
+        int finalFloor;
+        EC_ELEVATOR_DIR finalDir;
+    };
+
+    void SimulateGroup(const size_t *group, size_t count);
+
+    std::vector<Scenario> scenarios;
+    std::vector<size_t> packOrder;      // scenarios by lenSim, then number of requests
+
+    // Per-group request slots, laid out [slot][lane]; reused between groups
+    std::vector<int32_t> slotTime;
+    std::vector<int32_t> slotSrc;
+    std::vector<int32_t> slotDest;
+    std::vector<int32_t> slotState;
+    std::vector<int32_t> slotArrive;
+    std::vector<int32_t> slotIndex;     // index of the request in its scenario's list
+};
+
+#endif /* ECElevatorSimBatch_h */
@@ -0,0 +1,62 @@
+//
+//  ECElevatorSimCompact.h
+//
+//
+//  Elevator simulation over arena-backed compact request records
+//
+
+#ifndef ECElevatorSimCompact_h
+#define ECElevatorSimCompact_h
+
+#include "ECElevatorSim.h"
+#include "ECElevatorRequestArena.h"
+
+//*****************************************************************************
+// Same policy as ECElevatorSim (the same ECSimServeFloor / ECSimNextDestination
+// templates), but over an ECCompactTrace instead of a vector of
+// ECElevatorSimRequest. Meant for very long runs where the request list no
+// longer fits comfortably in memory in its full-size form.
+
+class ECElevatorSimCompact {
+public:
+    ECElevatorSimCompact(int numFloors, ECCompactTrace &trace)
+        : numFloors(numFloors), trace(trace), currFloor(1), currDir(EC_ELEVATOR_STOPPED), isMoving(false), waitTime(0) {}
+
+    void Simulate(int lenSim) {
+        for (int time = 0; time < lenSim; time++) {
+            ProcessFloorRequests(time);
+
+            if (waitTime > 0) {
+                waitTime--;
+                continue;
+            }
+
+            MoveElevator(time);
+        }
+    }
+
+    int GetNumFloors() const { return numFloors; }
+    int GetCurrFloor() const { return currFloor; }
+    EC_ELEVATOR_DIR GetCurrDir() const { return currDir; }
+
+    void ProcessFloorRequests(int time) {
+        if (ECSimServeFloor(trace, currFloor, time) && isMoving) {
+            waitTime = 1;
+            isMoving = false;
+        }
+    }
+
+    void MoveElevator(int time) {
+        ECSimMoveToward(ECSimNextDestination(trace, numFloors, currFloor, currDir, time), currFloor, currDir, isMoving);
+    }
+
+private:
+    int numFloors;
+    ECCompactTrace &trace;
+    int currFloor;
+    EC_ELEVATOR_DIR currDir;
+    bool isMoving;
+    int waitTime;
+};
+
+#endif /* ECElevatorSimCompact_h */
@@ -0,0 +1,565 @@
+//
+//  ECElevatorSimFixed.h
+//
+//
+//  Elevator simulation specialized on the building configuration
+//
+
+#ifndef ECElevatorSimFixed_h
+#define ECElevatorSimFixed_h
+
+#include "ECElevatorEtaTable.h"
+#include "ECElevatorSim.h"
+#include "ECElevatorSimKernels.h"
+#include "ECTimingWheel.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+//*****************************************************************************
+// Building sizes given as template arguments; EC_DYNAMIC_EXTENT means "given
+// at run time" (see ECElevatorSimGeneric below)
+
+const int EC_DYNAMIC_EXTENT = 0;
+
+// |a - b| for every pair of floors 0..Floors, computed at compile time
+template<int Floors>
+struct ECFloorDistanceTable {
+    constexpr ECFloorDistanceTable() : dist() {
+        for (int a = 0; a <= Floors; a++) {
+            for (int b = 0; b <= Floors; b++) {
+                dist[a][b] = static_cast<uint16_t>(a > b ? a - b : b - a);
+            }
+        }
+    }
+    uint16_t dist[Floors + 1][Floors + 1];
+};
+
+//*****************************************************************************
+// Told about what happens in the simulation (see ECElevatorSimT::SetListener).
+// Called on the simulation thread as things happen, tick by tick; a listener
+// overrides the hooks it cares about. A hook may add requests (AddRequest); the
+// request it is given is a copy, so it stays valid when listRequests grows.
+
+class ECSimListener
+{
+public:
+    virtual ~ECSimListener() {}
+    // A request entered the simulation and was given to 'car'; it is waiting at its
+    // source floor, or already riding if request.IsFloorRequestDone()
+    virtual void OnRequestAdmitted(int32_t /* index */, const ECElevatorSimRequest & /* request */, int /* car */, int /* time */) {}
+    virtual void OnRequestBoarded(int32_t /* index */, const ECElevatorSimRequest & /* request */, int /* car */, int /* time */) {}
+    // index: position in listRequests; boardTime: tick it was picked up (-1 if it was
+    // already on board when admitted); the arrive time is request.GetArriveTime()
+    virtual void OnRequestServiced(int32_t /* index */, const ECElevatorSimRequest & /* request */, int /* boardTime */, int /* car */) {}
+    // The car stopped at its floor to let passengers on or off
+    virtual void OnCarStopped(int /* car */, int /* floor */, int /* time */) {}
+    // The car's floor or direction changed
+    virtual void OnCarMoved(int /* car */, int /* floor */, EC_ELEVATOR_DIR /* dir */, int /* time */) {}
+    // Everything for tick 'time' has been reported
+    virtual void OnTickEnd(int /* time */) {}
+};
+
+//*****************************************************************************
+// Elevator simulation with per-floor call masks
+//
+// Instead of scanning the whole request list every tick, each request is put
+// on a per-floor list when it arrives: waiting at its source floor, then riding
+// to its destination floor. A per-floor call mask says whether a car has any
+// reason to stop at a floor, so choosing the next destination is one pass over
+// the floors rather than over the requests.
+//
+// With Floors and Cars fixed, the call masks and floor lists are std::arrays and
+// the per-floor loops have a constant trip count, which the compiler unrolls and
+// vectorizes. ECElevatorSimGeneric has the same API with run-time sizes.
+//
+// With one car the results are identical to ECElevatorSim. With several cars each
+// request is given, when it arrives, to the car closest to its source floor (lowest
+// car on a tie), or with EC_DISPATCH_ETA to the car expected there soonest (see
+// ECEtaTable); every car then follows the ECElevatorSim policy on its own requests.
+//
+// Floors are 0..Floors (0 is used by the maintenance end request); requests whose
+// source floor is -1 (maintenance start) are never picked up, as in ECElevatorSim.
+//
+// Only cars with something to do are stepped. A car that stops to serve a floor
+// after moving leaves the tick loop for its dwell and a timer brings it back; a
+// car with no calls is parked until a request is given to it. Requests added for
+// a later time wait on the same timing wheel, so a tick costs the cars in motion
+// plus the timers due.
+
+template<int Floors, int Cars>
+class ECElevatorSimT
+{
+    static_assert((Floors > 0) == (Cars > 0), "Floors and Cars are either both fixed or both dynamic");
+    static constexpr bool FIXED = Floors > 0;
+    static constexpr int FIXED_SLOTS = FIXED ? (Floors + 1) * Cars : 1;
+
+    template<class T>
+    using FloorTable = typename std::conditional<FIXED, std::array<T, FIXED_SLOTS>, std::vector<T>>::type;
+
+public:
+    ECElevatorSimT(int numFloors, std::vector<ECElevatorSimRequest> &listRequests, int numCars = (Cars > 0 ? Cars : 1))
+        : numFloors(numFloors), numCars(FIXED ? Cars : numCars), numSlots(FIXED ? Floors + 1 : std::max(numFloors, 1) + 1),
+          listRequests(listRequests), currTime(0), nextArrival(0), numLateArrivals(0), numPending(0), listener(nullptr) {
+        if (FIXED && numFloors > Floors) {
+            throw std::out_of_range("ECElevatorSimT: building has more floors than the template allows");
+        }
+        if (this->numCars < 1) {
+            throw std::invalid_argument("ECElevatorSimT: need at least one car");
+        }
+        if constexpr (!FIXED) {
+            cars.resize(this->numCars);
+        }
+        // Every car starts parked; each has at most one dwell timer at a time
+        activeCars.assign((this->numCars + 63) / 64, 0);
+        timers.Reserve(this->numCars);
+        ResizeTables();
+        std::fill(waitHead.begin(), waitHead.end(), -1);
+        std::fill(rideHead.begin(), rideHead.end(), -1);
+        std::fill(callMask.begin(), callMask.end(), 0);
+
+        // Requests enter the floor lists in order of request time
+        arrivalOrder.resize(listRequests.size());
+        std::iota(arrivalOrder.begin(), arrivalOrder.end(), 0);
+        std::stable_sort(arrivalOrder.begin(), arrivalOrder.end(),
+                         [&listRequests](int32_t a, int32_t b) { return listRequests[a].GetTime() < listRequests[b].GetTime(); });
+        nextLink.assign(listRequests.size(), -1);
+        boardTime.assign(listRequests.size(), -1);
+        cancelled.assign(listRequests.size(), 0);
+    }
+
+    // Listener told about each request as it is serviced (nullptr: none)
+    void SetListener(ECSimListener *listenerIn) { listener = listenerIn; }
+
+    // How arriving requests are given to cars (before the first Step)
+    void SetDispatchPolicy(ECDispatchPolicy policy) {
+        dispatchPolicy = policy;
+        if (policy == EC_DISPATCH_ETA) {
+            eta.Resize(numSlots, numCars);
+        }
+    }
+
+    // Run until time lenSim (ticks 0..lenSim-1 overall; a later call continues where the last one stopped)
+    void Simulate(int lenSim) {
+        while (currTime < lenSim) {
+            Step();
+        }
+    }
+
+    // Advance by one tick
+    void Step() {
+        int time = currTime;
+
+        while (nextArrival < arrivalOrder.size() && listRequests[arrivalOrder[nextArrival]].GetTime() <= time) {
+            Admit(arrivalOrder[nextArrival]);
+            nextArrival++;
+        }
+        timers.Advance(time, [this](int32_t event, int) {
+            if (event >= 0) {
+                dueArrivals.push_back(event);
+            } else {
+                SetActive(~event, true);
+            }
+        });
+        if (!dueArrivals.empty()) {
+            // Added requests are admitted in order of their index, as they were added
+            std::sort(dueArrivals.begin(), dueArrivals.end());
+            numLateArrivals -= dueArrivals.size();
+            for (int32_t index : dueArrivals) {
+                Admit(index);
+            }
+            dueArrivals.clear();
+        }
+
+        // The active set is read afresh after each car: a listener adding a request
+        // may unpark a car later in the order, which then runs this tick
+        for (int car = NextActiveCar(0); car < numCars; car = NextActiveCar(car + 1)) {
+            Car &c = cars[car];
+            if (ServeFloor(car, time)) {
+                if (listener) {
+                    listener->OnCarStopped(car, c.floor, time);
+                }
+                if (c.moving) {
+                    // Dwell: out of the loop until the timer brings the car back
+                    c.moving = false;
+                    SetActive(car, false);
+                    timers.Schedule(time + DWELL_TICKS, ~car);
+                    continue;
+                }
+                if (callMask[Slot(c.floor, car)]) {
+                    // The listener gave it a request at this floor: it stays for the next tick
+                    continue;
+                }
+            }
+            int floorBefore = c.floor;
+            EC_ELEVATOR_DIR dirBefore = c.dir;
+            bool called = MoveCar(car);
+            if (c.floor != floorBefore || c.dir != dirBefore) {
+                if (listener) {
+                    listener->OnCarMoved(car, c.floor, c.dir, time);
+                }
+                if (dispatchPolicy == EC_DISPATCH_ETA) {
+                    if (c.dir == dirBefore) {
+                        eta.Advance(car, c.floor);
+                    } else {
+                        eta.MarkDirty(car);
+                    }
+                }
+            }
+            if (!called) {
+                // Stopped with no calls: nothing changes until a request is given to it
+                c.parked = true;
+                SetActive(car, false);
+            }
+        }
+        if (listener) {
+            listener->OnTickEnd(time);
+        }
+        currTime++;
+    }
+
+    // Make room for n requests in all, in listRequests and in the per-request
+    // tables and timers, so adding requests up to that many does not allocate
+    void Reserve(size_t n) {
+        listRequests.reserve(n);
+        nextLink.reserve(n);
+        boardTime.reserve(n);
+        cancelled.reserve(n);
+        dueArrivals.reserve(n);
+        timers.Reserve(n + numCars);
+    }
+
+    // Add a request while the simulation runs (listRequests grows by one; call
+    // Reserve ahead of time to keep this allocation-free). A request for the current
+    // time or earlier is considered from the next tick on. Returns its index in
+    // listRequests.
+    int AddRequest(int time, int floorSrc, int floorDest) {
+        int32_t index = static_cast<int32_t>(listRequests.size());
+        listRequests.push_back(ECElevatorSimRequest(time, floorSrc, floorDest));
+        nextLink.push_back(-1);
+        boardTime.push_back(-1);
+        cancelled.push_back(0);
+        if (time <= currTime) {
+            Admit(index);
+        } else {
+            timers.Schedule(time, index);
+            numLateArrivals++;
+        }
+        return index;
+    }
+
+    // Withdraw a request waiting at its floor: it leaves the floor list and stays
+    // neither picked up nor serviced; IsCancelled tells it apart from one still
+    // waiting (no listener hook is called). A car left with no call ahead of it
+    // stops heading that way. False if the request is not waiting (not admitted
+    // yet, cancelled, on board or serviced).
+    bool CancelRequest(int32_t index) {
+        ECElevatorSimRequest &request = listRequests[index];
+        int floorSrc = request.GetFloorSrc();
+        if (cancelled[index] || request.IsServiced() || request.IsFloorRequestDone() || floorSrc < 0 || floorSrc >= numSlots) {
+            return false;
+        }
+        for (int car = 0; car < numCars; car++) {
+            int slot = Slot(floorSrc, car);
+            int32_t *link = &waitHead[slot];
+            while (*link >= 0 && *link != index) {
+                link = &nextLink[*link];
+            }
+            if (*link != index) {
+                continue;
+            }
+            *link = nextLink[index];
+            nextLink[index] = -1;
+            callMask[slot] = waitHead[slot] >= 0 || rideHead[slot] >= 0;
+            // A moving car only turns when it stops; with nothing left ahead it
+            // would run on past the end of the shaft, so it picks a way afresh
+            Car &c = cars[car];
+            if (c.moving && c.dir != EC_ELEVATOR_STOPPED) {
+                bool ahead = false;
+                for (int floor = c.floor; floor >= 0 && floor < numSlots && !ahead;
+                     floor += c.dir == EC_ELEVATOR_UP ? 1 : -1) {
+                    ahead = callMask[Slot(floor, car)] != 0;
+                }
+                c.moving = ahead;
+            }
+            cancelled[index] = 1;
+            numPending -= request.GetFloorDest() != -1;
+            if (dispatchPolicy == EC_DISPATCH_ETA) {
+                eta.MarkDirty(car);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // Withdrawn by CancelRequest
+    bool IsCancelled(int32_t index) const { return cancelled[index] != 0; }
+
+    int GetNumFloors() const { return numFloors; }
+    int GetNumCars() const { return numCars; }
+    int GetTime() const { return currTime; }
+    // Requests not serviced yet: still to arrive, waiting, or riding
+    size_t GetNumPending() const { return numPending + (arrivalOrder.size() - nextArrival) + numLateArrivals; }
+    int GetCurrFloor(int car = 0) const { return cars[car].floor; }
+    EC_ELEVATOR_DIR GetCurrDir(int car = 0) const { return cars[car].dir; }
+
+private:
+    struct Car {
+        Car() : floor(1), dir(EC_ELEVATOR_STOPPED), moving(false), parked(true) {}
+        int floor;
+        EC_ELEVATOR_DIR dir;
+        bool moving;
+        bool parked;                            // out of the tick loop until given a request
+    };
+    typedef typename std::conditional<FIXED, std::array<Car, (Cars > 0 ? Cars : 1)>, std::vector<Car>>::type CarTable;
+
+    // Ticks a car stays at a floor it stopped at after moving
+    static const int DWELL_TICKS = 1;
+
+    int Slot(int floor, int car) const { return floor * numCars + car; }
+
+    void SetActive(int car, bool active) {
+        uint64_t bit = uint64_t(1) << (car & 63);
+        activeCars[car >> 6] = active ? (activeCars[car >> 6] | bit) : (activeCars[car >> 6] & ~bit);
+    }
+
+    // The first active car numbered 'from' or above; numCars if none
+    int NextActiveCar(int from) const {
+        size_t word = static_cast<size_t>(from) >> 6;
+        if (word >= activeCars.size()) {
+            return numCars;
+        }
+        uint64_t bits = activeCars[word] & (~uint64_t(0) << (from & 63));
+        while (bits == 0) {
+            if (++word == activeCars.size()) {
+                return numCars;
+            }
+            bits = activeCars[word];
+        }
+        return static_cast<int>(word * 64) + std::countr_zero(bits);
+    }
+
+    int Distance(int a, int b) const {
+        if constexpr (FIXED) {
+            static constexpr ECFloorDistanceTable<Floors> table;
+            return table.dist[a][b];
+        } else {
+            return a > b ? a - b : b - a;
+        }
+    }
+
+    void ResizeTables() {
+        if constexpr (!FIXED) {
+            size_t n = static_cast<size_t>(numSlots) * numCars;
+            waitHead.resize(n, -1);
+            rideHead.resize(n, -1);
+            callMask.resize(n, 0);
+            if (dispatchPolicy == EC_DISPATCH_ETA) {
+                eta.Resize(numSlots, numCars);
+            }
+        }
+    }
+
+    // Make sure 'floor' has a slot in the floor tables
+    void EnsureFloor(int floor) {
+        if (floor < 0) {
+            throw std::out_of_range("ECElevatorSimT: negative floor in request");
+        }
+        if (floor < numSlots) {
+            return;
+        }
+        if constexpr (FIXED) {
+            throw std::out_of_range("ECElevatorSimT: floor in request is above the building");
+        } else {
+            numSlots = floor + 1;
+            ResizeTables();
+        }
+    }
+
+    int AssignCar(int floorSrc, int floorDest) {
+        if (dispatchPolicy == EC_DISPATCH_ETA) {
+            for (int car = 0; car < numCars; car++) {
+                if (eta.IsDirty(car)) {
+                    eta.Rebuild(car, cars[car].floor, cars[car].dir,
+                                [this, car](int floor) { return callMask[Slot(floor, car)] != 0; });
+                }
+            }
+            return eta.BestCar(floorSrc, floorDest < floorSrc ? EC_ELEVATOR_DOWN : EC_ELEVATOR_UP);
+        }
+        int best = 0;
+        for (int car = 1; car < numCars; car++) {
+            if (Distance(cars[car].floor, floorSrc) < Distance(cars[best].floor, floorSrc)) {
+                best = car;
+            }
+        }
+        return best;
+    }
+
+    // True if the car had no call at the slot's floor before
+    bool Push(FloorTable<int32_t> &heads, int slot, int32_t request) {
+        nextLink[request] = heads[slot];
+        heads[slot] = request;
+        bool added = !callMask[slot];
+        callMask[slot] = 1;
+        return added;
+    }
+
+    // The listener is given a copy of the request: it may add requests, which can
+    // move listRequests
+    void Admit(int32_t index) {
+        const ECElevatorSimRequest request = listRequests[index];
+        if (request.IsServiced() || request.GetFloorSrc() == -1) {
+            return;
+        }
+        int floorSrc = request.GetFloorSrc();
+        int floorDest = request.GetFloorDest();
+        EnsureFloor(floorSrc);
+        if (floorDest != -1) {
+            EnsureFloor(floorDest);
+        }
+        int car = AssignCar(floorSrc, floorDest);
+        if (cars[car].parked) {
+            cars[car].parked = false;
+            SetActive(car, true);
+        }
+        bool stopAdded = false;
+        if (request.IsFloorRequestDone()) {
+            if (floorDest != -1) {
+                stopAdded = Push(rideHead, Slot(floorDest, car), index);
+            }
+        } else {
+            stopAdded = Push(waitHead, Slot(floorSrc, car), index);
+        }
+        // A rider going to floor -1 is never let off, so it is not counted as pending
+        numPending += floorDest != -1;
+        // Another call at a floor the car already stops at leaves its estimates as they are
+        if (dispatchPolicy == EC_DISPATCH_ETA && stopAdded) {
+            eta.MarkDirty(car);
+        }
+        if (listener) {
+            listener->OnRequestAdmitted(index, request, car, currTime);
+        }
+    }
+
+    // Board everyone waiting at the car's floor, then let off everyone going there
+    bool ServeFloor(int car, int time) {
+        int floor = cars[car].floor;
+        if (floor < 0 || floor >= numSlots) {
+            return false;
+        }
+        int slot = Slot(floor, car);
+        if (!callMask[slot]) {
+            return false;
+        }
+
+        int32_t index = waitHead[slot];
+        waitHead[slot] = -1;
+        while (index >= 0) {
+            int32_t next = nextLink[index];
+            listRequests[index].SetFloorRequestDone(true);
+            boardTime[index] = time;
+            const ECElevatorSimRequest request = listRequests[index];
+            if (request.GetFloorDest() != -1) {
+                Push(rideHead, Slot(request.GetFloorDest(), car), index);
+            }
+            if (listener) {
+                listener->OnRequestBoarded(index, request, car, time);
+            }
+            index = next;
+        }
+
+        index = rideHead[slot];
+        rideHead[slot] = -1;
+        while (index >= 0) {
+            int32_t next = nextLink[index];
+            listRequests[index].SetServiced(true);
+            listRequests[index].SetArriveTime(time);
+            numPending--;
+            if (listener) {
+                const ECElevatorSimRequest request = listRequests[index];
+                listener->OnRequestServiced(index, request, boardTime[index], car);
+            }
+            index = next;
+        }
+
+        // A request added by the listener for this floor waits for the next stop
+        callMask[slot] = waitHead[slot] >= 0 || rideHead[slot] >= 0;
+        if (dispatchPolicy == EC_DISPATCH_ETA) {
+            eta.MarkDirty(car);
+        }
+        return true;
+    }
+
+    // False if the car has no calls (it is then stopped)
+    bool MoveCar(int car) {
+        Car &c = cars[car];
+
+        // One pass over the floors for the nearest call at/above and at/below the car
+        ECFloorBounds bounds;
+        const int slots = FIXED ? Floors + 1 : numSlots;
+        for (int floor = 0; floor < slots; floor++) {
+            int32_t called = callMask[Slot(floor, car)];
+            bounds.minAbove = std::min<int32_t>(bounds.minAbove, (called && floor >= c.floor) ? floor : INT_MAX);
+            bounds.maxBelow = std::max<int32_t>(bounds.maxBelow, (called && floor <= c.floor) ? floor : INT_MIN);
+        }
+
+        int nextFloor = ECChooseNextFloor(bounds, c.dir, c.floor, numFloors);
+        if (nextFloor == -1) {
+            c.dir = EC_ELEVATOR_STOPPED;
+            c.moving = false;
+            return false;
+        }
+
+        if (!c.moving) {
+            if (nextFloor > c.floor) {
+                c.dir = EC_ELEVATOR_UP;
+            } else if (nextFloor < c.floor) {
+                c.dir = EC_ELEVATOR_DOWN;
+            }
+            c.moving = true;
+        }
+
+        if (c.dir == EC_ELEVATOR_UP) {
+            c.floor++;
+        } else if (c.dir == EC_ELEVATOR_DOWN) {
+            c.floor--;
+        }
+        return true;
+    }
+
+    int numFloors;
+    int numCars;
+    int numSlots;                               // floors 0..numSlots-1 have table entries
+    std::vector<ECElevatorSimRequest> &listRequests;
+    int currTime;
+
+    CarTable cars;
+    FloorTable<int32_t> waitHead;               // per (floor, car): first request waiting there
+    FloorTable<int32_t> rideHead;               // per (floor, car): first rider going there
+    FloorTable<uint8_t> callMask;               // per (floor, car): any of the two lists non-empty
+    std::vector<int32_t> nextLink;              // per request: next request on the same list
+    std::vector<int32_t> boardTime;             // per request: tick it was picked up, -1 until then
+    std::vector<uint8_t> cancelled;             // per request: withdrawn by CancelRequest
+    std::vector<int32_t> arrivalOrder;          // request indices sorted by time
+    size_t nextArrival;
+    std::vector<uint64_t> activeCars;           // bit per car: stepped this tick (not parked or dwelling)
+    ECTimingWheel<int32_t> timers;              // request index (AddRequest for a future time), or ~car (end of dwell)
+    std::vector<int32_t> dueArrivals;           // scratch for the requests due this tick
+    size_t numLateArrivals;
+    size_t numPending;                          // admitted and not serviced
+    ECSimListener *listener;
+    ECDispatchPolicy dispatchPolicy = EC_DISPATCH_NEAREST;
+    ECEtaTable eta;                             // EC_DISPATCH_ETA only
+};
+
+// Run-time sized version with the same API
+typedef ECElevatorSimT<EC_DYNAMIC_EXTENT, EC_DYNAMIC_EXTENT> ECElevatorSimGeneric;
+
+#endif /* ECElevatorSimFixed_h */
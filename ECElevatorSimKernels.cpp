@@ -0,0 +1,292 @@
+//
+//  ECElevatorSimKernels.cpp
+//
+//
+//  Vectorized request scanning kernels over ECElevatorRequestStore columns
+//
+
+#include "ECElevatorSimKernels.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define EC_KERNEL_AVX2 1
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define EC_KERNEL_SSE41 1
+#endif
+
+namespace {
+
+const int32_t DONE = ECElevatorRequestStore::FLOOR_REQ_DONE;
+const int32_t SERVICED = ECElevatorRequestStore::SERVICED;
+
+// Scalar loops over [first, last); the vector paths use them for the tail
+
+bool ProcessFloorRange(const int32_t *time, const int32_t *src, const int32_t *dest, int32_t *state, int32_t *timeArrive,
+                       size_t first, size_t last, int now, int floor) {
+    bool processed = false;
+    for (size_t i = first; i < last; i++) {
+        if (time[i] > now || (state[i] & SERVICED)) {
+            continue;
+        }
+        if (!(state[i] & DONE) && src[i] == floor) {
+            state[i] |= DONE;
+            processed = true;
+        }
+        if ((state[i] & DONE) && dest[i] == floor) {
+            state[i] |= SERVICED;
+            timeArrive[i] = now;
+            processed = true;
+        }
+    }
+    return processed;
+}
+
+void FloorBoundsRange(const int32_t *time, const int32_t *src, const int32_t *dest, const int32_t *state,
+                      size_t first, size_t last, int now, int floor, ECFloorBounds &bounds) {
+    for (size_t i = first; i < last; i++) {
+        if (time[i] > now || (state[i] & SERVICED)) {
+            continue;
+        }
+        int32_t target = (state[i] & DONE) ? dest[i] : src[i];
+        if (target == -1) {
+            continue;
+        }
+        if (target >= floor && target < bounds.minAbove) {
+            bounds.minAbove = target;
+        }
+        if (target <= floor && target > bounds.maxBelow) {
+            bounds.maxBelow = target;
+        }
+    }
+}
+
+} // namespace
+
+//*****************************************************************************
+// Scalar reference
+
+bool ECKernelProcessFloorScalar(ECElevatorRequestStore &store, int now, int floor) {
+    return ProcessFloorRange(store.GetTimes(), store.GetFloorSrcs(), store.GetFloorDests(), store.GetStates(),
+                             store.GetArriveTimes(), 0, store.Size(), now, floor);
+}
+
+ECFloorBounds ECKernelFloorBoundsScalar(const ECElevatorRequestStore &store, int now, int floor) {
+    ECFloorBounds bounds;
+    FloorBoundsRange(store.GetTimes(), store.GetFloorSrcs(), store.GetFloorDests(), store.GetStates(),
+                     0, store.Size(), now, floor, bounds);
+    return bounds;
+}
+
+//*****************************************************************************
+// AVX2: 8 requests per iteration
+
+#if defined(EC_KERNEL_AVX2)
+
+bool ECKernelProcessFloor(ECElevatorRequestStore &store, int now, int floor) {
+    const int32_t *time = store.GetTimes();
+    const int32_t *src = store.GetFloorSrcs();
+    const int32_t *dest = store.GetFloorDests();
+    int32_t *state = store.GetStates();
+    int32_t *timeArrive = store.GetArriveTimes();
+    size_t n = store.Size();
+
+    const __m256i vNow = _mm256_set1_epi32(now);
+    const __m256i vFloor = _mm256_set1_epi32(floor);
+    const __m256i vDone = _mm256_set1_epi32(DONE);
+    const __m256i vServiced = _mm256_set1_epi32(SERVICED);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i any = zero;
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(time + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(state + i));
+        __m256i late = _mm256_cmpgt_epi32(t, vNow);
+        __m256i serviced = _mm256_cmpeq_epi32(_mm256_and_si256(s, vServiced), vServiced);
+        __m256i active = _mm256_andnot_si256(_mm256_or_si256(late, serviced), _mm256_set1_epi32(-1));
+        if (_mm256_testz_si256(active, active)) {
+            continue;
+        }
+        __m256i done = _mm256_cmpeq_epi32(_mm256_and_si256(s, vDone), vDone);
+        __m256i atSrc = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), vFloor);
+        __m256i atDest = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(dest + i)), vFloor);
+
+        __m256i pick = _mm256_and_si256(_mm256_andnot_si256(done, active), atSrc);
+        __m256i drop = _mm256_and_si256(_mm256_and_si256(active, _mm256_or_si256(done, pick)), atDest);
+        __m256i changed = _mm256_or_si256(pick, drop);
+        if (_mm256_testz_si256(changed, changed)) {
+            continue;
+        }
+        any = _mm256_or_si256(any, changed);
+
+        s = _mm256_or_si256(s, _mm256_or_si256(_mm256_and_si256(pick, vDone), _mm256_and_si256(drop, vServiced)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(state + i), s);
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(timeArrive + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(timeArrive + i), _mm256_blendv_epi8(a, vNow, drop));
+    }
+    bool processed = !_mm256_testz_si256(any, any);
+    return ProcessFloorRange(time, src, dest, state, timeArrive, i, n, now, floor) || processed;
+}
+
+ECFloorBounds ECKernelFloorBounds(const ECElevatorRequestStore &store, int now, int floor) {
+    const int32_t *time = store.GetTimes();
+    const int32_t *src = store.GetFloorSrcs();
+    const int32_t *dest = store.GetFloorDests();
+    const int32_t *state = store.GetStates();
+    size_t n = store.Size();
+
+    const __m256i vNow = _mm256_set1_epi32(now);
+    const __m256i vFloorMinus1 = _mm256_set1_epi32(floor - 1);
+    const __m256i vFloorPlus1 = _mm256_set1_epi32(floor + 1);
+    const __m256i vDone = _mm256_set1_epi32(DONE);
+    const __m256i vServiced = _mm256_set1_epi32(SERVICED);
+    const __m256i vNone = _mm256_set1_epi32(-1);
+    const __m256i vMax = _mm256_set1_epi32(INT_MAX);
+    const __m256i vMin = _mm256_set1_epi32(INT_MIN);
+    __m256i minAbove = vMax;
+    __m256i maxBelow = vMin;
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(time + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(state + i));
+        __m256i done = _mm256_cmpeq_epi32(_mm256_and_si256(s, vDone), vDone);
+        __m256i target = _mm256_blendv_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)),
+                                            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dest + i)), done);
+        __m256i skip = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi32(t, vNow), _mm256_cmpeq_epi32(target, vNone)),
+                                       _mm256_cmpeq_epi32(_mm256_and_si256(s, vServiced), vServiced));
+        __m256i above = _mm256_andnot_si256(skip, _mm256_cmpgt_epi32(target, vFloorMinus1));
+        __m256i below = _mm256_andnot_si256(skip, _mm256_cmpgt_epi32(vFloorPlus1, target));
+        minAbove = _mm256_min_epi32(minAbove, _mm256_blendv_epi8(vMax, target, above));
+        maxBelow = _mm256_max_epi32(maxBelow, _mm256_blendv_epi8(vMin, target, below));
+    }
+
+    alignas(32) int32_t lanesMin[8], lanesMax[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanesMin), minAbove);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanesMax), maxBelow);
+    ECFloorBounds bounds;
+    for (int k = 0; k < 8; k++) {
+        bounds.minAbove = std::min(bounds.minAbove, lanesMin[k]);
+        bounds.maxBelow = std::max(bounds.maxBelow, lanesMax[k]);
+    }
+    FloorBoundsRange(time, src, dest, state, i, n, now, floor, bounds);
+    return bounds;
+}
+
+const char *ECKernelGetPathName() { return "avx2"; }
+
+//*****************************************************************************
+// SSE4.1: 4 requests per iteration
+
+#elif defined(EC_KERNEL_SSE41)
+
+bool ECKernelProcessFloor(ECElevatorRequestStore &store, int now, int floor) {
+    const int32_t *time = store.GetTimes();
+    const int32_t *src = store.GetFloorSrcs();
+    const int32_t *dest = store.GetFloorDests();
+    int32_t *state = store.GetStates();
+    int32_t *timeArrive = store.GetArriveTimes();
+    size_t n = store.Size();
+
+    const __m128i vNow = _mm_set1_epi32(now);
+    const __m128i vFloor = _mm_set1_epi32(floor);
+    const __m128i vDone = _mm_set1_epi32(DONE);
+    const __m128i vServiced = _mm_set1_epi32(SERVICED);
+    __m128i any = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(time + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + i));
+        __m128i late = _mm_cmpgt_epi32(t, vNow);
+        __m128i serviced = _mm_cmpeq_epi32(_mm_and_si128(s, vServiced), vServiced);
+        __m128i active = _mm_andnot_si128(_mm_or_si128(late, serviced), _mm_set1_epi32(-1));
+        if (_mm_testz_si128(active, active)) {
+            continue;
+        }
+        __m128i done = _mm_cmpeq_epi32(_mm_and_si128(s, vDone), vDone);
+        __m128i atSrc = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), vFloor);
+        __m128i atDest = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + i)), vFloor);
+
+        __m128i pick = _mm_and_si128(_mm_andnot_si128(done, active), atSrc);
+        __m128i drop = _mm_and_si128(_mm_and_si128(active, _mm_or_si128(done, pick)), atDest);
+        __m128i changed = _mm_or_si128(pick, drop);
+        if (_mm_testz_si128(changed, changed)) {
+            continue;
+        }
+        any = _mm_or_si128(any, changed);
+
+        s = _mm_or_si128(s, _mm_or_si128(_mm_and_si128(pick, vDone), _mm_and_si128(drop, vServiced)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(state + i), s);
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(timeArrive + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(timeArrive + i), _mm_blendv_epi8(a, vNow, drop));
+    }
+    bool processed = !_mm_testz_si128(any, any);
+    return ProcessFloorRange(time, src, dest, state, timeArrive, i, n, now, floor) || processed;
+}
+
+ECFloorBounds ECKernelFloorBounds(const ECElevatorRequestStore &store, int now, int floor) {
+    const int32_t *time = store.GetTimes();
+    const int32_t *src = store.GetFloorSrcs();
+    const int32_t *dest = store.GetFloorDests();
+    const int32_t *state = store.GetStates();
+    size_t n = store.Size();
+
+    const __m128i vNow = _mm_set1_epi32(now);
+    const __m128i vFloorMinus1 = _mm_set1_epi32(floor - 1);
+    const __m128i vFloorPlus1 = _mm_set1_epi32(floor + 1);
+    const __m128i vDone = _mm_set1_epi32(DONE);
+    const __m128i vServiced = _mm_set1_epi32(SERVICED);
+    const __m128i vNone = _mm_set1_epi32(-1);
+    const __m128i vMax = _mm_set1_epi32(INT_MAX);
+    const __m128i vMin = _mm_set1_epi32(INT_MIN);
+    __m128i minAbove = vMax;
+    __m128i maxBelow = vMin;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(time + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + i));
+        __m128i done = _mm_cmpeq_epi32(_mm_and_si128(s, vDone), vDone);
+        __m128i target = _mm_blendv_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + i)), done);
+        __m128i skip = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(t, vNow), _mm_cmpeq_epi32(target, vNone)),
+                                    _mm_cmpeq_epi32(_mm_and_si128(s, vServiced), vServiced));
+        __m128i above = _mm_andnot_si128(skip, _mm_cmpgt_epi32(target, vFloorMinus1));
+        __m128i below = _mm_andnot_si128(skip, _mm_cmpgt_epi32(vFloorPlus1, target));
+        minAbove = _mm_min_epi32(minAbove, _mm_blendv_epi8(vMax, target, above));
+        maxBelow = _mm_max_epi32(maxBelow, _mm_blendv_epi8(vMin, target, below));
+    }
+
+    alignas(16) int32_t lanesMin[4], lanesMax[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanesMin), minAbove);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanesMax), maxBelow);
+    ECFloorBounds bounds;
+    for (int k = 0; k < 4; k++) {
+        bounds.minAbove = std::min(bounds.minAbove, lanesMin[k]);
+        bounds.maxBelow = std::max(bounds.maxBelow, lanesMax[k]);
+    }
+    FloorBoundsRange(time, src, dest, state, i, n, now, floor, bounds);
+    return bounds;
+}
+
+const char *ECKernelGetPathName() { return "sse4.1"; }
+
+//*****************************************************************************
+// No vector unit available at compile time
+
+#else
+
+bool ECKernelProcessFloor(ECElevatorRequestStore &store, int now, int floor) {
+    return ECKernelProcessFloorScalar(store, now, floor);
+}
+
+ECFloorBounds ECKernelFloorBounds(const ECElevatorRequestStore &store, int now, int floor) {
+    return ECKernelFloorBoundsScalar(store, now, floor);
+}
+
+const char *ECKernelGetPathName() { return "scalar"; }
+
+#endif
@@ -0,0 +1,73 @@
+//
+//  ECElevatorSimKernels.h
+//
+//
+//  Vectorized request scanning kernels over ECElevatorRequestStore columns
+//
+
+#ifndef ECElevatorSimKernels_h
+#define ECElevatorSimKernels_h
+
+#include "ECElevatorRequestStore.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+//*****************************************************************************
+// The hot loops of ECElevatorSim, one function per predicate. Each kernel has an
+// AVX2 path, an SSE4.1 path and a scalar path; which vector path is used is decided
+// at compile time (__AVX2__ / __SSE4_1__). The Scalar variants are always available
+// and define the exact results the vector paths must reproduce.
+
+// Result of ECKernelFloorBounds: nearest requested floor at or above the car and
+// at or below the car; INT_MAX / INT_MIN when there is none.
+struct ECFloorBounds {
+    ECFloorBounds() : minAbove(INT_MAX), maxBelow(INT_MIN) {}
+    int32_t minAbove;
+    int32_t maxBelow;
+};
+
+// "Arrived and not serviced" at the car's floor: for every request with time <= now
+// that is not serviced yet, board it if it waits at 'floor', then let it off if it
+// is on board and goes to 'floor' (arrive time = now). Returns true if anything changed.
+bool ECKernelProcessFloor(ECElevatorRequestStore &store, int now, int floor);
+bool ECKernelProcessFloorScalar(ECElevatorRequestStore &store, int now, int floor);
+
+// "Requested floor in direction" plus the min/max reduction: over requests with
+// time <= now whose requested floor (GetRequestedFloor()) is not -1, the smallest
+// requested floor >= floor and the largest requested floor <= floor.
+ECFloorBounds ECKernelFloorBounds(const ECElevatorRequestStore &store, int now, int floor);
+ECFloorBounds ECKernelFloorBoundsScalar(const ECElevatorRequestStore &store, int now, int floor);
+
+// Next destination from the two bounds, with the same rules as ECElevatorSim:
+// keep going in the current direction if there is a requested floor that way,
+// otherwise take the closest one, preferring the floor above on a tie.
+// ECElevatorSim starts its closest search at distance numFloors + 1, so a floor
+// that far above still wins the tie while one that far below does not.
+// Returns -1 if there is nowhere to go.
+inline int ECChooseNextFloor(const ECFloorBounds &bounds, EC_ELEVATOR_DIR currDir, int currFloor, int numFloors) {
+    bool haveAbove = bounds.minAbove != INT_MAX;
+    bool haveBelow = bounds.maxBelow != INT_MIN;
+    if (currDir == EC_ELEVATOR_UP && haveAbove) {
+        return bounds.minAbove;
+    }
+    if (currDir == EC_ELEVATOR_DOWN && haveBelow) {
+        return bounds.maxBelow;
+    }
+
+    long long none = (long long)INT_MAX * 4;
+    long long distAbove = haveAbove ? (long long)bounds.minAbove - currFloor : none;
+    long long distBelow = haveBelow ? (long long)currFloor - bounds.maxBelow : none;
+    if (distAbove <= distBelow) {
+        return distAbove <= numFloors + 1 ? bounds.minAbove : -1;
+    }
+    if (distBelow <= numFloors) {
+        return bounds.maxBelow;
+    }
+    return -1;
+}
+
+// Name of the compiled-in vector path ("avx2", "sse4.1" or "scalar")
+const char *ECKernelGetPathName();
+
+#endif /* ECElevatorSimKernels_h */
@@ -0,0 +1,88 @@
+//
+//  ECElevatorSimSoA.h
+//
+//
+//  Elevator simulation over a structure-of-arrays request store
+//
+
+#ifndef ECElevatorSimSoA_h
+#define ECElevatorSimSoA_h
+
+#include "ECElevatorSim.h"
+#include "ECElevatorRequestStore.h"
+#include "ECElevatorSimKernels.h"
+
+//*****************************************************************************
+// Same policy and results as ECElevatorSim. The requests are copied into an
+// ECElevatorRequestStore at construction, every per-tick scan is one of the
+// kernels in ECElevatorSimKernels.h, and the results are written back into
+// listRequests when Simulate returns.
+//
+// The next destination only depends on the nearest requested floor above and
+// below the car, so the two scans of ECElevatorSim collapse into one reduction.
+
+class ECElevatorSimSoA : public ECElevatorSimBase {
+public:
+    ECElevatorSimSoA(int numFloors, std::vector<ECElevatorSimRequest> &listRequests)
+        : ECElevatorSimBase(numFloors, listRequests), store(listRequests), isMoving(false), waitTime(0) {}
+
+    void Simulate(int lenSim) {
+        for (int time = 0; time < lenSim; time++) {
+            ProcessFloorRequests(time);
+
+            if (waitTime > 0) {
+                waitTime--;
+                continue;
+            }
+
+            MoveElevator(time);
+        }
+        store.WriteBack(listRequests);
+    }
+
+    void ProcessFloorRequests(int time) override {
+        bool processedRequest = ECKernelProcessFloor(store, time, currFloor);
+
+        if (processedRequest && isMoving) {
+            waitTime = 1;
+            isMoving = false;
+        }
+    }
+
+    void MoveElevator(int time) override {
+        int nextFloor = GetNextDestination(time);
+        if (nextFloor == -1) {
+            currDir = EC_ELEVATOR_STOPPED;
+            isMoving = false;
+            return;
+        }
+
+        if (!isMoving) {
+            if (nextFloor > currFloor) {
+                currDir = EC_ELEVATOR_UP;
+            } else if (nextFloor < currFloor) {
+                currDir = EC_ELEVATOR_DOWN;
+            }
+            isMoving = true;
+        }
+
+        if (currDir == EC_ELEVATOR_UP) {
+            currFloor++;
+        } else if (currDir == EC_ELEVATOR_DOWN) {
+            currFloor--;
+        }
+    }
+
+    const ECElevatorRequestStore &GetStore() const { return store; }
+
+private:
+    ECElevatorRequestStore store;
+    bool isMoving;
+    int waitTime;
+
+    int GetNextDestination(int time) const {
+        return ECChooseNextFloor(ECKernelFloorBounds(store, time, currFloor), currDir, currFloor, numFloors);
+    }
+};
+
+#endif /* ECElevatorSimSoA_h */
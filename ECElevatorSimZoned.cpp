@@ -0,0 +1,277 @@
+//
+//  ECElevatorSimZoned.cpp
+//
+//
+//  Zoned building: one elevator bank per zone, sky-lobby transfers, one thread per zone
+//
+
+#include "ECElevatorSimZoned.h"
+#include "ECElevatorBench.h"
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+//*****************************************************************************
+// Zones
+
+class ECElevatorSimZoned::ZoneListener : public ECSimListener
+{
+public:
+    ZoneListener(ECElevatorSimZoned &owner, int zone) : owner(owner), zone(zone) {}
+
+    virtual void OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int, int) override {
+        owner.OnLegServiced(zone, index, request);
+    }
+
+private:
+    ECElevatorSimZoned &owner;
+    int zone;
+};
+
+struct ECElevatorSimZoned::Zone {
+    Zone(ECElevatorSimZoned &owner, int index, const ECZoneConfig &config) : config(config), listener(owner, index) {}
+
+    int Local(int floor) const { return floor - config.floorLow + 1; }
+    int Global(int floor) const { return floor + config.floorLow - 1; }
+    bool Contains(int floor) const { return floor >= config.floorLow && floor <= config.floorHigh; }
+
+    ECZoneConfig config;
+    std::vector<ECElevatorSimRequest> requests;     // legs ridden in this zone, in local floors
+    std::vector<int32_t> legPassenger;              // leg -> passenger
+    std::unique_ptr<ECElevatorSimGeneric> sim;
+    ZoneListener listener;
+    std::vector<std::vector<Transfer>> outbox;      // per zone handed to; read after the window
+    std::vector<Transfer> arrivals;                 // gathered from the other zones' outboxes
+};
+
+ECElevatorSimZoned::ECElevatorSimZoned(const vector<ECZoneConfig> &zoneConfigs, vector<ECElevatorSimRequest> &listRequests, int transferTime)
+    : listRequests(listRequests), numTransfers(listRequests.size(), 0), transferTime(transferTime), currTime(0) {
+    if (zoneConfigs.empty() || transferTime < 1) {
+        throw invalid_argument("ECElevatorSimZoned: need at least one zone and a transfer time of at least one tick");
+    }
+    for (size_t z = 0; z < zoneConfigs.size(); z++) {
+        const ECZoneConfig &config = zoneConfigs[z];
+        int expectedLow = z == 0 ? 1 : zoneConfigs[z - 1].floorHigh;
+        if (config.floorLow != expectedLow || config.floorHigh <= config.floorLow || config.numCars < 1) {
+            throw invalid_argument("ECElevatorSimZoned: zones must be stacked from floor 1, sharing their sky lobbies");
+        }
+        zones.push_back(make_unique<Zone>(*this, static_cast<int>(z), config));
+        zones.back()->outbox.resize(zoneConfigs.size());
+    }
+
+    // First legs go in each zone's initial request list; the rest are added as
+    // passengers reach the sky lobbies
+    int floorTop = zoneConfigs.back().floorHigh;
+    for (size_t i = 0; i < listRequests.size(); i++) {
+        const ECElevatorSimRequest &request = listRequests[i];
+        if (request.GetFloorSrc() < 1 || request.GetFloorSrc() > floorTop || request.GetFloorDest() < 1 || request.GetFloorDest() > floorTop) {
+            throw out_of_range("ECElevatorSimZoned: floor in request is outside the building");
+        }
+        AddLeg(FindZone(request.GetFloorSrc(), request.GetFloorDest()), request.GetTime(), static_cast<int32_t>(i), request.GetFloorSrc());
+    }
+    for (size_t z = 0; z < zones.size(); z++) {
+        Zone &zone = *zones[z];
+        zone.sim = make_unique<ECElevatorSimGeneric>(zone.Local(zone.config.floorHigh), zone.requests, zone.config.numCars);
+        zone.sim->SetListener(&zone.listener);
+    }
+}
+
+ECElevatorSimZoned::~ECElevatorSimZoned() {
+}
+
+int ECElevatorSimZoned::FindZone(int floor, int floorDest) const {
+    // The zone holding the whole trip, or else the one to leave 'floor' by
+    for (size_t z = 0; z < zones.size(); z++) {
+        if (zones[z]->Contains(floor) && zones[z]->Contains(floorDest)) {
+            return static_cast<int>(z);
+        }
+    }
+    for (size_t z = 0; z < zones.size(); z++) {
+        const ECZoneConfig &config = zones[z]->config;
+        if (floorDest > floor ? (floor >= config.floorLow && floor < config.floorHigh) : (floor > config.floorLow && floor <= config.floorHigh)) {
+            return static_cast<int>(z);
+        }
+    }
+    return 0;
+}
+
+void ECElevatorSimZoned::AddLeg(int z, int time, int32_t passenger, int floor) {
+    Zone &zone = *zones[z];
+    int floorDest = listRequests[passenger].GetFloorDest();
+    if (!zone.Contains(floorDest)) {
+        floorDest = floorDest > floor ? zone.config.floorHigh : zone.config.floorLow;
+    }
+    zone.legPassenger.push_back(passenger);
+    if (zone.sim) {
+        zone.sim->AddRequest(time, zone.Local(floor), zone.Local(floorDest));
+    } else {
+        zone.requests.push_back(ECElevatorSimRequest(time, zone.Local(floor), zone.Local(floorDest)));
+    }
+}
+
+void ECElevatorSimZoned::OnLegServiced(int z, int32_t index, const ECElevatorSimRequest &request) {
+    // Runs on the zone's thread; the passenger is in no other zone right now
+    Zone &zone = *zones[z];
+    int32_t passenger = zone.legPassenger[index];
+    ECElevatorSimRequest &trip = listRequests[passenger];
+    int floor = zone.Global(request.GetFloorDest());
+    if (floor == trip.GetFloorDest()) {
+        trip.SetFloorRequestDone(true);
+        trip.SetServiced(true);
+        trip.SetArriveTime(request.GetArriveTime());
+        return;
+    }
+    numTransfers[passenger]++;
+    Transfer transfer = {request.GetArriveTime() + transferTime, passenger, floor};
+    zone.outbox[FindZone(floor, trip.GetFloorDest())].push_back(transfer);
+}
+
+void ECElevatorSimZoned::RunWindow(int z, int windowEnd) {
+    zones[z]->sim->Simulate(windowEnd);
+}
+
+void ECElevatorSimZoned::Deliver(int z) {
+    Zone &zone = *zones[z];
+    zone.arrivals.clear();
+    for (unique_ptr<Zone> &from : zones) {
+        vector<Transfer> &box = from->outbox[z];
+        zone.arrivals.insert(zone.arrivals.end(), box.begin(), box.end());
+        box.clear();
+    }
+    // The same order whichever thread ran the sending zones
+    sort(zone.arrivals.begin(), zone.arrivals.end(), [](const Transfer &a, const Transfer &b) {
+        return a.time != b.time ? a.time < b.time : a.passenger < b.passenger;
+    });
+    for (const Transfer &transfer : zone.arrivals) {
+        AddLeg(z, transfer.time, transfer.passenger, transfer.floor);
+    }
+}
+
+void ECElevatorSimZoned::Simulate(int lenSim, int numThreads) {
+    const int numZones = static_cast<int>(zones.size());
+    numThreads = max(1, min(numThreads, numZones));
+
+    if (numThreads == 1) {
+        while (currTime < lenSim) {
+            int windowEnd = min(currTime + transferTime, lenSim);
+            for (int z = 0; z < numZones; z++) {
+                RunWindow(z, windowEnd);
+            }
+            for (int z = 0; z < numZones; z++) {
+                Deliver(z);
+            }
+            currTime = windowEnd;
+        }
+        return;
+    }
+
+    // Zone z runs on thread z % numThreads. Each window is two phases: run the
+    // zones, then deliver the transfers; the second barrier also moves the window.
+    int windowEnd = min(currTime + transferTime, lenSim);
+    exception_ptr error;
+    mutex errorLock;
+    atomic<bool> failed(false);
+    auto nextWindow = [&]() noexcept {
+        currTime = windowEnd;
+        windowEnd = min(currTime + transferTime, lenSim);
+    };
+    barrier windowRun(numThreads);
+    barrier windowDone(numThreads, nextWindow);
+
+    auto worker = [&](int thread) {
+        while (currTime < lenSim) {
+            for (int phase = 0; phase < 2; phase++) {
+                try {
+                    for (int z = thread; z < numZones && !failed.load(memory_order_relaxed); z += numThreads) {
+                        if (phase == 0) {
+                            RunWindow(z, windowEnd);
+                        } else {
+                            Deliver(z);
+                        }
+                    }
+                } catch (...) {
+                    // Keep arriving at the barriers so the other threads can finish
+                    lock_guard<mutex> lock(errorLock);
+                    if (!error) {
+                        error = current_exception();
+                    }
+                    failed = true;
+                }
+                if (phase == 0) {
+                    windowRun.arrive_and_wait();
+                } else {
+                    windowDone.arrive_and_wait();
+                }
+            }
+            if (failed) {
+                break;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 1; t < numThreads; t++) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (thread &t : threads) {
+        t.join();
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+int64_t ECElevatorSimZoned::GetNumTransfers() const {
+    int64_t total = 0;
+    for (int n : numTransfers) {
+        total += n;
+    }
+    return total;
+}
+
+//*****************************************************************************
+// Driver
+
+void ECRunZonedBenchmark(ostream &os, uint32_t seed) {
+    const vector<ECZoneConfig> tower = {{1, 30, 4}, {30, 60, 4}, {60, 90, 4}};
+    const int numFloors = 90;
+    const int numRequests = 60000;
+    const int lenRequests = 200000;
+    const int lenSim = lenRequests + 20000;
+    const vector<ECElevatorSimRequest> trace = ECMakeRandomTrace(seed, numFloors, numRequests, lenRequests);
+
+    os << numFloors << " floors in " << tower.size() << " zones, " << numRequests << " requests, " << lenSim << " ticks\n";
+    vector<ECElevatorSimRequest> reference;
+    for (int numThreads = 1; numThreads <= static_cast<int>(tower.size()); numThreads++) {
+        vector<ECElevatorSimRequest> result = trace;
+        auto start = chrono::steady_clock::now();
+        ECElevatorSimZoned sim(tower, result);
+        sim.Simulate(lenSim, numThreads);
+        auto stop = chrono::steady_clock::now();
+
+        int64_t numServiced = 0;
+        bool same = true;
+        for (size_t i = 0; i < result.size(); i++) {
+            numServiced += result[i].IsServiced();
+            if (numThreads > 1 && (result[i].IsServiced() != reference[i].IsServiced() || result[i].GetArriveTime() != reference[i].GetArriveTime())) {
+                same = false;
+            }
+        }
+        if (numThreads == 1) {
+            reference = result;
+        }
+        os << "  " << numThreads << (numThreads == 1 ? " thread:  " : " threads: ") << fixed << setprecision(1)
+           << setw(8) << chrono::duration<double, milli>(stop - start).count() << " ms, "
+           << numServiced << " delivered, " << sim.GetNumTransfers() << " transfers"
+           << (same ? "" : "  RESULTS DIFFER") << "\n";
+    }
+}
@@ -0,0 +1,92 @@
+//
+//  ECElevatorSimZoned.h
+//
+//
+//  Zoned building: one elevator bank per zone, sky-lobby transfers, one thread per zone
+//
+
+#ifndef ECElevatorSimZoned_h
+#define ECElevatorSimZoned_h
+
+#include "ECElevatorSimFixed.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+//*****************************************************************************
+// A zone is served by its own bank of cars. Zones are stacked: the first starts
+// at floor 1 and each next one starts at the floor where the previous one ends,
+// which is the sky lobby shared by both.
+
+struct ECZoneConfig {
+    int floorLow;
+    int floorHigh;
+    int numCars;
+};
+
+//*****************************************************************************
+// A passenger whose trip stays within one zone rides that zone's bank. Otherwise
+// it rides to the sky lobby at the edge of its zone in the direction of travel,
+// walks across it (transferTime ticks) and calls a car of the next zone, and so
+// on. Each bank is an ECElevatorSimGeneric.
+//
+// The zones run in parallel in windows of transferTime ticks. A passenger
+// leaving a zone during a window cannot reach the next zone before the window
+// ends, so each zone can run the window on its own. At the window boundary every
+// zone takes the passengers handed to it (one mailbox per pair of zones, each
+// written by one zone's thread and read by the other's after a barrier), sorted
+// by time and passenger. Results therefore do not depend on the number of threads.
+
+class ECElevatorSimZoned
+{
+public:
+    // listRequests holds whole trips in building floors; the arrive time of the
+    // last leg is written back to it. Throws std::invalid_argument if the zones are
+    // not stacked as described above or transferTime < 1, and std::out_of_range if
+    // a request has a floor outside the building.
+    ECElevatorSimZoned(const std::vector<ECZoneConfig> &zones, std::vector<ECElevatorSimRequest> &listRequests, int transferTime = 10);
+    ~ECElevatorSimZoned();
+
+    ECElevatorSimZoned(const ECElevatorSimZoned &) = delete;
+    ECElevatorSimZoned &operator=(const ECElevatorSimZoned &) = delete;
+
+    // Run until time lenSim with up to numThreads threads (at most one per zone;
+    // a later call continues where the last one stopped)
+    void Simulate(int lenSim, int numThreads = 1);
+
+    int GetTime() const { return currTime; }
+    size_t GetNumZones() const { return zones.size(); }
+    // Sky-lobby transfers made so far, in all and by one passenger
+    int64_t GetNumTransfers() const;
+    int GetNumTransfers(int passenger) const { return numTransfers[passenger]; }
+
+private:
+    struct Transfer {
+        int time;           // when the passenger calls a car in the next zone
+        int32_t passenger;
+        int floor;          // the sky lobby
+    };
+    struct Zone;
+    class ZoneListener;
+
+    int FindZone(int floor, int floorDest) const;
+    void AddLeg(int zone, int time, int32_t passenger, int floor);
+    void OnLegServiced(int zone, int32_t index, const ECElevatorSimRequest &request);
+    void RunWindow(int zone, int windowEnd);
+    void Deliver(int zone);
+
+    std::vector<std::unique_ptr<Zone>> zones;
+    std::vector<ECElevatorSimRequest> &listRequests;
+    std::vector<int> numTransfers;
+    int transferTime;
+    int currTime;
+};
+
+//*****************************************************************************
+// Driver (main's --zoned): a random trace on a three-zone tower, run with 1, 2
+// and 3 threads; prints the time of each and whether the results match
+
+void ECRunZonedBenchmark(std::ostream &os, uint32_t seed = 1);
+
+#endif /* ECElevatorSimZoned_h */
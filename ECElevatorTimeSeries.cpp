@@ -0,0 +1,161 @@
+//
+//  ECElevatorTimeSeries.cpp
+//
+//
+//  Fixed-memory multi-resolution time series of building state
+//
+
+#include "ECElevatorTimeSeries.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+//*****************************************************************************
+// ECTimeSeries
+
+vector<ECTimeResolution> ECTimeSeries::DefaultResolutions() {
+    return {{1, 3600}, {60, 1440}, {900, 672}};
+}
+
+ECTimeSeries::ECTimeSeries(const vector<ECTimeResolution> &resolutions) : lastTime(-1) {
+    for (const ECTimeResolution &resolution : resolutions) {
+        if (resolution.width < 1 || resolution.capacity < 1) {
+            throw invalid_argument("ECTimeSeries: bucket width and capacity must be at least 1");
+        }
+        Level level;
+        level.width = resolution.width;
+        level.ring.resize(resolution.capacity);
+        level.head = level.size = 0;
+        levels.push_back(level);
+    }
+}
+
+void ECTimeSeries::Clear() {
+    for (Level &level : levels) {
+        level.head = level.size = 0;
+        level.open = ECTimeBucket();
+    }
+    lastTime = -1;
+}
+
+void ECTimeSeries::Add(int time, double value) {
+    if (time < lastTime) {
+        throw invalid_argument("ECTimeSeries: sample at " + to_string(time) + " after one at " + to_string(lastTime));
+    }
+    lastTime = time;
+    float v = static_cast<float>(value);
+    for (Level &level : levels) {
+        int start = time - time % level.width;
+        ECTimeBucket &open = level.open;
+        if (open.count != 0 && open.start != start) {
+            // Close the open bucket, overwriting the oldest when the ring is full
+            size_t capacity = level.ring.size();
+            if (level.size < capacity) {
+                level.ring[(level.head + level.size) % capacity] = open;
+                level.size++;
+            } else {
+                level.ring[level.head] = open;
+                level.head = (level.head + 1) % capacity;
+            }
+            open.count = 0;
+        }
+        if (open.count == 0) {
+            open.start = start;
+            open.minValue = open.maxValue = v;
+            open.sum = 0;
+        } else {
+            open.minValue = min(open.minValue, v);
+            open.maxValue = max(open.maxValue, v);
+        }
+        open.count++;
+        open.sum += value;
+    }
+}
+
+size_t ECTimeSeries::GetNumBuckets(int level) const {
+    const Level &l = levels[level];
+    return l.size + (l.open.count != 0 ? 1 : 0);
+}
+
+const ECTimeBucket &ECTimeSeries::GetBucket(int level, size_t i) const {
+    const Level &l = levels[level];
+    return i < l.size ? l.ring[(l.head + i) % l.ring.size()] : l.open;
+}
+
+//*****************************************************************************
+// ECTimeSeriesRecorder
+
+ECTimeSeriesRecorder::ECTimeSeriesRecorder(int numFloors, int numCars, const vector<ECTimeResolution> &resolutions)
+    : numFloors(numFloors), queue(numFloors, 0), cars(numCars), numWaiting(0), numRiding(0),
+      queueSeries(numFloors, ECTimeSeries(resolutions)), loadSeries(numCars, ECTimeSeries(resolutions)),
+      utilSeries(numCars, ECTimeSeries(resolutions)), waitingSeries(resolutions), ridingSeries(resolutions) {}
+
+void ECTimeSeriesRecorder::OnRequestAdmitted(int32_t, const ECElevatorSimRequest &request, int car, int) {
+    if (request.IsFloorRequestDone()) {
+        cars[car].load++;
+        numRiding++;
+    } else {
+        if (IsFloor(request.GetFloorSrc())) {
+            queue[request.GetFloorSrc() - 1]++;
+        }
+        numWaiting++;
+    }
+}
+
+void ECTimeSeriesRecorder::OnRequestBoarded(int32_t, const ECElevatorSimRequest &request, int car, int) {
+    if (IsFloor(request.GetFloorSrc())) {
+        queue[request.GetFloorSrc() - 1]--;
+    }
+    numWaiting--;
+    cars[car].load++;
+    numRiding++;
+}
+
+void ECTimeSeriesRecorder::OnRequestServiced(int32_t, const ECElevatorSimRequest &, int, int car) {
+    cars[car].load--;
+    numRiding--;
+}
+
+void ECTimeSeriesRecorder::OnCarStopped(int car, int, int time) {
+    cars[car].lastStop = time;
+}
+
+void ECTimeSeriesRecorder::OnCarMoved(int car, int, EC_ELEVATOR_DIR dir, int) {
+    cars[car].dir = dir;
+}
+
+void ECTimeSeriesRecorder::OnTickEnd(int time) {
+    for (int floor = 0; floor < numFloors; floor++) {
+        queueSeries[floor].Add(time, queue[floor]);
+    }
+    for (size_t car = 0; car < cars.size(); car++) {
+        const CarState &c = cars[car];
+        loadSeries[car].Add(time, c.load);
+        utilSeries[car].Add(time, c.dir != EC_ELEVATOR_STOPPED || c.lastStop == time ? 1 : 0);
+    }
+    waitingSeries.Add(time, static_cast<double>(numWaiting));
+    ridingSeries.Add(time, static_cast<double>(numRiding));
+}
+
+void ECTimeSeriesRecorder::WriteCsv(ostream &os, int level) const {
+    auto writeSeries = [&](const string &name, const ECTimeSeries &series) {
+        int width = series.GetWidth(level);
+        for (size_t i = 0; i < series.GetNumBuckets(level); i++) {
+            const ECTimeBucket &b = series.GetBucket(level, i);
+            os << name << ',' << b.start << ',' << width << ',' << b.count << ',' << b.minValue << ','
+               << b.maxValue << ',' << b.GetMean() << '\n';
+        }
+    };
+    os << "series,start,width,count,min,max,mean\n";
+    writeSeries("waiting", waitingSeries);
+    writeSeries("riding", ridingSeries);
+    for (int floor = 1; floor <= numFloors; floor++) {
+        writeSeries("queue_floor" + to_string(floor), queueSeries[floor - 1]);
+    }
+    for (size_t car = 0; car < cars.size(); car++) {
+        writeSeries("load_car" + to_string(car), loadSeries[car]);
+        writeSeries("util_car" + to_string(car), utilSeries[car]);
+    }
+}
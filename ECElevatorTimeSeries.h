@@ -0,0 +1,130 @@
+//
+//  ECElevatorTimeSeries.h
+//
+//
+//  Fixed-memory multi-resolution time series of building state
+//
+
+#ifndef ECElevatorTimeSeries_h
+#define ECElevatorTimeSeries_h
+
+#include "ECElevatorSimFixed.h"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+//*****************************************************************************
+// One bucket: the samples taken in [start, start + width)
+
+struct ECTimeBucket {
+    int32_t start = 0;
+    uint32_t count = 0;
+    float minValue = 0;
+    float maxValue = 0;
+    double sum = 0;
+
+    double GetMean() const { return count ? sum / count : 0; }
+};
+
+struct ECTimeResolution {
+    int width;                  // ticks per bucket
+    int capacity;               // buckets kept; older ones are overwritten
+};
+
+//*****************************************************************************
+// A metric kept at several resolutions, each a ring buffer of buckets. A sample
+// updates the open bucket of every level (min, max, sum, count); when a sample
+// falls past a level's open bucket, that bucket is closed into the level's ring,
+// overwriting the oldest once the ring is full. Adding a sample is a few
+// compares per level, memory is fixed at construction, and every level can be
+// read at any time (the open bucket counts as the newest).
+//
+// Samples must come in non-decreasing time order (std::invalid_argument
+// otherwise); ticks without a sample leave no bucket.
+
+class ECTimeSeries
+{
+public:
+    // 1 s for an hour, 1 min for a day, 15 min for a week (a tick is a second)
+    static std::vector<ECTimeResolution> DefaultResolutions();
+
+    // Throws std::invalid_argument for a width or capacity below 1
+    explicit ECTimeSeries(const std::vector<ECTimeResolution> &resolutions = DefaultResolutions());
+
+    void Add(int time, double value);
+    void Clear();
+
+    int GetNumLevels() const { return static_cast<int>(levels.size()); }
+    int GetWidth(int level) const { return levels[level].width; }
+    // Buckets held at a level, oldest first; the last is the open one
+    size_t GetNumBuckets(int level) const;
+    const ECTimeBucket &GetBucket(int level, size_t i) const;
+    // Time of the last sample (-1 if none)
+    int GetLastTime() const { return lastTime; }
+
+private:
+    struct Level {
+        int width;
+        std::vector<ECTimeBucket> ring;
+        size_t head;            // oldest closed bucket
+        size_t size;            // closed buckets
+        ECTimeBucket open;
+    };
+
+    std::vector<Level> levels;
+    int lastTime;
+};
+
+//*****************************************************************************
+// Per-floor queue length, per-car load and per-car utilization (1 while the car
+// is moving or stopping, 0 while it is idle), plus the building-wide number
+// waiting and riding, sampled at the end of every tick. Set as the simulation's
+// ECSimListener.
+
+class ECTimeSeriesRecorder : public ECSimListener
+{
+public:
+    ECTimeSeriesRecorder(int numFloors, int numCars,
+                         const std::vector<ECTimeResolution> &resolutions = ECTimeSeries::DefaultResolutions());
+
+    virtual void OnRequestAdmitted(int32_t index, const ECElevatorSimRequest &request, int car, int time) override;
+    virtual void OnRequestBoarded(int32_t index, const ECElevatorSimRequest &request, int car, int time) override;
+    virtual void OnRequestServiced(int32_t index, const ECElevatorSimRequest &request, int boardTime, int car) override;
+    virtual void OnCarStopped(int car, int floor, int time) override;
+    virtual void OnCarMoved(int car, int floor, EC_ELEVATOR_DIR dir, int time) override;
+    virtual void OnTickEnd(int time) override;
+
+    int GetNumFloors() const { return numFloors; }
+    int GetNumCars() const { return static_cast<int>(cars.size()); }
+    const ECTimeSeries &GetQueueLength(int floor) const { return queueSeries[floor - 1]; }
+    const ECTimeSeries &GetCarLoad(int car) const { return loadSeries[car]; }
+    const ECTimeSeries &GetCarUtilization(int car) const { return utilSeries[car]; }
+    const ECTimeSeries &GetTotalWaiting() const { return waitingSeries; }
+    const ECTimeSeries &GetTotalRiding() const { return ridingSeries; }
+
+    // One row per series and bucket of the level: series,start,width,count,min,max,mean
+    void WriteCsv(std::ostream &os, int level) const;
+
+private:
+    struct CarState {
+        int load = 0;
+        EC_ELEVATOR_DIR dir = EC_ELEVATOR_STOPPED;
+        int lastStop = -1;      // last tick it stopped to serve a floor
+    };
+
+    bool IsFloor(int floor) const { return floor >= 1 && floor <= numFloors; }
+
+    int numFloors;
+    std::vector<int> queue;                     // per floor (index floor - 1)
+    std::vector<CarState> cars;
+    int64_t numWaiting;
+    int64_t numRiding;
+
+    std::vector<ECTimeSeries> queueSeries;
+    std::vector<ECTimeSeries> loadSeries;
+    std::vector<ECTimeSeries> utilSeries;
+    ECTimeSeries waitingSeries;
+    ECTimeSeries ridingSeries;
+};
+
+#endif /* ECElevatorTimeSeries_h */
@@ -0,0 +1,619 @@
+//
+//  ECElevatorTraceArchive.cpp
+//
+//
+//  Block-compressed trace files with a time index, for seeking and streaming
+//
+
+#include "ECElevatorTraceArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const char ARCHIVE_MAGIC[4] = {'E', 'C', 'T', 'Z'};
+const uint32_t ARCHIVE_VERSION = 1;
+const size_t HEADER_SIZE = 48;
+
+// The header after the magic
+struct ArchiveHeader {
+    uint32_t version;
+    int32_t numFloors;
+    int32_t lenSim;
+    uint32_t blockSize;
+    uint32_t numBlocks;
+    uint32_t reserved;
+    uint64_t numRequests;
+    uint64_t indexOffset;
+};
+static_assert(4 + sizeof(ArchiveHeader) <= HEADER_SIZE, "archive header does not fit");
+static_assert(sizeof(ECTraceBlockInfo) == 32, "block index entries are 32 bytes");
+
+//*****************************************************************************
+// Varint columns
+
+void PutVarint(vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool GetVarint(const uint8_t *&p, const uint8_t *end, uint32_t &value) {
+    // Most deltas fit in one byte
+    if (p != end && *p < 0x80) {
+        value = *p++;
+        return true;
+    }
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) {
+            return false;
+        }
+        uint8_t byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t ZigZag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+int32_t UnZigZag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+// FNV-1a taken 8 bytes at a time (the tail byte by byte), folded to 32 bits
+uint32_t Checksum(const uint8_t *data, size_t size) {
+    const uint64_t PRIME = 1099511628211ull;
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * PRIME;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * PRIME;
+    }
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+void EncodeBlock(const vector<ECCompactRequest> &requests, vector<uint8_t> &raw) {
+    raw.clear();
+    int prevTime = requests.front().GetTime();
+    for (const ECCompactRequest &request : requests) {
+        PutVarint(raw, static_cast<uint32_t>(request.GetTime() - prevTime));
+        prevTime = request.GetTime();
+    }
+    int prevSrc = 0;
+    for (const ECCompactRequest &request : requests) {
+        PutVarint(raw, ZigZag(request.GetFloorSrc() - prevSrc));
+        prevSrc = request.GetFloorSrc();
+    }
+    for (const ECCompactRequest &request : requests) {
+        PutVarint(raw, ZigZag(request.GetFloorDest() - request.GetFloorSrc()));
+    }
+}
+
+//*****************************************************************************
+// LZ coder (see the header for the layout)
+
+const int LZ_MIN_MATCH = 4;
+const int LZ_HASH_BITS = 14;
+const size_t LZ_MAX_DISTANCE = 65535;
+
+size_t LzBound(size_t size) { return size + size / 255 + 16; }
+
+uint32_t Read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t LzHash(uint32_t v) { return (v * 2654435761u) >> (32 - LZ_HASH_BITS); }
+
+uint8_t *PutLength(uint8_t *op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+uint8_t *PutSequence(uint8_t *op, const uint8_t *literals, size_t numLiterals, size_t distance, size_t matchLength) {
+    uint8_t *token = op++;
+    *token = static_cast<uint8_t>(min<size_t>(numLiterals, 15) << 4);
+    if (numLiterals >= 15) {
+        op = PutLength(op, numLiterals - 15);
+    }
+    memcpy(op, literals, numLiterals);
+    op += numLiterals;
+    if (matchLength == 0) {
+        return op;
+    }
+    *op++ = static_cast<uint8_t>(distance);
+    *op++ = static_cast<uint8_t>(distance >> 8);
+    size_t extra = matchLength - LZ_MIN_MATCH;
+    *token |= static_cast<uint8_t>(min<size_t>(extra, 15));
+    if (extra >= 15) {
+        op = PutLength(op, extra - 15);
+    }
+    return op;
+}
+
+// Greedy matching against the last position seen with the same 4-byte hash;
+// out must hold LzBound(size) bytes. Returns the compressed size.
+size_t LzCompress(const uint8_t *src, size_t size, uint8_t *out) {
+    vector<uint32_t> table(size_t(1) << LZ_HASH_BITS, 0);
+    uint8_t *op = out;
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + LZ_MIN_MATCH <= size) {
+        uint32_t seq = Read32(src + pos);
+        uint32_t &slot = table[LzHash(seq)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(pos);
+        if (candidate < pos && pos - candidate <= LZ_MAX_DISTANCE && Read32(src + candidate) == seq) {
+            size_t length = LZ_MIN_MATCH;
+            while (pos + length < size && src[candidate + length] == src[pos + length]) {
+                length++;
+            }
+            op = PutSequence(op, src + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+        } else {
+            // Step faster through data that does not match
+            pos += 1 + ((pos - anchor) >> 6);
+        }
+    }
+    op = PutSequence(op, src + anchor, size - anchor, 0, 0);
+    return op - out;
+}
+
+bool GetLength(const uint8_t *&ip, const uint8_t *end, size_t &length) {
+    uint8_t byte;
+    do {
+        if (ip == end) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// False if the input is not exactly rawSize bytes' worth of valid sequences
+bool LzDecompress(const uint8_t *src, size_t size, uint8_t *out, size_t rawSize) {
+    const uint8_t *ip = src;
+    const uint8_t *end = src + size;
+    uint8_t *op = out;
+    uint8_t *outEnd = out + rawSize;
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !GetLength(ip, end, numLiterals)) {
+            return false;
+        }
+        if (numLiterals > static_cast<size_t>(end - ip) || numLiterals > static_cast<size_t>(outEnd - op)) {
+            return false;
+        }
+        // Short runs (most of them) are copied 16 bytes at a time when there is room
+        // either side; the bytes past the run are overwritten later
+        if (numLiterals <= 16 && end - ip >= 16 && outEnd - op >= 16) {
+            memcpy(op, ip, 16);
+        } else {
+            memcpy(op, ip, numLiterals);
+        }
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t distance = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !GetLength(ip, end, length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (distance == 0 || distance > static_cast<size_t>(op - out) || length > static_cast<size_t>(outEnd - op)) {
+            return false;
+        }
+        const uint8_t *match = op - distance;
+        if (length <= 16 && distance >= 8 && outEnd - op >= 16) {
+            // 8 bytes at a time, so a match closer than 16 reads what the first copy wrote
+            memcpy(op, match, 8);
+            memcpy(op + 8, match + 8, 8);
+            op += length;
+        } else if (distance >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // Overlapping: the match repeats what it is writing
+            for (size_t i = 0; i < length; i++) {
+                *op++ = match[i];
+            }
+        }
+    }
+    return op == outEnd;
+}
+
+} // namespace
+
+//*****************************************************************************
+// ECTraceArchiveWriter
+
+ECTraceArchiveWriter::ECTraceArchiveWriter(const string &filename, int numFloors, int lenSim, int blockSizeIn)
+    : file(nullptr), numFloors(numFloors), lenSim(lenSim), blockSize(max(blockSizeIn, 1)), offset(HEADER_SIZE),
+      numRequests(0), rawBytes(0), storedBytes(0), failed(false), closed(false) {
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        throw runtime_error("ECTraceArchiveWriter: cannot create " + filename);
+    }
+    pending.reserve(blockSize);
+    // The header is written for real by Close, once the index is
+    uint8_t zeros[HEADER_SIZE] = {};
+    if (fwrite(zeros, 1, sizeof(zeros), file) != sizeof(zeros)) {
+        fclose(file);
+        throw runtime_error("ECTraceArchiveWriter: cannot write " + filename);
+    }
+}
+
+ECTraceArchiveWriter::~ECTraceArchiveWriter() {
+    try {
+        Finish();
+    }
+    catch (const exception &) {
+    }
+}
+
+void ECTraceArchiveWriter::Add(int time, int floorSrc, int floorDest) {
+    int lastTime = !pending.empty() ? pending.back().GetTime() : !index.empty() ? index.back().lastTime : time;
+    if (time < lastTime) {
+        throw invalid_argument("ECTraceArchiveWriter: requests must be added in order of time");
+    }
+    pending.push_back(ECCompactRequest(time, floorSrc, floorDest));
+    numRequests++;
+    if (pending.size() >= static_cast<size_t>(blockSize)) {
+        FlushBlock();
+    }
+}
+
+void ECTraceArchiveWriter::FlushBlock() {
+    if (pending.empty()) {
+        return;
+    }
+    EncodeBlock(pending, raw);
+    packed.resize(LzBound(raw.size()));
+    size_t packedSize = LzCompress(raw.data(), raw.size(), packed.data());
+    bool compressed = packedSize < raw.size();
+
+    ECTraceBlockInfo info;
+    info.offset = offset;
+    info.storedSize = static_cast<uint32_t>(compressed ? packedSize : raw.size());
+    info.rawSize = static_cast<uint32_t>(raw.size());
+    info.numRequests = static_cast<uint32_t>(pending.size());
+    info.firstTime = pending.front().GetTime();
+    info.lastTime = pending.back().GetTime();
+    info.checksum = Checksum(raw.data(), raw.size());
+    Write(compressed ? packed.data() : raw.data(), info.storedSize);
+    index.push_back(info);
+
+    offset += info.storedSize;
+    rawBytes += info.rawSize;
+    storedBytes += info.storedSize;
+    pending.clear();
+}
+
+void ECTraceArchiveWriter::Write(const void *bytes, size_t count) {
+    if (count > 0 && fwrite(bytes, 1, count, file) != count) {
+        failed = true;
+        throw runtime_error("ECTraceArchiveWriter: write failed");
+    }
+}
+
+void ECTraceArchiveWriter::Finish() {
+    if (closed) {
+        return;
+    }
+    closed = true;
+
+    try {
+        FlushBlock();
+        uint8_t zeros[alignof(ECTraceBlockInfo)] = {};
+        size_t padding = (alignof(ECTraceBlockInfo) - offset % alignof(ECTraceBlockInfo)) % alignof(ECTraceBlockInfo);
+        Write(zeros, padding);
+        uint64_t indexOffset = offset + padding;
+        Write(index.data(), index.size() * sizeof(ECTraceBlockInfo));
+
+        ArchiveHeader header = {};
+        header.version = ARCHIVE_VERSION;
+        header.numFloors = numFloors;
+        header.lenSim = lenSim;
+        header.blockSize = static_cast<uint32_t>(blockSize);
+        header.numBlocks = static_cast<uint32_t>(index.size());
+        header.numRequests = numRequests;
+        header.indexOffset = indexOffset;
+        if (fseek(file, 0, SEEK_SET) != 0) {
+            failed = true;
+        } else {
+            Write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+            Write(&header, sizeof(header));
+        }
+    }
+    catch (const exception &) {
+        failed = true;
+    }
+    if (fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+}
+
+void ECTraceArchiveWriter::Close() {
+    Finish();
+    if (failed) {
+        throw runtime_error("ECTraceArchiveWriter: write failed");
+    }
+}
+
+//*****************************************************************************
+// ECTraceArchive
+
+bool ECTraceArchive::Open(const string &filename) {
+    Close();
+    if (!mapping.Open(filename) || mapping.GetSize() < HEADER_SIZE) {
+        mapping.Close();
+        return false;
+    }
+    data = mapping.GetData();
+    size = mapping.GetSize();
+
+    ArchiveHeader header;
+    memcpy(&header, data + 4, sizeof(header));
+    if (memcmp(data, ARCHIVE_MAGIC, 4) != 0 || header.version != ARCHIVE_VERSION || header.indexOffset < HEADER_SIZE ||
+        header.indexOffset > size || header.indexOffset % alignof(ECTraceBlockInfo) != 0 ||
+        (size - header.indexOffset) / sizeof(ECTraceBlockInfo) < header.numBlocks) {
+        Close();
+        return false;
+    }
+    numFloors = header.numFloors;
+    lenSim = header.lenSim;
+    blockSize = static_cast<int>(header.blockSize);
+    numRequests = header.numRequests;
+    numBlocks = header.numBlocks;
+    blocks = reinterpret_cast<const ECTraceBlockInfo *>(data + header.indexOffset);
+
+    // Every block in the data section, in order of time, adding up to the request count
+    uint64_t total = 0;
+    for (size_t b = 0; b < numBlocks; b++) {
+        const ECTraceBlockInfo &info = blocks[b];
+        if (info.offset < HEADER_SIZE || info.offset > header.indexOffset || info.storedSize > header.indexOffset - info.offset ||
+            info.storedSize > info.rawSize || info.numRequests == 0 || info.numRequests > header.blockSize ||
+            info.rawSize < 3ull * info.numRequests || info.rawSize > 15ull * info.numRequests || info.firstTime > info.lastTime ||
+            (b > 0 && info.firstTime < blocks[b - 1].lastTime)) {
+            Close();
+            return false;
+        }
+        total += info.numRequests;
+    }
+    if (total != numRequests) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ECTraceArchive::Close() {
+    mapping.Close();
+    data = nullptr;
+    size = 0;
+    blocks = nullptr;
+    numBlocks = 0;
+    numRequests = 0;
+}
+
+size_t ECTraceArchive::FindBlock(int time) const {
+    return partition_point(blocks, blocks + numBlocks, [time](const ECTraceBlockInfo &info) { return info.lastTime < time; }) - blocks;
+}
+
+void ECTraceArchive::DecodeBlock(size_t block, ECCompactRequest *out, vector<uint8_t> &scratch) const {
+    const ECTraceBlockInfo &info = blocks[block];
+    const uint8_t *raw = data + info.offset;
+    if (info.storedSize != info.rawSize) {
+        scratch.resize(info.rawSize);
+        if (!LzDecompress(raw, info.storedSize, scratch.data(), info.rawSize)) {
+            throw runtime_error("ECTraceArchive: block " + to_string(block) + " does not decompress");
+        }
+        raw = scratch.data();
+    }
+    if (Checksum(raw, info.rawSize) != info.checksum) {
+        throw runtime_error("ECTraceArchive: block " + to_string(block) + " fails its checksum");
+    }
+
+    // One pass per column; the record holds what the later columns need
+    const uint8_t *p = raw;
+    const uint8_t *end = raw + info.rawSize;
+    const uint32_t n = info.numRequests;
+    uint32_t value;
+    int time = info.firstTime;
+    for (uint32_t i = 0; i < n; i++) {
+        if (!GetVarint(p, end, value)) {
+            throw runtime_error("ECTraceArchive: block " + to_string(block) + " is truncated");
+        }
+        time += static_cast<int>(value);
+        out[i] = ECCompactRequest(time, 0, 0);
+    }
+    int floorSrc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (!GetVarint(p, end, value)) {
+            throw runtime_error("ECTraceArchive: block " + to_string(block) + " is truncated");
+        }
+        floorSrc += UnZigZag(value);
+        out[i] = ECCompactRequest(out[i].GetTime(), floorSrc, 0);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (!GetVarint(p, end, value)) {
+            throw runtime_error("ECTraceArchive: block " + to_string(block) + " is truncated");
+        }
+        out[i] = ECCompactRequest(out[i].GetTime(), out[i].GetFloorSrc(), out[i].GetFloorSrc() + UnZigZag(value));
+    }
+}
+
+void ECTraceArchive::Read(int beginTime, int endTime, vector<ECCompactRequest> &out, int numThreads) const {
+    out.clear();
+    size_t first = FindBlock(beginTime);
+    size_t last = partition_point(blocks + first, blocks + numBlocks,
+                                  [endTime](const ECTraceBlockInfo &info) { return info.firstTime < endTime; }) - blocks;
+    if (first >= last) {
+        return;
+    }
+
+    // Each block's place in the output is known from the index, so the threads
+    // write straight into it
+    vector<size_t> start(last - first + 1, 0);
+    for (size_t b = first; b < last; b++) {
+        start[b - first + 1] = start[b - first] + blocks[b].numRequests;
+    }
+    out.resize(start.back());
+
+    size_t threads = numThreads > 0 ? numThreads : max(1u, thread::hardware_concurrency());
+    threads = min(threads, last - first);
+    vector<exception_ptr> errors(threads);
+    auto decode = [&](size_t t) {
+        try {
+            vector<uint8_t> scratch;
+            for (size_t b = first + t; b < last; b += threads) {
+                DecodeBlock(b, out.data() + start[b - first], scratch);
+            }
+        }
+        catch (...) {
+            errors[t] = current_exception();
+        }
+    };
+    vector<thread> workers;
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back(decode, t);
+    }
+    decode(0);
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    for (const exception_ptr &error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    // The first and last blocks may reach outside the window
+    auto byTime = [](const ECCompactRequest &request, int time) { return request.GetTime() < time; };
+    out.erase(lower_bound(out.begin(), out.end(), endTime, byTime), out.end());
+    out.erase(out.begin(), lower_bound(out.begin(), out.end(), beginTime, byTime));
+}
+
+bool ECIsTraceArchive(const string &filename) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[4];
+    bool isArchive = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, ARCHIVE_MAGIC, 4) == 0;
+    fclose(file);
+    return isArchive;
+}
+
+//*****************************************************************************
+// ECTraceArchiveStream
+
+ECTraceArchiveStream::ECTraceArchiveStream(const ECTraceArchive &archive, int beginTime, size_t lookahead)
+    : archive(archive), beginTime(beginTime), lookahead(max<size_t>(lookahead, 1)), nextBlock(archive.FindBlock(beginTime)),
+      done(false), stopping(false), worker(&ECTraceArchiveStream::Run, this) {
+    // At most lookahead + 2 blocks' storage exists at once (ready, the reader's and
+    // the one being decoded), so handing one back to spare never allocates
+    lock_guard<std::mutex> lock(mutex);
+    spare.reserve(this->lookahead + 2);
+}
+
+ECTraceArchiveStream::~ECTraceArchiveStream() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    spaceChanged.notify_all();
+    worker.join();
+}
+
+bool ECTraceArchiveStream::Next(vector<ECCompactRequest> &block) {
+    unique_lock<std::mutex> lock(mutex);
+    readyChanged.wait(lock, [this] { return !ready.empty() || done; });
+    if (ready.empty()) {
+        if (error) {
+            rethrow_exception(error);
+        }
+        return false;
+    }
+    if (block.capacity() > 0) {
+        block.clear();
+        spare.push_back(std::move(block));
+    }
+    block = std::move(ready.front());
+    ready.pop_front();
+    lock.unlock();
+    spaceChanged.notify_one();
+    return true;
+}
+
+size_t ECTraceArchiveStream::GetNumReady() const {
+    lock_guard<std::mutex> lock(mutex);
+    return ready.size();
+}
+
+void ECTraceArchiveStream::Run() {
+    try {
+        vector<uint8_t> scratch;
+        for (; nextBlock < archive.GetNumBlocks(); nextBlock++) {
+            vector<ECCompactRequest> block;
+            {
+                unique_lock<std::mutex> lock(mutex);
+                spaceChanged.wait(lock, [this] { return stopping || ready.size() < lookahead; });
+                if (stopping) {
+                    return;
+                }
+                if (!spare.empty()) {
+                    block.swap(spare.back());
+                    spare.pop_back();
+                }
+            }
+            block.resize(archive.GetBlock(nextBlock).numRequests);
+            archive.DecodeBlock(nextBlock, block.data(), scratch);
+            if (block.front().GetTime() < beginTime) {
+                block.erase(block.begin(), lower_bound(block.begin(), block.end(), beginTime,
+                                                       [](const ECCompactRequest &request, int time) { return request.GetTime() < time; }));
+            }
+            {
+                lock_guard<std::mutex> lock(mutex);
+                ready.push_back(std::move(block));
+            }
+            readyChanged.notify_one();
+        }
+    }
+    catch (...) {
+        lock_guard<std::mutex> lock(mutex);
+        error = current_exception();
+    }
+    {
+        lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    readyChanged.notify_one();
+}
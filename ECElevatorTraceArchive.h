@@ -0,0 +1,194 @@
+//
+//  ECElevatorTraceArchive.h
+//
+//
+//  Block-compressed trace files with a time index, for seeking and streaming
+//
+
+#ifndef ECElevatorTraceArchive_h
+#define ECElevatorTraceArchive_h
+
+#include "ECElevatorRequestArena.h"
+#include "ECMappedFile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Archive format (native byte order)
+//
+// Header (48 bytes): "ECTZ", uint32 version (1), int32 numFloors, int32 lenSim,
+//   uint32 block size (requests per block), uint32 number of blocks,
+//   uint64 number of requests, uint64 offset of the index, padded with zeros.
+// Blocks: requests in order of time, blockSize to a block (the last may have
+//   fewer). A block is three columns of LEB128 varints: the time minus the
+//   previous request's (the block's first time for the first), the source floor
+//   minus the previous request's (zigzag, 0 before the first), and the
+//   destination minus the source (zigzag). The columns are then compressed with
+//   the LZ coder below, or stored as they are if that does not make them smaller.
+// Index (8-byte aligned, after zero padding): one ECTraceBlockInfo per block,
+//   in order.
+//
+// LZ coder: sequences of a token byte (literal count in the high nibble, match
+// length - 4 in the low one; 15 means more follows as bytes of 255 and a last
+// byte below 255), the literals, then a 2-byte little-endian match distance.
+// The last sequence is literals only. It is LZ4's block layout; it favours
+// decode speed over ratio, and the varint columns are what make it pay off.
+
+struct ECTraceBlockInfo {
+    uint64_t offset;            // of the block's bytes in the file
+    uint32_t storedSize;        // bytes in the file
+    uint32_t rawSize;           // bytes of varint columns (equal to storedSize: not compressed)
+    uint32_t numRequests;
+    int32_t firstTime;
+    int32_t lastTime;
+    uint32_t checksum;          // of the varint columns (FNV-1a over 64-bit words)
+};
+
+//*****************************************************************************
+// Writes an archive, one block at a time. Requests must come in order of time.
+
+class ECTraceArchiveWriter
+{
+public:
+    static const int DEFAULT_BLOCK_SIZE = 16384;
+
+    // Throws std::runtime_error if the file cannot be created
+    ECTraceArchiveWriter(const std::string &filename, int numFloors, int lenSim, int blockSize = DEFAULT_BLOCK_SIZE);
+    // Calls Close(), ignoring write errors
+    ~ECTraceArchiveWriter();
+
+    ECTraceArchiveWriter(const ECTraceArchiveWriter &) = delete;
+    ECTraceArchiveWriter &operator=(const ECTraceArchiveWriter &) = delete;
+
+    // Throws std::invalid_argument for a request earlier than the last one, and
+    // std::runtime_error if a full block cannot be written
+    void Add(int time, int floorSrc, int floorDest);
+    // Write the last block, the index and the header; throws std::runtime_error if any write failed
+    void Close();
+
+    uint64_t GetNumRequests() const { return numRequests; }
+    size_t GetNumBlocks() const { return index.size(); }
+    // Bytes of varint columns so far, and what they took in the file
+    uint64_t GetRawBytes() const { return rawBytes; }
+    uint64_t GetStoredBytes() const { return storedBytes; }
+
+private:
+    void FlushBlock();
+    void Write(const void *data, size_t size);
+    void Finish();
+
+    FILE *file;
+    int numFloors;
+    int lenSim;
+    int blockSize;
+    std::vector<ECCompactRequest> pending;      // the block being filled
+    std::vector<uint8_t> raw;                   // scratch for encoding
+    std::vector<uint8_t> packed;
+    std::vector<ECTraceBlockInfo> index;
+    uint64_t offset;
+    uint64_t numRequests;
+    uint64_t rawBytes;
+    uint64_t storedBytes;
+    bool failed;
+    bool closed;
+};
+
+//*****************************************************************************
+// An archive mapped into memory. Blocks decode independently, so any number of
+// threads may decode from one archive at once.
+
+class ECTraceArchive
+{
+public:
+    ECTraceArchive() : data(nullptr), size(0), numFloors(0), lenSim(0), blockSize(0), numRequests(0), blocks(nullptr), numBlocks(0) {}
+    ~ECTraceArchive() { Close(); }
+
+    ECTraceArchive(const ECTraceArchive &) = delete;
+    ECTraceArchive &operator=(const ECTraceArchive &) = delete;
+
+    // False if the file cannot be mapped or is not a (finished) archive
+    bool Open(const std::string &filename);
+    void Close();
+
+    int GetNumFloors() const { return numFloors; }
+    int GetLenSim() const { return lenSim; }
+    uint64_t GetNumRequests() const { return numRequests; }
+    size_t GetNumBlocks() const { return numBlocks; }
+    const ECTraceBlockInfo &GetBlock(size_t block) const { return blocks[block]; }
+
+    // The first block that may hold a request at 'time' or later (GetNumBlocks() if none)
+    size_t FindBlock(int time) const;
+
+    // Decode one block into out[0 .. numRequests); scratch is reused between calls.
+    // Throws std::runtime_error if the block is corrupt.
+    void DecodeBlock(size_t block, ECCompactRequest *out, std::vector<uint8_t> &scratch) const;
+
+    // Requests with a time in [beginTime, endTime), in order, decoded by numThreads
+    // threads (0: one per core) each taking a share of the blocks
+    void Read(int beginTime, int endTime, std::vector<ECCompactRequest> &out, int numThreads = 0) const;
+
+private:
+    ECMappedFile mapping;
+    const uint8_t *data;                        // the mapping's bytes
+    size_t size;
+    int numFloors;
+    int lenSim;
+    int blockSize;
+    uint64_t numRequests;
+    const ECTraceBlockInfo *blocks;
+    size_t numBlocks;
+};
+
+// True if the file starts like an archive (so it is not a text trace)
+bool ECIsTraceArchive(const std::string &filename);
+
+//*****************************************************************************
+// Decodes an archive's blocks in order on a background thread, staying up to
+// 'lookahead' blocks ahead of the reader, so a consumer going through the trace
+// in time order (the viewer, a simulation) rarely waits for a block.
+
+class ECTraceArchiveStream
+{
+public:
+    // Blocks from the one holding beginTime on; requests before beginTime are left out
+    ECTraceArchiveStream(const ECTraceArchive &archive, int beginTime = 0, size_t lookahead = 4);
+    // Stops the decoder thread
+    ~ECTraceArchiveStream();
+
+    ECTraceArchiveStream(const ECTraceArchiveStream &) = delete;
+    ECTraceArchiveStream &operator=(const ECTraceArchiveStream &) = delete;
+
+    // Swap the next block's requests into 'block' (its old storage is reused for a
+    // later block), waiting if it is not decoded yet. False after the last block.
+    // Rethrows an error from decoding.
+    bool Next(std::vector<ECCompactRequest> &block);
+
+    // Blocks decoded and not taken yet
+    size_t GetNumReady() const;
+
+private:
+    void Run();
+
+    const ECTraceArchive &archive;
+    int beginTime;
+    size_t lookahead;
+    size_t nextBlock;                           // decoder thread only
+    mutable std::mutex mutex;
+    std::condition_variable readyChanged;       // a block was decoded, or the decoder stopped
+    std::condition_variable spaceChanged;       // a block was taken, or the stream is closing
+    std::deque<std::vector<ECCompactRequest>> ready;
+    std::vector<std::vector<ECCompactRequest>> spare;   // storage handed back by Next
+    std::exception_ptr error;
+    bool done;                                  // the decoder has no more blocks
+    bool stopping;
+    std::thread worker;                         // last: started once the rest is set up
+};
+
+#endif /* ECElevatorTraceArchive_h */
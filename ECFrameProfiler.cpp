@@ -0,0 +1,95 @@
+//
+//  ECFrameProfiler.cpp
+//
+//
+//  Per-frame phase timings for the viewer, over a rolling window of frames
+//
+
+#include "ECFrameProfiler.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+ECFrameProfiler::ECFrameProfiler() : head(0), numFrames(0), numFramesTotal(0), log(nullptr) {}
+
+void ECFrameProfiler::EndFrame(double frameUs) {
+    current.frameUs = static_cast<float>(frameUs);
+    if (numFrames < WINDOW) {
+        frames[(head + numFrames) % WINDOW] = current;
+        numFrames++;
+    } else {
+        frames[head] = current;
+        head = (head + 1) % WINDOW;
+    }
+    if (log) {
+        fprintf(log, "%lld,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u,%u\n", static_cast<long long>(numFramesTotal),
+                current.phaseUs[EC_FRAME_WAIT], current.phaseUs[EC_FRAME_UPDATE], current.phaseUs[EC_FRAME_DRAW],
+                current.phaseUs[EC_FRAME_FLIP], current.phaseUs[EC_FRAME_OVERLAY], current.frameUs,
+                current.numPrimitives, current.numOverlayPrimitives, current.simTicks);
+    }
+    numFramesTotal++;
+    current = ECFrameStats();
+}
+
+bool ECFrameProfiler::OpenLog(const string &filename) {
+    CloseLog();
+    log = fopen(filename.c_str(), "w");
+    if (!log) {
+        return false;
+    }
+    fprintf(log, "frame,wait_us,update_us,draw_us,flip_us,overlay_us,frame_us,primitives,overlay_primitives,sim_ticks\n");
+    return true;
+}
+
+void ECFrameProfiler::CloseLog() {
+    if (log) {
+        fclose(log);
+        log = nullptr;
+    }
+}
+
+double ECFrameProfiler::GetFrameTimePercentile(double q) const {
+    if (numFrames == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < numFrames; i++) {
+        scratch[i] = GetFrame(i).frameUs;
+    }
+    size_t rank = min(numFrames - 1, static_cast<size_t>(ceil(max(q, 0.0) * numFrames)) - (q > 0 ? 1 : 0));
+    nth_element(scratch.begin(), scratch.begin() + rank, scratch.begin() + numFrames);
+    return scratch[rank];
+}
+
+double ECFrameProfiler::GetMeanPhaseTime(ECFramePhase phase) const {
+    double sum = 0;
+    for (size_t i = 0; i < numFrames; i++) {
+        sum += GetFrame(i).phaseUs[phase];
+    }
+    return numFrames ? sum / numFrames : 0;
+}
+
+double ECFrameProfiler::GetMeanPrimitives() const {
+    double sum = 0;
+    for (size_t i = 0; i < numFrames; i++) {
+        sum += GetFrame(i).numPrimitives;
+    }
+    return numFrames ? sum / numFrames : 0;
+}
+
+double ECFrameProfiler::GetMeanOverlayPrimitives() const {
+    double sum = 0;
+    for (size_t i = 0; i < numFrames; i++) {
+        sum += GetFrame(i).numOverlayPrimitives;
+    }
+    return numFrames ? sum / numFrames : 0;
+}
+
+double ECFrameProfiler::GetSimTicksPerSecond() const {
+    double ticks = 0, us = 0;
+    for (size_t i = 0; i < numFrames; i++) {
+        ticks += GetFrame(i).simTicks;
+        us += GetFrame(i).frameUs;
+    }
+    return us > 0 ? ticks * 1e6 / us : 0;
+}
@@ -0,0 +1,90 @@
+//
+//  ECFrameProfiler.h
+//
+//
+//  Per-frame phase timings for the viewer, over a rolling window of frames
+//
+
+#ifndef ECFrameProfiler_h
+#define ECFrameProfiler_h
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+//*****************************************************************************
+// Phases of one frame of ECGraphicViewImp::Show()
+
+enum ECFramePhase
+{
+    EC_FRAME_WAIT = 0,          // waiting for events (mostly the timer)
+    EC_FRAME_UPDATE,            // notifying observers, minus the time they spent drawing
+    EC_FRAME_DRAW,              // clearing and submitting primitives
+    EC_FRAME_FLIP,              // al_flip_display (includes waiting for the GPU)
+    EC_FRAME_OVERLAY,           // drawing the profiler's own overlay (kept out of draw)
+    EC_NUM_FRAME_PHASES
+};
+
+struct ECFrameStats {
+    float phaseUs[EC_NUM_FRAME_PHASES] = {};
+    float frameUs = 0;          // from the end of the previous frame
+    uint32_t numPrimitives = 0;
+    uint32_t numOverlayPrimitives = 0;  // the overlay's own, not in numPrimitives
+    uint32_t simTicks = 0;      // simulation ticks the observers advanced
+};
+
+//*****************************************************************************
+// Collects the current frame's timings and counts; EndFrame() moves them into
+// a ring of the last WINDOW frames, from which the overlay reads the graph and
+// the percentiles. Nothing allocates after construction (percentiles use a
+// fixed scratch array), so the profiler does not disturb the alloc check. With
+// a log open, every frame is also written as a CSV row.
+
+class ECFrameProfiler
+{
+public:
+    static const int WINDOW = 240;
+
+    ECFrameProfiler();
+    ~ECFrameProfiler() { CloseLog(); }
+
+    ECFrameProfiler(const ECFrameProfiler &) = delete;
+    ECFrameProfiler &operator=(const ECFrameProfiler &) = delete;
+
+    void AddPhaseTime(ECFramePhase phase, double us) { current.phaseUs[phase] += static_cast<float>(us); }
+    void AddPrimitive() { current.numPrimitives++; }
+    void AddOverlayPrimitives(int count) { current.numOverlayPrimitives += count; }
+    void AddSimTicks(int ticks) { current.simTicks += ticks; }
+    void EndFrame(double frameUs);
+
+    // CSV with a header row; false if the file cannot be created
+    bool OpenLog(const std::string &filename);
+    void CloseLog();
+    bool IsLogOpen() const { return log != nullptr; }
+
+    int64_t GetNumFramesTotal() const { return numFramesTotal; }
+    // Frames in the window, oldest first
+    size_t GetNumFrames() const { return numFrames; }
+    const ECFrameStats &GetFrame(size_t i) const { return frames[(head + i) % WINDOW]; }
+
+    // Over the window: frame time at quantile q (0..1), mean of a phase, primitives
+    // per frame (the view's, then the overlay's) and simulated ticks per second of
+    // wall time
+    double GetFrameTimePercentile(double q) const;
+    double GetMeanPhaseTime(ECFramePhase phase) const;
+    double GetMeanPrimitives() const;
+    double GetMeanOverlayPrimitives() const;
+    double GetSimTicksPerSecond() const;
+
+private:
+    ECFrameStats current;
+    std::array<ECFrameStats, WINDOW> frames;
+    size_t head;                                // oldest frame
+    size_t numFrames;
+    int64_t numFramesTotal;
+    mutable std::array<float, WINDOW> scratch;  // for percentiles
+    FILE *log;
+};
+
+#endif /* ECFrameProfiler_h */
@@ -6,16 +6,27 @@
 //
 
 #include "ECGraphicViewImp.h"
+#include "ECAllocTracker.h"
 #include "allegro5/allegro_primitives.h"
 #include <allegro5/allegro_image.h>
 #include <allegro5/allegro_ttf.h>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <optional>
 
 
 using namespace std;
 
 const float FPS = 60;
 
+typedef chrono::steady_clock Clock;
+
+static double Us(Clock::time_point start, Clock::time_point stop)
+{
+    return chrono::duration<double, micro>(stop - start).count();
+}
+
 //***********************************************************
 // Allegro colors
 
@@ -35,8 +46,10 @@ ALLEGRO_COLOR arrayAllegroColors[ECGV_NUM_COLORS] =
 // A graphic view implementation
 // This is built on top of Allegro library
 
-ECGraphicViewImp::ECGraphicViewImp(int width, int height) : widthView(width), heightView(height), fRedraw(false), display(NULL), timer(NULL), event_queue(NULL)
+ECGraphicViewImp::ECGraphicViewImp(int width, int height) : widthView(width), heightView(height), fRedraw(false), evtCurrent(ECGV_EV_NULL), timerTicks(0), cursorX(0), cursorY(0), fAllocCheck(false), fProfileOverlay(false), fTimePrimitives(false), drawUs(0), display(NULL), timer(NULL), event_queue(NULL), fontOverlay(NULL), glyphAtlas(NULL), glyphHeight(0), labelPage(NULL), shelfX(0), shelfY(0), labels(LABEL_SLOTS), numLabels(0)
 {
+    labelText.reserve(LABEL_TEXT_BYTES);
+    lineVertices.reserve(1024);
     Init();
 }
 ECGraphicViewImp :: ~ECGraphicViewImp()
@@ -49,10 +62,19 @@ void ECGraphicViewImp::Show()
 {
     //
     //int cursorxDown=-100, cursoryDown=-100, cursorxUp=-100, cursoryUp=-100;
+    optional<ECAllocScope> allocScope;
+    int64_t framesAllocating = 0;
+    if (fAllocCheck)
+    {
+        allocScope.emplace();
+    }
+    lastFrameEnd = Clock::now();
     while (true)
     {
         // get current event
+        Clock::time_point waitStart = Clock::now();
         evtCurrent = WaitForEvent();
+        profiler.AddPhaseTime(EC_FRAME_WAIT, Us(waitStart, Clock::now()));
         //std::cout << "evt: " << evtCurrent << std::endl;
 
         if (evtCurrent == ECGV_EV_NULL)
@@ -60,29 +82,83 @@ void ECGraphicViewImp::Show()
             continue;
         }
 
+        ECEvent evt(GetEventCategory(evtCurrent), evtCurrent);
+        if (evtCurrent == ECGV_EV_TIMER)
+        {
+            evt.tick = ++timerTicks;
+        }
+        evt.x = cursorX;
+        evt.y = cursorY;
+
         if (evtCurrent == ECGV_EV_CLOSE)
         {
+            Notify(evt);
             break;
         }
 
-        // render start
-        RenderStart();
+        if (evtCurrent == ECGV_EV_KEY_UP_P)
+        {
+            fProfileOverlay = !fProfileOverlay;
+        }
+
+        // Nobody listens to this kind of event: nothing to do
+        if (!HasSubscribers(evt.category))
+        {
+            continue;
+        }
+
+        // render start: only timer events are flipped to the display, so only they draw
+        if (evtCurrent == ECGV_EV_TIMER)
+        {
+            Clock::time_point clearStart = Clock::now();
+            RenderStart();
+            profiler.AddPhaseTime(EC_FRAME_DRAW, Us(clearStart, Clock::now()));
+        }
 
         // draw something
         //DrawRectangle(100,100,200,200,3);
     //SetRedraw(true);
 
-        // Notify clients
-        Notify();
+        // Notify clients; once warmed up, a frame's update should not allocate.
+        // The primitives they draw are timed separately (drawUs) while profiling.
+        Clock::time_point notifyStart = Clock::now();
+        drawUs = 0;
+        fTimePrimitives = fProfileOverlay || profiler.IsLogOpen();
+        if (fAllocCheck && evtCurrent == ECGV_EV_TIMER && timerTicks > ALLOC_CHECK_WARMUP)
+        {
+            ECAllocTickGuard guard;
+            Notify(evt);
+            if (guard.GetNumViolations() > 0)
+            {
+                framesAllocating++;
+            }
+        }
+        else
+        {
+            Notify(evt);
+        }
+        profiler.AddPhaseTime(EC_FRAME_UPDATE, Us(notifyStart, Clock::now()) - drawUs);
+        profiler.AddPhaseTime(EC_FRAME_DRAW, drawUs);
 
         // refresh view
         if (evtCurrent == ECGV_EV_TIMER)
         {
             if (fRedraw)
             {
+                if (fProfileOverlay)
+                {
+                    Clock::time_point overlayStart = Clock::now();
+                    DrawProfileOverlay();
+                    profiler.AddPhaseTime(EC_FRAME_OVERLAY, Us(overlayStart, Clock::now()));
+                }
+                Clock::time_point flipStart = Clock::now();
                 RenderEnd();
+                profiler.AddPhaseTime(EC_FRAME_FLIP, Us(flipStart, Clock::now()));
                 fRedraw = false;
             }
+            Clock::time_point frameEnd = Clock::now();
+            profiler.EndFrame(Us(lastFrameEnd, frameEnd));
+            lastFrameEnd = frameEnd;
         }
 
 #if 0
@@ -129,6 +205,13 @@ void ECGraphicViewImp::Show()
         }
 #endif
     }
+
+    if (allocScope)
+    {
+        allocScope->Report(cout, "Viewer heap use");
+        cout << "Frames that allocated after warm-up: " << framesAllocating << " of "
+             << max<int64_t>(timerTicks - ALLOC_CHECK_WARMUP, 0) << "\n";
+    }
 }
 
 void ECGraphicViewImp::RenderStart()
@@ -211,6 +294,8 @@ void ECGraphicViewImp::Init()
             // Continue without text rendering capability
         }
     }
+    this->fontOverlay = al_create_builtin_font();
+    BuildGlyphAtlas();
 
     cout << "Done with initialization.\n";
 }
@@ -218,6 +303,16 @@ void ECGraphicViewImp::Init()
 void ECGraphicViewImp::Shutdown()
 {
     //
+    if (labelPage != NULL)
+    {
+        al_destroy_bitmap(labelPage);
+        labelPage = NULL;
+    }
+    if (glyphAtlas != NULL)
+    {
+        al_destroy_bitmap(glyphAtlas);
+        glyphAtlas = NULL;
+    }
     if (display != NULL)
     {
         al_destroy_display(display);
@@ -278,6 +373,9 @@ ECGVEventType ECGraphicViewImp::WaitForEvent()
         case ALLEGRO_KEY_G:
             return ECGV_EV_KEY_DOWN_G;
 
+        case ALLEGRO_KEY_P:
+            return ECGV_EV_KEY_DOWN_P;
+
         }
     }
     else if (ev.type == ALLEGRO_EVENT_KEY_UP) {
@@ -312,18 +410,27 @@ ECGVEventType ECGraphicViewImp::WaitForEvent()
         case ALLEGRO_KEY_G:
             return ECGV_EV_KEY_UP_G;
 
+        case ALLEGRO_KEY_P:
+            return ECGV_EV_KEY_UP_P;
+
         }
     }
     else if (ev.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN)
     {
+        cursorX = ev.mouse.x;
+        cursorY = ev.mouse.y;
         return ECGV_EV_MOUSE_BUTTON_DOWN;
     }
     else if (ev.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP)
     {
+        cursorX = ev.mouse.x;
+        cursorY = ev.mouse.y;
         return ECGV_EV_MOUSE_BUTTON_UP;
     }
     else if (ev.type == ALLEGRO_EVENT_MOUSE_AXES)
     {
+        cursorX = ev.mouse.x;
+        cursorY = ev.mouse.y;
         return ECGV_EV_MOUSE_MOVING;
     }
     //cout << "Event not recognized...\n";
@@ -331,6 +438,24 @@ ECGVEventType ECGraphicViewImp::WaitForEvent()
     return ECGV_EV_NULL;
 }
 
+ECEventCategory ECGraphicViewImp::GetEventCategory(ECGVEventType evt)
+{
+    switch (evt)
+    {
+    case ECGV_EV_TIMER:
+        return EC_EVENT_TIMER;
+    case ECGV_EV_CLOSE:
+    case ECGV_EV_NULL:
+        return EC_EVENT_CLOSE;
+    case ECGV_EV_MOUSE_BUTTON_DOWN:
+    case ECGV_EV_MOUSE_BUTTON_UP:
+    case ECGV_EV_MOUSE_MOVING:
+        return EC_EVENT_MOUSE;
+    default:
+        return EC_EVENT_KEY;
+    }
+}
+
 void ECGraphicViewImp::GetCursorPosition(int& cx, int& cy) const
 {
     ALLEGRO_MOUSE_STATE state;
@@ -339,53 +464,335 @@ void ECGraphicViewImp::GetCursorPosition(int& cx, int& cy) const
     cy = state.y;
 }
 
+//***********************************************************
+// Glyph atlas and label cache
+
+void ECGraphicViewImp::BuildGlyphAtlas()
+{
+    ALLEGRO_FONT* font = al_load_font("lucon.ttf", LABEL_FONT_SIZE, 0);
+    bool ownFont = font != NULL;
+    if (font == NULL)
+    {
+        font = fontOverlay;
+    }
+    if (font == NULL)
+    {
+        return;
+    }
+
+    // 16 x 6 cells as wide as the widest glyph
+    const int numGlyphs = static_cast<int>(glyphs.size());
+    const int perRow = 16;
+    char text[2] = {0, 0};
+    int cellWidth = 1;
+    for (int i = 0; i < numGlyphs; i++)
+    {
+        text[0] = static_cast<char>(' ' + i);
+        glyphs[i].width = static_cast<int16_t>(al_get_text_width(font, text));
+        cellWidth = max(cellWidth, static_cast<int>(glyphs[i].width));
+    }
+    glyphHeight = al_get_font_line_height(font);
+    glyphAtlas = al_create_bitmap(cellWidth * perRow, glyphHeight * ((numGlyphs + perRow - 1) / perRow));
+    labelPage = al_create_bitmap(LABEL_PAGE_SIZE, LABEL_PAGE_SIZE);
+    if (glyphAtlas != NULL && labelPage != NULL)
+    {
+        al_set_target_bitmap(glyphAtlas);
+        al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+        for (int i = 0; i < numGlyphs; i++)
+        {
+            glyphs[i].x = static_cast<int16_t>((i % perRow) * cellWidth);
+            glyphs[i].y = static_cast<int16_t>((i / perRow) * glyphHeight);
+            text[0] = static_cast<char>(' ' + i);
+            al_draw_text(font, arrayAllegroColors[ECGV_WHITE], glyphs[i].x, glyphs[i].y, ALLEGRO_ALIGN_LEFT, text);
+        }
+        al_set_target_bitmap(labelPage);
+        al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+        al_set_target_bitmap(al_get_backbuffer(display));
+    }
+    else
+    {
+        cout << "Warning: no glyph atlas, text is drawn directly\n";
+        if (glyphAtlas != NULL)
+        {
+            al_destroy_bitmap(glyphAtlas);
+            glyphAtlas = NULL;
+        }
+        if (labelPage != NULL)
+        {
+            al_destroy_bitmap(labelPage);
+            labelPage = NULL;
+        }
+    }
+    if (ownFont)
+    {
+        al_destroy_font(font);
+    }
+}
+
+void ECGraphicViewImp::DrawGlyphs(const char* ptext, float x, float y, ALLEGRO_COLOR color)
+{
+    for (const char* c = ptext; *c; c++)
+    {
+        if (*c < ' ' || *c > '~')
+        {
+            continue;
+        }
+        const Glyph& g = glyphs[*c - ' '];
+        al_draw_tinted_bitmap_region(glyphAtlas, color, g.x, g.y, g.width, glyphHeight, x, y, 0);
+        x += g.width;
+    }
+}
+
+const ECGraphicViewImp::CachedLabel* ECGraphicViewImp::FindLabel(const char* ptext)
+{
+    // FNV-1a; looking a label up never allocates
+    uint64_t hash = 14695981039346656037ull;
+    int width = 0;
+    int length = 0;
+    for (const char* c = ptext; *c; c++, length++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        width += (*c >= ' ' && *c <= '~') ? glyphs[*c - ' '].width : 0;
+    }
+    hash = hash == 0 ? 1 : hash;
+    size_t slot = hash & (LABEL_SLOTS - 1);
+    while (labels[slot].hash != 0)
+    {
+        const CachedLabel& label = labels[slot];
+        if (label.hash == hash)
+        {
+            bool same = label.textLength == length && memcmp(&labelText[label.textOffset], ptext, length) == 0;
+            return same ? &label : NULL;
+        }
+        slot = (slot + 1) & (LABEL_SLOTS - 1);
+    }
+    if (width > LABEL_PAGE_SIZE || length > LABEL_TEXT_BYTES)
+    {
+        return NULL;
+    }
+
+    // Next spot on the current row, else the next row, else start the page over
+    // (also when its table or text is full)
+    if (shelfX + width > LABEL_PAGE_SIZE)
+    {
+        shelfX = 0;
+        shelfY += glyphHeight;
+    }
+    if (shelfY + glyphHeight > LABEL_PAGE_SIZE || 2 * (numLabels + 1) > LABEL_SLOTS ||
+        labelText.size() + length > static_cast<size_t>(LABEL_TEXT_BYTES))
+    {
+        ClearLabelPage();
+        slot = hash & (LABEL_SLOTS - 1);
+    }
+    al_set_target_bitmap(labelPage);
+    DrawGlyphs(ptext, shelfX, shelfY, arrayAllegroColors[ECGV_WHITE]);
+    al_set_target_bitmap(al_get_backbuffer(display));
+
+    CachedLabel& label = labels[slot];
+    label.hash = hash;
+    label.textOffset = static_cast<int32_t>(labelText.size());
+    label.textLength = static_cast<int16_t>(length);
+    label.x = static_cast<int16_t>(shelfX);
+    label.y = static_cast<int16_t>(shelfY);
+    label.width = static_cast<int16_t>(width);
+    labelText.insert(labelText.end(), ptext, ptext + length);
+    numLabels++;
+    shelfX += width;
+    return &label;
+}
+
+void ECGraphicViewImp::ClearLabelPage()
+{
+    al_set_target_bitmap(labelPage);
+    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+    al_set_target_bitmap(al_get_backbuffer(display));
+    for (CachedLabel& label : labels)
+    {
+        label.hash = 0;
+    }
+    numLabels = 0;
+    labelText.clear();
+    shelfX = shelfY = 0;
+}
+
+class ECGraphicViewImp::PrimitiveTimer
+{
+public:
+    PrimitiveTimer(ECGraphicViewImp& view) : view(view), timed(view.fTimePrimitives)
+    {
+        if (timed)
+        {
+            start = Clock::now();
+        }
+    }
+    ~PrimitiveTimer()
+    {
+        if (timed)
+        {
+            view.drawUs += Us(start, Clock::now());
+        }
+        view.profiler.AddPrimitive();
+    }
+
+private:
+    ECGraphicViewImp& view;
+    bool timed;
+    Clock::time_point start;
+};
+
 // Drawing functions
 void  ECGraphicViewImp::DrawLine(int x1, int y1, int x2, int y2, int thickness, ECGVColor color)
 {
-    // draw a line
+    PrimitiveTimer primitive(*this);
     al_draw_line(x1, y1, x2, y2, arrayAllegroColors[color], thickness);
     //cout << "Draw line: (" << x1 << "," << y1 << " to (" << x2 << "," << y2 << ")\n";
 }
 
+void ECGraphicViewImp::DrawLines(const int* xy, int numLines, ECGVColor color)
+{
+    PrimitiveTimer primitive(*this);
+    lineVertices.resize(2 * numLines);
+    for (int i = 0; i < 2 * numLines; i++)
+    {
+        // Through pixel centers, as al_draw_line does for odd thicknesses
+        ALLEGRO_VERTEX& v = lineVertices[i];
+        v.x = xy[2 * i] + 0.5f;
+        v.y = xy[2 * i + 1] + 0.5f;
+        v.z = v.u = v.v = 0;
+        v.color = arrayAllegroColors[color];
+    }
+    al_draw_prim(lineVertices.data(), NULL, NULL, 0, 2 * numLines, ALLEGRO_PRIM_LINE_LIST);
+}
+
 void ECGraphicViewImp::DrawRectangle(int x1, int y1, int x2, int y2, int thickness, ECGVColor color)
 {
+    PrimitiveTimer primitive(*this);
     al_draw_rectangle(x1, y1, x2, y2, arrayAllegroColors[color], thickness);
 }
 
 void ECGraphicViewImp::DrawCircle(int xcenter, int ycenter, double radius, int thickness, ECGVColor color)
 {
+    PrimitiveTimer primitive(*this);
     al_draw_circle(xcenter, ycenter, radius, arrayAllegroColors[color], thickness);
 }
 
 void ECGraphicViewImp::DrawEllipse(int xcenter, int ycenter, double radiusx, double radiusy, int thickness, ECGVColor color)
 {
+    PrimitiveTimer primitive(*this);
     al_draw_ellipse(xcenter, ycenter, radiusx, radiusy, arrayAllegroColors[color], thickness);
 }
 
 void ECGraphicViewImp::DrawFilledRectangle(int x1, int y1, int x2, int y2, ECGVColor color)
 {
-    al_draw_filled_rectangle(x1, y1, x2, y2, arrayAllegroColors[color]);;
+    PrimitiveTimer primitive(*this);
+    al_draw_filled_rectangle(x1, y1, x2, y2, arrayAllegroColors[color]);
 }
 
 void ECGraphicViewImp::DrawFilledCircle(int xcenter, int ycenter, double radius, ECGVColor color)
 {
+    PrimitiveTimer primitive(*this);
     al_draw_filled_circle(xcenter, ycenter, radius, arrayAllegroColors[color]);
 }
 
 void ECGraphicViewImp::DrawFilledEllipse(int xcenter, int ycenter, double radiusx, double radiusy, ECGVColor color)
 {
+    PrimitiveTimer primitive(*this);
     al_draw_filled_ellipse(xcenter, ycenter, radiusx, radiusy, arrayAllegroColors[color]);
 }
 
 void ECGraphicViewImp::DrawText(int xcenter, int ycenter, const char* ptext, ECGVColor color)
 {
-    al_draw_text(this->fontDef, arrayAllegroColors[color], xcenter, ycenter, ALLEGRO_ALIGN_CENTER, ptext);
+    PrimitiveTimer primitive(*this);
+    if (glyphAtlas == NULL)
+    {
+        if (fontDef != NULL)
+        {
+            al_draw_text(fontDef, arrayAllegroColors[color], xcenter, ycenter - al_get_font_line_height(fontDef) / 2,
+                         ALLEGRO_ALIGN_CENTER, ptext);
+        }
+        return;
+    }
+    const CachedLabel* label = FindLabel(ptext);
+    if (label == NULL)
+    {
+        int width = 0;
+        for (const char* c = ptext; *c; c++)
+        {
+            width += (*c >= ' ' && *c <= '~') ? glyphs[*c - ' '].width : 0;
+        }
+        DrawGlyphs(ptext, xcenter - width / 2, ycenter - glyphHeight / 2, arrayAllegroColors[color]);
+        return;
+    }
+    al_draw_tinted_bitmap_region(labelPage, arrayAllegroColors[color], label->x, label->y, label->width, glyphHeight,
+                                 xcenter - label->width / 2, ycenter - glyphHeight / 2, 0);
 }
 
 void ECGraphicViewImp::DrawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, int thickness, ECGVColor color) {
+    PrimitiveTimer primitive(*this);
     al_draw_triangle(x1, y1, x2, y2, x3, y3, arrayAllegroColors[color], thickness);
 }
 
 void ECGraphicViewImp::DrawFilledTriangle(int x1, int y1, int x2, int y2, int x3, int y3, ECGVColor color) {
+    PrimitiveTimer primitive(*this);
     al_draw_filled_triangle(x1, y1, x2, y2, x3, y3, arrayAllegroColors[color]);
+}
+void ECGraphicViewImp::DrawProfileOverlay()
+{
+    const int graphWidth = ECFrameProfiler::WINDOW;
+    const int graphHeight = 60;
+    const int lineHeight = 10;
+    const double fullUs = 2e6 / FPS;            // the graph's height: two frame periods
+    int x0 = widthView - graphWidth - 15;
+    int y0 = 10;
+    int yBase = y0 + graphHeight;
+    ALLEGRO_COLOR black = arrayAllegroColors[ECGV_BLACK];
+
+    al_draw_filled_rectangle(x0 - 5, y0 - 5, x0 + graphWidth + 5, yBase + 5 * lineHeight, arrayAllegroColors[ECGV_WHITE]);
+    al_draw_rectangle(x0 - 5, y0 - 5, x0 + graphWidth + 5, yBase + 5 * lineHeight, black, 1);
+    int numDrawn = 2;
+
+    // One column per frame: update, draw and flip stacked, and a dot for the whole frame
+    auto height = [&](double us) { return static_cast<float>(min(us, fullUs) * graphHeight / fullUs); };
+    const ECFramePhase stacked[] = {EC_FRAME_UPDATE, EC_FRAME_DRAW, EC_FRAME_FLIP};
+    const ECGVColor colors[] = {ECGV_BLUE, ECGV_GREEN, ECGV_RED};
+    for (size_t i = 0; i < profiler.GetNumFrames(); i++)
+    {
+        const ECFrameStats& frame = profiler.GetFrame(i);
+        float x = x0 + i + 0.5f;
+        double below = 0;
+        for (int p = 0; p < 3; p++)
+        {
+            double us = max<double>(frame.phaseUs[stacked[p]], 0);
+            al_draw_line(x, yBase - height(below), x, yBase - height(below + us), arrayAllegroColors[colors[p]], 1);
+            below += us;
+        }
+        al_draw_filled_rectangle(x - 0.5f, yBase - height(frame.frameUs) - 1, x + 0.5f, yBase - height(frame.frameUs),
+                                 black);
+        numDrawn += 4;
+    }
+    float yBudget = yBase - height(1e6 / FPS);
+    al_draw_line(x0, yBudget, x0 + graphWidth, yBudget, arrayAllegroColors[ECGV_PURPLE], 1);
+    numDrawn++;
+
+    if (!fontOverlay)
+    {
+        profiler.AddOverlayPrimitives(numDrawn);
+        return;
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "frame ms p50 %.1f p95 %.1f p99 %.1f max %.1f",
+             profiler.GetFrameTimePercentile(0.5) / 1000, profiler.GetFrameTimePercentile(0.95) / 1000,
+             profiler.GetFrameTimePercentile(0.99) / 1000, profiler.GetFrameTimePercentile(1) / 1000);
+    al_draw_text(fontOverlay, black, x0, yBase + 4, ALLEGRO_ALIGN_LEFT, line);
+    snprintf(line, sizeof(line), "update %.2f draw %.2f flip %.2f wait %.2f",
+             profiler.GetMeanPhaseTime(EC_FRAME_UPDATE) / 1000, profiler.GetMeanPhaseTime(EC_FRAME_DRAW) / 1000,
+             profiler.GetMeanPhaseTime(EC_FRAME_FLIP) / 1000, profiler.GetMeanPhaseTime(EC_FRAME_WAIT) / 1000);
+    al_draw_text(fontOverlay, black, x0, yBase + 4 + lineHeight, ALLEGRO_ALIGN_LEFT, line);
+    snprintf(line, sizeof(line), "%.0f primitives/frame  %.0f ticks/s",
+             profiler.GetMeanPrimitives(), profiler.GetSimTicksPerSecond());
+    al_draw_text(fontOverlay, black, x0, yBase + 4 + 2 * lineHeight, ALLEGRO_ALIGN_LEFT, line);
+    snprintf(line, sizeof(line), "overlay %.2f ms, %.0f primitives (not above)",
+             profiler.GetMeanPhaseTime(EC_FRAME_OVERLAY) / 1000, profiler.GetMeanOverlayPrimitives());
+    al_draw_text(fontOverlay, black, x0, yBase + 4 + 3 * lineHeight, ALLEGRO_ALIGN_LEFT, line);
+    profiler.AddOverlayPrimitives(numDrawn + 4);
 }
\ No newline at end of file
@@ -16,11 +16,17 @@
 #ifndef ECGraphicViewImp_h
 #define ECGraphicViewImp_h
 
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 #include <map>
+#include <string>
 #include "ECObserver.h"
+#include "ECFrameProfiler.h"
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_font.h>
+#include <allegro5/allegro_primitives.h>
 
 //***********************************************************
 // Supported event codes
@@ -53,7 +59,9 @@ enum ECGVEventType
     ECGV_EV_KEY_UP_SPACE = 21,
     ECGV_EV_KEY_DOWN_SPACE = 22,
     ECGV_EV_KEY_DOWN_G = 23,
-    ECGV_EV_KEY_UP_G = 24
+    ECGV_EV_KEY_UP_G = 24,
+    ECGV_EV_KEY_DOWN_P = 25,
+    ECGV_EV_KEY_UP_P = 26
 };
 
 //***********************************************************
@@ -100,9 +108,10 @@ private:
 //
 // Note: ECGraphicViewImp implements *** Observer *** pattern
 // It is the subject that accepts observers.
-// Whenver something happens (i.e., a key is pressed), all observers
-// are notified through Observer's Notify function
-// then an observer would check for update (in this case, what key is pressed)
+// Whenver something happens (i.e., a key is pressed), the observers subscribed
+// to that kind of event (timer, key, mouse, close) are notified with an ECEvent
+// whose code is the ECGVEventType. Observers attached with Attach() get every
+// event and can also check GetCurrEvent().
 //
 
 class ECGraphicViewImp : public ECObserverSubject
@@ -118,6 +127,27 @@ public:
     // Set flag to redraw (or not). Invoke SetRedraw(true) after you make changes to the view
     void SetRedraw(bool f) { fRedraw = f; }
 
+    // Count heap allocations while notifying timer observers (see ECAllocTracker.h;
+    // only operator new on this thread is seen, not Allegro's own allocations);
+    // after the first ALLOC_CHECK_WARMUP frames any allocation counts against the
+    // frame. Show() prints the totals when it returns.
+    void SetAllocCheck(bool f) { fAllocCheck = f; }
+    static const int ALLOC_CHECK_WARMUP = 60;
+
+    // Frame profiler (see ECFrameProfiler.h): every frame is timed by phase and its
+    // primitives counted. The overlay (toggled with P) shows the last frames as a
+    // stacked graph (update blue, draw green, flip red, whole frame black) against
+    // the frame budget, with percentiles; its own drawing is timed and counted apart
+    // from the view's. SetProfileLog writes every frame to a CSV file; it returns
+    // false if the file cannot be created. With neither the overlay nor a log,
+    // primitives are counted but not timed (their time goes to update), so the
+    // profiler adds no clock reads per primitive.
+    void SetProfileOverlay(bool f) { fProfileOverlay = f; }
+    bool SetProfileLog(const std::string& filename) { return profiler.OpenLog(filename); }
+    // Observers report how many simulation ticks they advanced this frame
+    void AddSimTicks(int ticks) { profiler.AddSimTicks(ticks); }
+    const ECFrameProfiler& GetProfiler() const { return profiler; }
+
     // Access view properties
     int GetWith() const { return widthView; }
     int GetWidth() const { return widthView; }
@@ -129,24 +159,62 @@ public:
     // The current event
     ECGVEventType GetCurrEvent() const { return evtCurrent; }
 
+    // Which subscription category an event belongs to
+    static ECEventCategory GetEventCategory(ECGVEventType evt);
+
     // Drawing functions
     void DrawLine(int x1, int y1, int x2, int y2, int thickness = 3, ECGVColor color = ECGV_BLACK);
+    // One-pixel segments, xy holding x1, y1, x2, y2 for each, in a single draw call
+    void DrawLines(const int* xy, int numLines, ECGVColor color = ECGV_BLACK);
     void DrawRectangle(int x1, int y1, int x2, int y2, int thickness = 3, ECGVColor color = ECGV_BLACK);
     void DrawFilledRectangle(int x1, int y1, int x2, int y2, ECGVColor color = ECGV_BLACK);
     void DrawCircle(int xcenter, int ycenter, double radius, int thickness = 3, ECGVColor color = ECGV_BLACK);
     void DrawFilledCircle(int xcenter, int ycenter, double radius, ECGVColor color = ECGV_BLACK);
     void DrawEllipse(int xcenter, int ycenter, double radiusx, double radiusy, int thickness = 3, ECGVColor color = ECGV_BLACK);
     void DrawFilledEllipse(int xcenter, int ycenter, double radiusx, double radiusy, ECGVColor color = ECGV_BLACK);
+    // Text centered on (xcenter, ycenter), LABEL_FONT_SIZE high (see below)
     void DrawText(int xcenter, int ycenter, const char* ptext, ECGVColor color = ECGV_BLACK);
     void DrawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, int thickness = 3, ECGVColor color = ECGV_BLACK);
     void DrawFilledTriangle(int x1, int y1, int x2, int y2, int x3, int y3, ECGVColor color = ECGV_BLACK);
 
+    // Text is drawn from a glyph atlas: at start-up the printable ASCII characters
+    // are rendered once, in white, into one bitmap (lucon.ttf at LABEL_FONT_SIZE,
+    // or the built-in font). The first time a label is drawn it is composed from
+    // the atlas into a label cache page; after that it costs one tinted bitmap
+    // draw per frame, whatever its color. A full page is cleared and refilled, as
+    // is the page's table of labels (fixed in size, so caching never allocates).
+    // Without an atlas (no font or bitmaps) text goes through al_draw_text.
+    static const int LABEL_FONT_SIZE = 14;
+    static const int LABEL_PAGE_SIZE = 512;
+    static const int LABEL_SLOTS = 1024;            // a power of two; at most half are used
+    static const int LABEL_TEXT_BYTES = 16384;      // text of the labels on a page
+
 private:
+    struct Glyph {
+        int16_t x, y;               // cell in the atlas
+        int16_t width;              // advance
+    };
+    struct CachedLabel {
+        uint64_t hash;              // 0: free slot
+        int32_t textOffset;         // in labelText
+        int16_t textLength;
+        int16_t x, y;               // on the label page
+        int16_t width;
+    };
+
     // Internal functions
     // Initialize and reset view
     void Init();
     void Shutdown();
 
+    // Text
+    void BuildGlyphAtlas();
+    // The label's place on the cache page, composing it on first use; nullptr if
+    // it cannot be cached (too wide or too long, or its hash is taken by another label)
+    const CachedLabel* FindLabel(const char* ptext);
+    void ClearLabelPage();
+    void DrawGlyphs(const char* ptext, float x, float y, ALLEGRO_COLOR color);
+
     // View utiltiles
     void RenderStart();
     void RenderEnd();
@@ -154,6 +222,12 @@ private:
     // Process event
     ECGVEventType  WaitForEvent();
 
+    // Profiler overlay, drawn last; its primitives go to the overlay counts
+    void DrawProfileOverlay();
+
+    // Times one primitive into the draw phase
+    class PrimitiveTimer;
+
     // data members
     // size of view
     int widthView;
@@ -164,12 +238,36 @@ private:
 
     // keep track of what happened to view
     ECGVEventType evtCurrent;
+    int64_t timerTicks;
+    int cursorX, cursorY;
+    bool fAllocCheck;
+
+    // frame profiling
+    ECFrameProfiler profiler;
+    bool fProfileOverlay;
+    bool fTimePrimitives;                   // overlay or log on, this frame
+    double drawUs;                          // drawing time within the current Notify
+    std::chrono::steady_clock::time_point lastFrameEnd;
 
     // allegro stuff
     ALLEGRO_DISPLAY* display;
     ALLEGRO_EVENT_QUEUE* event_queue;
     ALLEGRO_TIMER* timer;
     ALLEGRO_FONT* fontDef;
+    ALLEGRO_FONT* fontOverlay;
+
+    // glyph atlas and label cache
+    ALLEGRO_BITMAP* glyphAtlas;
+    std::array<Glyph, 95> glyphs;               // ' ' .. '~'
+    int glyphHeight;
+    ALLEGRO_BITMAP* labelPage;
+    int shelfX, shelfY;                         // next free spot on the page (rows of glyphHeight)
+    std::vector<CachedLabel> labels;            // LABEL_SLOTS, open addressing by hash of the text
+    int numLabels;
+    std::vector<char> labelText;                // reserved to LABEL_TEXT_BYTES
+
+    // vertices for DrawLines, reused every call
+    std::vector<ALLEGRO_VERTEX> lineVertices;
 };
 
 #endif /* ECGraphicViewImp_h */
\ No newline at end of file
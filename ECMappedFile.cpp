@@ -0,0 +1,146 @@
+//
+//  ECMappedFile.cpp
+//
+//
+//  A file mapped read-only into memory
+//
+
+#include "ECMappedFile.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+using namespace std;
+
+#if defined(_WIN32)
+
+ECMappedFile::ECMappedFile() : data(nullptr), size(0), fileHandle(nullptr), mappingHandle(nullptr) {}
+
+bool ECMappedFile::Open(const string &filename) {
+    Close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 ||
+        static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<unsigned long long>(SIZE_MAX)) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t *>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void ECMappedFile::Close() {
+    if (data) {
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+    }
+    data = nullptr;
+    size = 0;
+    fileHandle = mappingHandle = nullptr;
+}
+
+#elif defined(__unix__) || defined(__APPLE__)
+
+ECMappedFile::ECMappedFile() : data(nullptr), size(0) {}
+
+bool ECMappedFile::Open(const string &filename) {
+    Close();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    // The mapping stays valid once the descriptor is closed
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const uint8_t *>(mapped);
+    size = st.st_size;
+    return true;
+}
+
+void ECMappedFile::Close() {
+    if (data) {
+        munmap(const_cast<uint8_t *>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#else
+
+ECMappedFile::ECMappedFile() : data(nullptr), size(0) {}
+
+bool ECMappedFile::Open(const string &filename) {
+    Close();
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    size_t fileSize = 0;
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    if (ok) {
+        long end = ftell(file);
+        ok = end > 0 && fseek(file, 0, SEEK_SET) == 0;
+        fileSize = ok ? static_cast<size_t>(end) : 0;
+    }
+    if (ok) {
+        buffer.resize((fileSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        ok = fread(buffer.data(), 1, fileSize, file) == fileSize;
+    }
+    fclose(file);
+    if (!ok) {
+        buffer.clear();
+        return false;
+    }
+    data = reinterpret_cast<const uint8_t *>(buffer.data());
+    size = fileSize;
+    return true;
+}
+
+void ECMappedFile::Close() {
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+}
+
+#endif
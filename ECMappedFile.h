@@ -0,0 +1,50 @@
+//
+//  ECMappedFile.h
+//
+//
+//  A file mapped read-only into memory
+//
+
+#ifndef ECMappedFile_h
+#define ECMappedFile_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// The whole of a file, read-only: mapped with mmap on POSIX systems and with a
+// file mapping on Windows. Where neither exists the file is read into memory
+// instead, so readers work the same, only without sharing pages with the OS.
+// The data is aligned at least to 8 bytes.
+
+class ECMappedFile
+{
+public:
+    ECMappedFile();
+    ~ECMappedFile() { Close(); }
+
+    ECMappedFile(const ECMappedFile &) = delete;
+    ECMappedFile &operator=(const ECMappedFile &) = delete;
+
+    // False if the file cannot be opened or mapped, or is empty
+    bool Open(const std::string &filename);
+    void Close();
+
+    bool IsOpen() const { return data != nullptr; }
+    const uint8_t *GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    const uint8_t *data;
+    size_t size;
+#if defined(_WIN32)
+    void *fileHandle;                   // HANDLEs, kept until Close
+    void *mappingHandle;
+#elif !defined(__unix__) && !defined(__APPLE__)
+    std::vector<uint64_t> buffer;       // the file's bytes, when it cannot be mapped
+#endif
+};
+
+#endif /* ECMappedFile_h */
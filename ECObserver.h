@@ -12,45 +12,114 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <cstdint>
+
+//********************************************
+// Event categories an observer can subscribe to
+
+enum ECEventCategory
+{
+    EC_EVENT_TIMER = 0,         // view timer tick
+    EC_EVENT_KEY = 1,           // key pressed or released
+    EC_EVENT_MOUSE = 2,         // mouse button or movement
+    EC_EVENT_CLOSE = 3,         // view is closing
+    EC_EVENT_SIM_STATE = 4,     // simulation state changed (passenger arrived, delivered, ...)
+    EC_EVENT_NUM_CATEGORIES
+};
+
+// Subscription masks
+const uint32_t EC_EVENT_MASK_ALL = (1u << EC_EVENT_NUM_CATEGORIES) - 1;
+inline uint32_t ECEventMask(ECEventCategory category) { return 1u << category; }
+
+//********************************************
+// An event with its payload. 'code' is specific to the category: the view's
+// ECGVEventType for timer/key/mouse/close events, the subject's own change code
+// for sim-state events.
+
+struct ECEvent
+{
+    ECEvent() : category(EC_EVENT_TIMER), code(0), x(0), y(0), tick(0), value(0) {}
+    ECEvent(ECEventCategory categoryIn, int codeIn) : category(categoryIn), code(codeIn), x(0), y(0), tick(0), value(0) {}
+
+    ECEventCategory category;
+    int code;
+    int x, y;           // cursor position (mouse events)
+    int64_t tick;       // timer ticks so far (timer events) or simulation time (sim-state events)
+    int value;          // extra value for sim-state events (e.g. a floor)
+};
 
 //********************************************
 // Observer design pattern: observer interface
+//
+// Observers attached with Attach() get every event through Update() and ask the
+// subject what happened. Observers subscribed to specific categories should
+// override OnEvent() instead: they get only those events, with the payload.
+// Update() is empty by default so that such observers need not define it.
 
 class ECObserver
 {
 public:
     virtual ~ECObserver() {}
-    virtual void Update() = 0;
+    virtual void Update() {}
+    virtual void OnEvent(const ECEvent &) { Update(); }
 };
 
 //********************************************
 // Observer design pattern: subject
+//
+// Keeps one dispatch list per event category, so notifying an event only
+// touches the observers that subscribed to its category.
 
 class ECObserverSubject
 {
 public:
     ECObserverSubject() {}
     virtual ~ECObserverSubject() {}
+
+    // Subscribe to every category (observer is invoked through Update())
     void Attach( ECObserver *pObs )
     {
 //std::cout << "Adding an observer.\n";
-        listObservers.push_back(pObs);
+        Subscribe(pObs, EC_EVENT_MASK_ALL);
+    }
+
+    // Subscribe to the categories in 'mask' (see ECEventMask); can be called again to add more
+    void Subscribe( ECObserver *pObs, uint32_t mask )
+    {
+        for(int c=0; c<EC_EVENT_NUM_CATEGORIES; ++c)
+        {
+            std::vector<ECObserver *> &list = listObservers[c];
+            if( (mask & (1u << c)) && std::find(list.begin(), list.end(), pObs) == list.end() )
+            {
+                list.push_back(pObs);
+            }
+        }
     }
+
     void Detach( ECObserver *pObs )
     {
-        listObservers.erase(std::remove(listObservers.begin(), listObservers.end(), pObs), listObservers.end());
+        for(int c=0; c<EC_EVENT_NUM_CATEGORIES; ++c)
+        {
+            listObservers[c].erase(std::remove(listObservers[c].begin(), listObservers[c].end(), pObs), listObservers[c].end());
+        }
     }
-    void Notify()
+
+    // Anyone listening to this category?
+    bool HasSubscribers( ECEventCategory category ) const { return !listObservers[category].empty(); }
+
+    // Invoke the observers subscribed to the event's category
+    void Notify( const ECEvent &evt )
     {
-//std::cout << "Notify: number of observer: " << listObservers.size() << std::endl;
-        for(unsigned int i=0; i<listObservers.size(); ++i)
+//std::cout << "Notify: number of observer: " << listObservers[evt.category].size() << std::endl;
+        const std::vector<ECObserver *> &list = listObservers[evt.category];
+        for(unsigned int i=0; i<list.size(); ++i)
         {
-            listObservers[i]->Update();
+            list[i]->OnEvent(evt);
         }
     }
-    
+
 private:
-    std::vector<ECObserver *> listObservers;
+    std::vector<ECObserver *> listObservers[EC_EVENT_NUM_CATEGORIES];
 };
 
 
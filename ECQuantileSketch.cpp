@@ -0,0 +1,257 @@
+//
+//  ECQuantileSketch.cpp
+//
+//
+//  Mergeable streaming quantile sketch (KLL)
+//
+
+#include "ECQuantileSketch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+const char SKETCH_MAGIC[4] = {'E', 'C', 'Q', 'S'};
+const uint32_t SKETCH_VERSION = 1;
+const uint64_t RNG_SEED = 0x9e3779b97f4a7c15ull;
+const int MIN_K = 8;
+const size_t MAX_LEVELS = 64;
+
+template<class T>
+void Put(ostream &os, const T &value) {
+    os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template<class T>
+bool Get(istream &is, T &value) {
+    return static_cast<bool>(is.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+} // namespace
+
+ECQuantileSketch::ECQuantileSketch(int kIn) : k(max(kIn, MIN_K)) {
+    Clear();
+}
+
+void ECQuantileSketch::Clear() {
+    count = 0;
+    sum = 0;
+    minValue = 0;
+    maxValue = 0;
+    rng = RNG_SEED;
+    numRetained = 0;
+    levels.assign(1, vector<double>());
+    UpdateCapacities();
+}
+
+double ECQuantileSketch::GetRankError(int k) {
+    // Empirical fit for the 99% single-quantile error of KLL with c = 2/3
+    return 2.296 / pow(static_cast<double>(max(k, MIN_K)), 0.9723);
+}
+
+void ECQuantileSketch::UpdateCapacities() {
+    // The top level holds k; each level below 2/3 of the one above, at least 2
+    capacities.resize(levels.size());
+    totalCapacity = 0;
+    for (size_t h = 0; h < levels.size(); h++) {
+        size_t depth = levels.size() - 1 - h;
+        capacities[h] = max<size_t>(2, static_cast<size_t>(ceil(k * pow(2.0 / 3.0, static_cast<double>(depth)))));
+        totalCapacity += capacities[h];
+    }
+}
+
+uint64_t ECQuantileSketch::NextRandom() {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545f4914f6cdd1dull;
+}
+
+void ECQuantileSketch::Add(double value) {
+    if (count == 0) {
+        minValue = maxValue = value;
+    } else {
+        minValue = min(minValue, value);
+        maxValue = max(maxValue, value);
+    }
+    count++;
+    sum += value;
+    levels[0].push_back(value);
+    numRetained++;
+    if (numRetained >= totalCapacity) {
+        CompactOnce();
+    }
+}
+
+void ECQuantileSketch::CompactOnce() {
+    // The lowest level at or over its capacity
+    size_t h = 0;
+    while (h < levels.size() && levels[h].size() < capacities[h]) {
+        h++;
+    }
+    if (h == levels.size()) {
+        return;
+    }
+    if (h + 1 == levels.size()) {
+        if (levels.size() == MAX_LEVELS) {
+            return;
+        }
+        levels.emplace_back();
+        UpdateCapacities();
+    }
+
+    vector<double> &level = levels[h];
+    vector<double> &above = levels[h + 1];
+    sort(level.begin(), level.end());
+    // An odd item out stays behind (the largest one)
+    size_t pairs = level.size() / 2;
+    size_t offset = NextRandom() >> 63;
+    for (size_t i = 0; i < pairs; i++) {
+        above.push_back(level[2 * i + offset]);
+    }
+    double leftover = level.back();
+    bool odd = level.size() % 2 == 1;
+    level.clear();
+    if (odd) {
+        level.push_back(leftover);
+    }
+    numRetained -= pairs;
+}
+
+void ECQuantileSketch::Merge(const ECQuantileSketch &other) {
+    if (other.k != k) {
+        throw invalid_argument("ECQuantileSketch: cannot merge sketches with different k");
+    }
+    if (other.count == 0) {
+        return;
+    }
+    if (&other == this) {
+        ECQuantileSketch copy(other);
+        Merge(copy);
+        return;
+    }
+    if (count == 0) {
+        minValue = other.minValue;
+        maxValue = other.maxValue;
+    } else {
+        minValue = min(minValue, other.minValue);
+        maxValue = max(maxValue, other.maxValue);
+    }
+    count += other.count;
+    sum += other.sum;
+    if (levels.size() < other.levels.size()) {
+        levels.resize(other.levels.size());
+        UpdateCapacities();
+    }
+    for (size_t h = 0; h < other.levels.size(); h++) {
+        levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        numRetained += other.levels[h].size();
+    }
+    while (numRetained >= totalCapacity) {
+        size_t before = numRetained;
+        CompactOnce();
+        if (numRetained == before) {
+            break;
+        }
+    }
+}
+
+double ECQuantileSketch::GetQuantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    if (q <= 0) {
+        return minValue;
+    }
+    if (q >= 1) {
+        return maxValue;
+    }
+    vector<pair<double, uint64_t>> items;
+    items.reserve(numRetained);
+    uint64_t totalWeight = 0;
+    for (size_t h = 0; h < levels.size(); h++) {
+        for (double value : levels[h]) {
+            items.push_back(make_pair(value, uint64_t(1) << h));
+            totalWeight += uint64_t(1) << h;
+        }
+    }
+    sort(items.begin(), items.end());
+    double target = q * totalWeight;
+    uint64_t cumulative = 0;
+    for (const pair<double, uint64_t> &item : items) {
+        cumulative += item.second;
+        if (cumulative >= target) {
+            return item.first;
+        }
+    }
+    return maxValue;
+}
+
+double ECQuantileSketch::GetRank(double value) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t below = 0, totalWeight = 0;
+    for (size_t h = 0; h < levels.size(); h++) {
+        for (double v : levels[h]) {
+            totalWeight += uint64_t(1) << h;
+            if (v <= value) {
+                below += uint64_t(1) << h;
+            }
+        }
+    }
+    return totalWeight ? static_cast<double>(below) / totalWeight : 0;
+}
+
+void ECQuantileSketch::Write(ostream &os) const {
+    os.write(SKETCH_MAGIC, sizeof(SKETCH_MAGIC));
+    Put(os, SKETCH_VERSION);
+    Put(os, static_cast<uint32_t>(k));
+    Put(os, count);
+    Put(os, sum);
+    Put(os, minValue);
+    Put(os, maxValue);
+    Put(os, rng);
+    Put(os, static_cast<uint32_t>(levels.size()));
+    for (const vector<double> &level : levels) {
+        Put(os, static_cast<uint32_t>(level.size()));
+        os.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(double));
+    }
+}
+
+bool ECQuantileSketch::Read(istream &is) {
+    Clear();
+    char magic[4];
+    uint32_t version, kIn, numLevels;
+    if (!is.read(magic, sizeof(magic)) || memcmp(magic, SKETCH_MAGIC, sizeof(magic)) != 0 ||
+        !Get(is, version) || version != SKETCH_VERSION || !Get(is, kIn) || kIn < static_cast<uint32_t>(MIN_K) ||
+        !Get(is, count) || !Get(is, sum) || !Get(is, minValue) || !Get(is, maxValue) || !Get(is, rng) ||
+        !Get(is, numLevels) || numLevels == 0 || numLevels > MAX_LEVELS) {
+        Clear();
+        return false;
+    }
+    k = static_cast<int>(kIn);
+    levels.assign(numLevels, vector<double>());
+    UpdateCapacities();
+    for (vector<double> &level : levels) {
+        uint32_t size;
+        // A level never holds more than k items, plus what one merge appended
+        if (!Get(is, size) || size > 4 * static_cast<uint32_t>(k)) {
+            Clear();
+            return false;
+        }
+        level.resize(size);
+        if (!is.read(reinterpret_cast<char *>(level.data()), size * sizeof(double))) {
+            Clear();
+            return false;
+        }
+        numRetained += size;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+//
+//  ECQuantileSketch.h
+//
+//
+//  Mergeable streaming quantile sketch (KLL)
+//
+
+#ifndef ECQuantileSketch_h
+#define ECQuantileSketch_h
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+//*****************************************************************************
+// KLL sketch (Karnin, Lang, Liberty): approximate quantiles of a stream in
+// O(k) memory, whatever the length of the stream.
+//
+// Values go into level 0. When the sketch is full, the lowest level over its
+// capacity is sorted and every other item (starting at a random one of the first
+// two) moves up one level with twice the weight; the rest are dropped. Levels
+// below the top get geometrically smaller capacities (k * (2/3)^depth, at least
+// 2), so the sketch holds under 3k items. Merging appends the other sketch's
+// levels and compacts the same way, so sketches built on different threads or
+// runs combine in any order with the same error bound.
+//
+// The rank of any value is within GetRankError(k) * count of the true rank with
+// high probability (about 1.3% for k = 200); count, sum, min and max are exact.
+// The coin flips come from a generator seeded at construction, so a sketch
+// built from the same stream is always the same.
+
+class ECQuantileSketch
+{
+public:
+    explicit ECQuantileSketch(int k = 200);
+
+    void Add(double value);
+    // Fold another sketch into this one; throws std::invalid_argument if its k differs
+    void Merge(const ECQuantileSketch &other);
+    void Clear();
+
+    // Value at quantile q in [0, 1] (0 for an empty sketch); 0 and 1 give the exact min and max
+    double GetQuantile(double q) const;
+    // Fraction of the values <= value
+    double GetRank(double value) const;
+
+    uint64_t GetCount() const { return count; }
+    double GetSum() const { return sum; }
+    double GetMean() const { return count ? sum / count : 0; }
+    double GetMin() const { return count ? minValue : 0; }
+    double GetMax() const { return count ? maxValue : 0; }
+    int GetK() const { return k; }
+    // Items kept (the memory use, in values)
+    size_t GetNumRetained() const { return numRetained; }
+
+    // Approximate normalized rank error for a given k
+    static double GetRankError(int k);
+
+    // Binary form: "ECQS", version, k, count, sum, min, max, rng state, then per
+    // level its size and values. Read() returns false (and leaves the sketch
+    // empty) on a malformed or truncated sketch.
+    void Write(std::ostream &os) const;
+    bool Read(std::istream &is);
+
+private:
+    void UpdateCapacities();
+    void CompactOnce();
+    uint64_t NextRandom();
+
+    int k;
+    uint64_t count;
+    double sum;
+    double minValue;
+    double maxValue;
+    uint64_t rng;
+    size_t numRetained;
+    std::vector<std::vector<double>> levels;    // levels[h] items weigh 2^h
+    std::vector<size_t> capacities;             // per level, for the current number of levels
+    size_t totalCapacity;
+};
+
+#endif /* ECQuantileSketch_h */
@@ -0,0 +1,208 @@
+//
+//  ECTimingWheel.h
+//
+//
+//  Hierarchical timing wheel: timers due at whole ticks
+//
+
+#ifndef ECTimingWheel_h
+#define ECTimingWheel_h
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//*****************************************************************************
+// Timers carrying a T, each due at a tick. There are LEVELS wheels of SLOTS
+// slots: level 0 has a slot per tick, level 1 a slot per SLOTS ticks, and so
+// on, which covers every non-negative int tick. A timer is kept on an intrusive
+// list in the slot of its tick, at the highest level where its tick differs
+// from the wheel's time. When the time reaches a slot of a higher level, that
+// slot's timers move down to where they now belong, so a timer moves at most
+// LEVELS - 1 times. Scheduling, cancelling and expiring a timer are O(1), and a
+// tick with nothing due costs a look at one slot.
+//
+// Timers live in a pool indexed by Handle. A handle is valid until its timer
+// fires or is cancelled; after that it may be given to a new timer.
+
+template<class T>
+class ECTimingWheel
+{
+public:
+    typedef int32_t Handle;
+    static const Handle NO_TIMER = -1;
+
+    static const int BITS = 8;
+    static const int SLOTS = 1 << BITS;
+    static const int LEVELS = 4;
+
+    // 'time': the first tick Advance will expire
+    explicit ECTimingWheel(int time = 0) : heads(NUM_LISTS, -1), freeHead(-1), currTime(time), numTimers(0) {}
+
+    // Make room for n timers at once, so scheduling up to that many does not allocate
+    void Reserve(size_t n) {
+        nodes.reserve(n);
+        while (nodes.size() < n) {
+            nodes.push_back(Node());
+            nodes.back().list = FREE;
+            nodes.back().next = freeHead;
+            freeHead = static_cast<Handle>(nodes.size() - 1);
+        }
+    }
+
+    // A timer due at 'time'; one for a tick already expired fires on the next Advance
+    Handle Schedule(int time, const T &value) {
+        Handle handle = freeHead;
+        if (handle >= 0) {
+            freeHead = nodes[handle].next;
+        } else {
+            handle = static_cast<Handle>(nodes.size());
+            nodes.push_back(Node());
+        }
+        Node &node = nodes[handle];
+        node.time = time;
+        node.value = value;
+        Link(handle, ListFor(time));
+        numTimers++;
+        return handle;
+    }
+
+    // False if the timer has already fired or been cancelled
+    bool Cancel(Handle handle) {
+        if (handle < 0 || handle >= static_cast<Handle>(nodes.size()) || nodes[handle].list == FREE) {
+            return false;
+        }
+        Unlink(handle);
+        Release(handle);
+        return true;
+    }
+
+    // Expire every tick up to and including 'time', calling fire(value, dueTime)
+    // for each timer due (overdue ones first, otherwise in no particular order
+    // within a tick). fire may schedule and cancel timers; new ones due at a tick
+    // already expired fire on the next Advance.
+    template<class F>
+    void Advance(int time, F &&fire) {
+        while (currTime <= time) {
+            int tick = currTime;
+            if ((tick & (SLOTS - 1)) == 0) {
+                Cascade(tick);
+            }
+            currTime = tick + 1;
+            Drain(OVERDUE, fire);
+            Drain(tick & (SLOTS - 1), fire);
+        }
+    }
+
+    // The first tick not expired yet
+    int GetTime() const { return currTime; }
+    size_t GetNumTimers() const { return numTimers; }
+    bool IsPending(Handle handle) const {
+        return handle >= 0 && handle < static_cast<Handle>(nodes.size()) && nodes[handle].list != FREE;
+    }
+
+private:
+    static const int OVERDUE = LEVELS * SLOTS;  // timers due before currTime
+    static const int FIRING = OVERDUE + 1;      // timers being fired
+    static const int NUM_LISTS = FIRING + 1;
+    static const int FREE = -1;
+
+    struct Node {
+        int time = 0;
+        Handle prev = -1;
+        Handle next = -1;
+        int32_t list = -1;                      // index in heads, FREE when not scheduled
+        T value = T();
+    };
+
+    int ListFor(int time) const {
+        if (time < currTime) {
+            return OVERDUE;
+        }
+        uint32_t diff = static_cast<uint32_t>(time) ^ static_cast<uint32_t>(currTime);
+        int level = diff == 0 ? 0 : (std::bit_width(diff) - 1) / BITS;
+        return level * SLOTS + ((static_cast<uint32_t>(time) >> (level * BITS)) & (SLOTS - 1));
+    }
+
+    void Link(Handle handle, int list) {
+        Node &node = nodes[handle];
+        node.list = list;
+        node.prev = -1;
+        node.next = heads[list];
+        if (node.next >= 0) {
+            nodes[node.next].prev = handle;
+        }
+        heads[list] = handle;
+    }
+
+    void Unlink(Handle handle) {
+        Node &node = nodes[handle];
+        if (node.prev >= 0) {
+            nodes[node.prev].next = node.next;
+        } else {
+            heads[node.list] = node.next;
+        }
+        if (node.next >= 0) {
+            nodes[node.next].prev = node.prev;
+        }
+    }
+
+    void Release(Handle handle) {
+        nodes[handle].list = FREE;
+        nodes[handle].next = freeHead;
+        freeHead = handle;
+        numTimers--;
+    }
+
+    // 'tick' starts a slot of level 1 (and maybe of higher levels): move the timers
+    // of those slots down, the highest level first since its timers may land in
+    // the lower slots being emptied
+    void Cascade(int tick) {
+        int top = 1;
+        while (top < LEVELS - 1 && ((static_cast<uint32_t>(tick) >> (top * BITS)) & (SLOTS - 1)) == 0) {
+            top++;
+        }
+        for (int level = top; level >= 1; level--) {
+            int list = level * SLOTS + ((static_cast<uint32_t>(tick) >> (level * BITS)) & (SLOTS - 1));
+            Handle handle = heads[list];
+            heads[list] = -1;
+            while (handle >= 0) {
+                Handle next = nodes[handle].next;
+                Link(handle, ListFor(nodes[handle].time));
+                handle = next;
+            }
+        }
+    }
+
+    // Fire every timer on a list. They are moved to FIRING first, so fire may
+    // cancel any of them, and timers it schedules cannot join the list being fired.
+    template<class F>
+    void Drain(int list, F &fire) {
+        Handle handle = heads[list];
+        if (handle < 0) {
+            return;
+        }
+        heads[list] = -1;
+        heads[FIRING] = handle;
+        for (Handle h = handle; h >= 0; h = nodes[h].next) {
+            nodes[h].list = FIRING;
+        }
+        while (heads[FIRING] >= 0) {
+            Handle h = heads[FIRING];
+            Unlink(h);
+            int time = nodes[h].time;
+            T value = nodes[h].value;
+            Release(h);
+            fire(value, time);
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::vector<Handle> heads;                  // per list (level * SLOTS + slot, OVERDUE, FIRING): first timer
+    Handle freeHead;
+    int currTime;
+    size_t numTimers;
+};
+
+#endif /* ECTimingWheel_h */
@@ -1,5 +1,26 @@
 #include "ECElevatorConnect.h"
+#include "ECElevatorBench.h"
+#include "ECElevatorDiff.h"
+#include "ECElevatorOnlineDispatcher.h"
+#include "ECElevatorResultsWriter.h"
+#include "ECElevatorEventLog.h"
+#include "ECElevatorSimZoned.h"
+#include "ECElevatorSimBank.h"
+#include "ECElevatorBatchRunner.h"
+#include "ECElevatorTimeSeries.h"
+#include "ECElevatorEtaTable.h"
+#include "ECElevatorOfflineSolver.h"
+#include "ECElevatorResultsIndex.h"
+#include "ECElevatorAgents.h"
+#include "ECElevatorTraceArchive.h"
+#include "ECAsyncObserver.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
 
 // Add this before main()
 class ConcreteElevatorObserver : public ECElevatorObserver {
@@ -10,9 +31,376 @@ public:
     // Or keep it if you want custom behavior
 };
 
+// Load a simulation file (text, or a trace archive from --pack) as ECElevatorSimRequest
+// records, for the headless modes
+static bool LoadRequests(const char* filename, ECCompactTrace& trace, std::vector<ECElevatorSimRequest>& listRequests) {
+    if (ECIsTraceArchive(filename)) {
+        ECTraceArchive archive;
+        std::vector<ECCompactRequest> requests;
+        try {
+            if (!archive.Open(filename)) {
+                throw std::runtime_error(std::string("Could not read trace archive ") + filename);
+            }
+            archive.Read(INT_MIN, INT_MAX, requests);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+        trace.numFloors = archive.GetNumFloors();
+        trace.lenSim = archive.GetLenSim();
+        trace.numRequests = requests.size();
+        listRequests.reserve(requests.size());
+        for (const ECCompactRequest &request : requests) {
+            listRequests.push_back(ECElevatorSimRequest(request.GetTime(), request.GetFloorSrc(), request.GetFloorDest()));
+        }
+        return true;
+    }
+
+    ECRequestArena arena;
+    if (!ECLoadCompactTrace(filename, arena, trace)) {
+        std::cerr << "Error: Could not load " << filename << " (missing, or a value out of range)" << std::endl;
+        return false;
+    }
+    listRequests.reserve(trace.numRequests);
+    for (const ECCompactRequest &request : trace) {
+        listRequests.push_back(ECElevatorSimRequest(request.GetTime(), request.GetFloorSrc(), request.GetFloorDest()));
+    }
+    trace.requests = nullptr;
+    return true;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    std::string arg = argc > 1 ? argv[1] : "";
+
+    // Headless modes
+    if (arg == "--bench" && argc == 2) {
+        ECRunEngineBenchmarks(std::cout);
+        return 0;
+    }
+    if (arg == "--alloc-check" && argc == 2) {
+        // Heap use per engine; fails if an engine allocates inside a tick
+        return ECCheckEngineAllocations(std::cout) == 0 ? 0 : 1;
+    }
+    if (arg == "--async-check" && argc == 2) {
+        // Events delivered, dropped and coalesced by each ECAsyncObserver overflow policy
+        return ECCheckAsyncObserver(std::cout) == 0 ? 0 : 1;
+    }
+    if (arg == "--zoned" && argc <= 3) {
+        // --zoned [seed]: a zoned tower with sky-lobby transfers, one thread per zone
+        ECRunZonedBenchmark(std::cout, argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 1);
+        return 0;
+    }
+    if (arg == "--bank" && argc <= 3) {
+        // --bank [cars]: one large bank, per-car phase on 1..8 threads
+        ECRunBankBenchmark(std::cout, argc > 2 ? std::max(std::atoi(argv[2]), 1) : 48);
+        return 0;
+    }
+    if (arg == "--dispatch" && argc <= 4) {
+        // --dispatch [cars] [seed]: nearest-car against ETA-table dispatch on a busy bank
+        try {
+            ECRunDispatchBenchmark(std::cout, argc >= 3 ? std::max(std::atoi(argv[2]), 1) : 8, argc == 4 ? std::atoi(argv[3]) : 1);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (arg == "--agents" && argc <= 4) {
+        // --agents [count] [seed]: coroutine passengers that balk, re-press and transfer
+        ECRunAgentBenchmark(std::cout, argc >= 3 ? std::atoi(argv[2]) : 1000000, argc == 4 ? std::atoi(argv[3]) : 1);
+        return 0;
+    }
+    if (arg == "--batch" && argc >= 3 && argc <= 5) {
+        // --batch <manifest> [workers] [sketch file]: run every trace in the manifest, pipelined
+        try {
+            ECBatchOptions options;
+            if (argc >= 4) {
+                options.numWorkers = std::atoi(argv[3]);
+            }
+            if (argc == 5) {
+                options.sketchFile = argv[4];
+            }
+            ECBatchRunner runner(ECLoadBatchManifest(argv[2]), options);
+            runner.Run();
+            runner.Report(std::cout);
+            return runner.GetNumFailed() == 0 ? 0 : 1;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (arg == "--sketch-report" && argc >= 3) {
+        // --sketch-report <sketch file> ...: percentiles over several batches
+        return ECReportSketchFiles(std::cout, std::vector<std::string>(argv + 2, argv + argc)) ? 0 : 1;
+    }
+    if (arg == "--diff" && argc <= 5) {
+        // --diff [iterations] [seed] [engine]: compare the engines with ECElevatorSim on random traces
+        int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+        uint32_t seed = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 1;
+        return ECRunDifferential(std::cout, seed, iterations, argc > 4 ? argv[4] : "") == 0 ? 0 : 1;
+    }
+    if (arg == "--diff-throughput" && argc <= 4) {
+        // --diff-throughput [traces] [seed]
+        int numTraces = argc > 2 ? std::atoi(argv[2]) : 20;
+        uint32_t seed = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 1;
+        ECRunDiffThroughput(std::cout, seed, numTraces);
+        return 0;
+    }
+    if (arg == "--online" && argc >= 4) {
+        // --online <numFloors> <tickPeriodUs> [feed ...]; feeds default to stdin
+        ECElevatorOnlineDispatcher::Options options;
+        options.numFloors = std::atoi(argv[2]);
+        options.tickPeriodUs = std::atoi(argv[3]);
+        ECElevatorOnlineDispatcher dispatcher(options);
+        for (int i = 4; i < argc; i++) {
+            if (!dispatcher.StartFeed(argv[i])) {
+                std::cerr << "Error: Could not open feed " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        if (argc == 4) {
+            dispatcher.StartFeed("-");
+        }
+        dispatcher.Run();
+        dispatcher.Report(std::cout);
+        return 0;
+    }
+
+    if (arg == "--results" && argc == 4) {
+        // --results <simulation_file> <output>: run headless, streaming per-passenger results
+        ECCompactTrace trace;
+        std::vector<ECElevatorSimRequest> listRequests;
+        if (!LoadRequests(argv[2], trace, listRequests)) {
+            return 1;
+        }
+        try {
+            ECResultsWriter writer(argv[3], ECResultsWriter::FormatFromName(argv[3]));
+            ECElevatorSimGeneric sim(trace.numFloors, listRequests);
+            sim.SetListener(&writer);
+            sim.Simulate(trace.lenSim);
+            writer.Close();
+            std::cout << writer.GetNumAdded() << " of " << listRequests.size() << " requests serviced" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (arg == "--index" && (argc == 4 || argc == 5)) {
+        // --index <results.ecr> <index> [threads]: prefix-summed aggregates per floor and
+        // per floor pair, for --query
+        try {
+            ECIndexOptions options;
+            if (argc == 5) {
+                options.numThreads = std::atoi(argv[4]);
+            }
+            ECIndexBuildSummary summary = ECBuildResultsIndex(argv[2], argv[3], options);
+            std::cout << summary.numResults << " results indexed (" << summary.numSkipped << " skipped), "
+                      << summary.numFloors << " floors, " << summary.numFloorBuckets << " floor buckets, "
+                      << summary.numPairBuckets << " pair buckets, " << summary.elapsedMs << " ms" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (arg == "--query" && (argc == 6 || argc == 7)) {
+        // --query <index> <floor> <begin> <end>: passengers calling from the floor (0: any)
+        // --query <index> <src> <dest> <begin> <end>: passengers going from src to dest
+        ECResultsIndex index;
+        if (!index.Open(argv[2])) {
+            std::cerr << "Error: " << argv[2] << " is not a results index" << std::endl;
+            return 1;
+        }
+        int begin = std::atoi(argv[argc - 2]), end = std::atoi(argv[argc - 1]);
+        ECIndexAggregate range = argc == 6 ? index.GetFloorRange(std::atoi(argv[3]), begin, end)
+                                           : index.GetPairRange(std::atoi(argv[3]), std::atoi(argv[4]), begin, end);
+        std::cout << range.count << " passengers" << std::endl;
+        const char* names[EC_NUM_INDEX_METRICS] = {"wait", "ride", "trip"};
+        for (int m = 0; m < EC_NUM_INDEX_METRICS && range.count > 0; m++) {
+            ECIndexMetric metric = static_cast<ECIndexMetric>(m);
+            std::cout << "  " << names[m] << ": mean " << range.GetMean(metric) << ", p50 " << range.GetQuantile(metric, 0.5)
+                      << ", p95 " << range.GetQuantile(metric, 0.95) << ", p99 " << range.GetQuantile(metric, 0.99)
+                      << std::endl;
+        }
+        return 0;
+    }
+
+    if (arg == "--timeseries" && (argc == 4 || argc == 5)) {
+        // --timeseries <simulation_file> <output.csv> [level]: queue lengths, car load and
+        // utilization over time, at 1 s (level 0), 1 min (1, the default) or 15 min (2)
+        ECCompactTrace trace;
+        std::vector<ECElevatorSimRequest> listRequests;
+        if (!LoadRequests(argv[2], trace, listRequests)) {
+            return 1;
+        }
+        int level = argc == 5 ? std::atoi(argv[4]) : 1;
+        if (level < 0 || level >= static_cast<int>(ECTimeSeries::DefaultResolutions().size())) {
+            std::cerr << "Error: no level " << level << std::endl;
+            return 1;
+        }
+        std::ofstream out(argv[3]);
+        ECElevatorSimGeneric sim(trace.numFloors, listRequests);
+        ECTimeSeriesRecorder recorder(trace.numFloors, sim.GetNumCars());
+        sim.SetListener(&recorder);
+        sim.Simulate(trace.lenSim);
+        recorder.WriteCsv(out, level);
+        if (!out.flush()) {
+            std::cerr << "Error: cannot write " << argv[3] << std::endl;
+            return 1;
+        }
+        std::cout << recorder.GetTotalWaiting().GetNumBuckets(level) << " buckets of "
+                  << recorder.GetTotalWaiting().GetWidth(level) << " ticks per series" << std::endl;
+        return 0;
+    }
+
+    if (arg == "--lower-bound" && argc >= 3 && argc <= 5) {
+        // --lower-bound <simulation_file> [threads] [group size]: offline lower bound on
+        // total trip time, next to ECElevatorSim's; groups of 1..16 requests, 10 by default
+        ECCompactTrace trace;
+        std::vector<ECElevatorSimRequest> listRequests;
+        if (!LoadRequests(argv[2], trace, listRequests)) {
+            return 1;
+        }
+        try {
+            ECOfflineOptions options;
+            if (argc >= 4) {
+                options.numThreads = std::atoi(argv[3]);
+            }
+            if (argc == 5) {
+                options.groupSize = std::atoi(argv[4]);
+            }
+            ECReportOfflineBound(std::cout, trace.numFloors, listRequests, options);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (arg == "--pack" && (argc == 4 || argc == 5)) {
+        // --pack <simulation_file> <archive> [block size]: compress a text trace into a
+        // seekable archive, readable wherever a simulation file is
+        ECRequestArena arena;
+        ECCompactTrace trace;
+        if (!ECLoadCompactTrace(argv[2], arena, trace)) {
+            std::cerr << "Error: Could not load " << argv[2] << " (missing, or a value out of range)" << std::endl;
+            return 1;
+        }
+        std::stable_sort(trace.begin(), trace.end(),
+                         [](const ECCompactRequest& a, const ECCompactRequest& b) { return a.GetTime() < b.GetTime(); });
+        try {
+            int blockSize = argc == 5 ? std::atoi(argv[4]) : ECTraceArchiveWriter::DEFAULT_BLOCK_SIZE;
+            ECTraceArchiveWriter writer(argv[3], trace.numFloors, trace.lenSim, blockSize);
+            for (const ECCompactRequest& request : trace) {
+                writer.Add(request.GetTime(), request.GetFloorSrc(), request.GetFloorDest());
+            }
+            writer.Close();
+            std::cout << writer.GetNumRequests() << " requests in " << writer.GetNumBlocks() << " blocks: "
+                      << writer.GetRawBytes() << " bytes of varints, " << writer.GetStoredBytes() << " compressed" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (arg == "--unpack" && (argc == 4 || argc == 6 || argc == 7)) {
+        // --unpack <archive> <simulation_file> [begin end] [threads]: the requests of a time
+        // window (all by default) back as a text trace, decoded in parallel
+        ECTraceArchive archive;
+        if (!archive.Open(argv[2])) {
+            std::cerr << "Error: " << argv[2] << " is not a trace archive" << std::endl;
+            return 1;
+        }
+        int begin = argc >= 6 ? std::atoi(argv[4]) : INT_MIN;
+        int end = argc >= 6 ? std::atoi(argv[5]) : INT_MAX;
+        try {
+            std::vector<ECCompactRequest> requests;
+            auto start = std::chrono::steady_clock::now();
+            archive.Read(begin, end, requests, argc == 7 ? std::atoi(argv[6]) : 0);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            std::ofstream out(argv[3]);
+            out << "# " << requests.size() << " requests unpacked from " << argv[2] << "\n";
+            out << archive.GetNumFloors() << " " << archive.GetLenSim() << "\n";
+            for (const ECCompactRequest& request : requests) {
+                out << request.GetTime() << " " << request.GetFloorSrc() << " " << request.GetFloorDest() << "\n";
+            }
+            if (!out.flush()) {
+                std::cerr << "Error: cannot write " << argv[3] << std::endl;
+                return 1;
+            }
+            std::cout << requests.size() << " requests decoded in " << ms << " ms" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (arg == "--record" && argc == 4) {
+        // --record <simulation_file> <log>: run headless, recording an event log for replay
+        ECCompactTrace trace;
+        std::vector<ECElevatorSimRequest> listRequests;
+        if (!LoadRequests(argv[2], trace, listRequests)) {
+            return 1;
+        }
+        try {
+            ECElevatorSimGeneric sim(trace.numFloors, listRequests);
+            ECEventLogWriter log(argv[3], trace.numFloors, sim.GetNumCars());
+            sim.SetListener(&log);
+            sim.Simulate(trace.lenSim);
+            log.Close();
+            std::cout << trace.lenSim << " ticks recorded, " << log.GetNumKeyframes() << " keyframes" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // --replay <log>: view a run recorded with --record, with timeline controls
+    // --alloc-check <simulation_file>: view it and report heap allocations per frame
+    // --profile <simulation_file> [log.csv]: view it with the frame profiler shown (P toggles it)
+    bool isReplay = arg == "--replay" && argc == 3;
+    bool isAllocCheck = arg == "--alloc-check" && argc == 3;
+    bool isProfile = arg == "--profile" && (argc == 3 || argc == 4);
+    const char* simulationFile = isAllocCheck || isProfile ? argv[2] : argv[1];
+    if (!isReplay && !isAllocCheck && !isProfile && (argc != 2 || arg.compare(0, 2, "--") == 0)) {
         std::cerr << "Usage: " << argv[0] << " <simulation_file>" << std::endl;
+        std::cerr << "       " << argv[0] << " --bench" << std::endl;
+        std::cerr << "       " << argv[0] << " --alloc-check [simulation_file]" << std::endl;
+        std::cerr << "       " << argv[0] << " --async-check" << std::endl;
+        std::cerr << "       " << argv[0] << " --diff [iterations] [seed] [engine]" << std::endl;
+        std::cerr << "       " << argv[0] << " --diff-throughput [traces] [seed]" << std::endl;
+        std::cerr << "       " << argv[0] << " --zoned [seed]" << std::endl;
+        std::cerr << "       " << argv[0] << " --bank [cars]" << std::endl;
+        std::cerr << "       " << argv[0] << " --dispatch [cars] [seed]" << std::endl;
+        std::cerr << "       " << argv[0] << " --agents [count] [seed]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <manifest> [workers] [sketch file]" << std::endl;
+        std::cerr << "       " << argv[0] << " --sketch-report <sketch file> ..." << std::endl;
+        std::cerr << "       " << argv[0] << " --online <numFloors> <tickPeriodUs> [feed ...]" << std::endl;
+        std::cerr << "       " << argv[0] << " --results <simulation_file> <output.csv|output.ecr>" << std::endl;
+        std::cerr << "       " << argv[0] << " --timeseries <simulation_file> <output.csv> [level]" << std::endl;
+        std::cerr << "       " << argv[0] << " --index <results.ecr> <index> [threads]" << std::endl;
+        std::cerr << "       " << argv[0] << " --query <index> <floor> <begin> <end>" << std::endl;
+        std::cerr << "       " << argv[0] << " --query <index> <src> <dest> <begin> <end>" << std::endl;
+        std::cerr << "       " << argv[0] << " --lower-bound <simulation_file> [threads] [group size 1..16, default 10]" << std::endl;
+        std::cerr << "       " << argv[0] << " --pack <simulation_file> <archive> [block size]" << std::endl;
+        std::cerr << "       " << argv[0] << " --unpack <archive> <simulation_file> [begin end] [threads]" << std::endl;
+        std::cerr << "       " << argv[0] << " --record <simulation_file> <log>" << std::endl;
+        std::cerr << "       " << argv[0] << " --replay <log>" << std::endl;
+        std::cerr << "       " << argv[0] << " --profile <simulation_file> [log.csv]" << std::endl;
         return 1;
     }
 
@@ -25,15 +413,31 @@ int main(int argc, char* argv[]) {
 
         // Create observer and simulator
         ConcreteElevatorObserver* elevatorObserver = new ConcreteElevatorObserver(graphicView);
-        ECElevatorConnect* simulator = new ECElevatorConnect(argv[1], elevatorObserver);
-        
-        // Add this line to connect the simulator
-        elevatorObserver->SetSimulator(simulator);
+        ECElevatorConnect* simulator = nullptr;
+        ECEventLogReader replay;
         
-        simulator->LoadSimulation();
-        graphicView->Attach(elevatorObserver);
+        if (isReplay) {
+            if (!replay.Open(argv[2])) {
+                throw std::runtime_error(std::string("Could not open event log ") + argv[2]);
+            }
+            elevatorObserver->SetReplay(&replay);
+            graphicView->Subscribe(elevatorObserver, ECEventMask(EC_EVENT_TIMER) | ECEventMask(EC_EVENT_KEY) | ECEventMask(EC_EVENT_MOUSE));
+        } else {
+            simulator = new ECElevatorConnect(simulationFile, elevatorObserver);
+            
+            // Add this line to connect the simulator
+            elevatorObserver->SetSimulator(simulator);
+            
+            simulator->LoadSimulation();
+            graphicView->Subscribe(elevatorObserver, ECEventMask(EC_EVENT_TIMER) | ECEventMask(EC_EVENT_KEY));
+        }
         
         // Start the simulation
+        graphicView->SetAllocCheck(isAllocCheck);
+        graphicView->SetProfileOverlay(isProfile);
+        if (isProfile && argc == 4 && !graphicView->SetProfileLog(argv[3])) {
+            throw std::runtime_error(std::string("Could not create ") + argv[3]);
+        }
         graphicView->Show();
         
         // Clean up in reverse order